@@ -1,31 +1,35 @@
+#define _GNU_SOURCE // memfd_create, open_memstream
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
-
-// Índices específicos de cada CSR
-// Mapeia endereço CSR para índice no vetor registradoresCSRs[7]
-int csrIndex(uint16_t endereco)
-{
-	switch (endereco)
-	{
-	case 0x300:
-		return 0; // mstatus
-	case 0x304:
-		return 1; // mie
-	case 0x305:
-		return 2; // mtvec
-	case 0x341:
-		return 3; // mepc
-	case 0x342:
-		return 4; // mcause
-	case 0x343:
-		return 5; // mtval
-	case 0x344:
-		return 6; // mip
-	default:
-		return -1; // CSR não suportado
-	}
-}
+#include <string.h>
+#include <elf.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "poximv2.h"
+
+// linha do trace de execução; sem arquivo de trace (m->saida == NULL) nada é formatado
+#define TRACE(saida, ...)                \
+	do                                   \
+	{                                    \
+		if ((saida) != NULL)             \
+			fprintf(saida, __VA_ARGS__); \
+	} while (0)
+
+// abreviações do RISC-V para os registradores
+static const char *regNomes[32] = {"zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
 
 // função para preparar mstatus para o modo de exceção
 void prepMstatus(uint32_t *mstatus_ptr)
@@ -54,262 +58,4685 @@ void prepMstatus(uint32_t *mstatus_ptr)
 	*mstatus_ptr = mstatus;
 }
 
-// função para tratar as excessões
-void registrarExcecao(uint32_t causa, uint32_t endereco_instrucao, uint32_t tval, uint32_t *registradoresCSRs, FILE *output, uint32_t *pc_ptr)
+// pilha de chamadas sombra: jal/jalr com rd = ra são chamadas, "jalr zero,ra,0" é retorno,
+// a entrada em trap empilha um quadro próprio e mret desempilha até ele
+// cada caminho de chamadas é um nó de uma árvore; as instruções entre dois eventos vão para o nó do topo
+typedef struct
 {
-	int indice_mcause = csrIndex(834); // endereço de mcause
-	int indice_mepc = csrIndex(833);   // endereço de mepc
-	int indice_mtvec = csrIndex(773);  // endereço de mtvec
+	uint32_t pai;		  // índice do nó pai (a raiz aponta para si mesma)
+	uint32_t endereco;	  // função chamada ou mcause do trap
+	uint32_t trap;		  // 1 = quadro de trap
+	uint64_t exclusivas;  // instruções executadas com este caminho no topo
+} NoChamada;
 
-	if (indice_mcause != -1)
+typedef struct
+{
+	uint32_t no;
+	uint32_t retorno; // endereço de retorno esperado (0 em quadros de trap)
+	uint32_t trap;
+} QuadroChamada;
+
+struct PilhaChamadas
+{
+	NoChamada *nos;
+	uint32_t numNos, capNos;
+	uint32_t *tabela; // (pai, endereco, trap) -> índice + 1, endereçamento aberto
+	uint32_t tamTabela;
+	QuadroChamada *quadros;
+	uint32_t profundidade, capQuadros;
+	uint64_t atribuidas; // instruções já atribuídas a algum nó
+};
+
+#define MAX_PROFUNDIDADE_PILHA (1u << 16)
+
+static uint32_t hashNoChamada(uint32_t pai, uint32_t endereco, uint32_t trap)
+{
+	uint64_t h = ((uint64_t)pai << 33) ^ ((uint64_t)endereco << 1) ^ trap;
+	h *= 0x9E3779B97F4A7C15ull;
+	return (uint32_t)(h >> 32);
+}
+
+// nó filho (pai, endereco, trap), criado se ainda não existe; UINT32_MAX sem memória
+static uint32_t filhoChamada(PilhaChamadas *p, uint32_t pai, uint32_t endereco, uint32_t trap)
+{
+	if (2 * (p->numNos + 1) > p->tamTabela)
 	{
-		registradoresCSRs[indice_mcause] = causa; // escrevendo a causa da excessão
+		const uint32_t tamanho = p->tamTabela ? 2 * p->tamTabela : 1024;
+		uint32_t *tabela = calloc(tamanho, sizeof(uint32_t));
+		if (tabela == NULL)
+			return UINT32_MAX;
+		for (uint32_t i = 0; i < p->numNos; i++)
+		{
+			uint32_t j = hashNoChamada(p->nos[i].pai, p->nos[i].endereco, p->nos[i].trap) & (tamanho - 1);
+			while (tabela[j] != 0)
+				j = (j + 1) & (tamanho - 1);
+			tabela[j] = i + 1;
+		}
+		free(p->tabela);
+		p->tabela = tabela;
+		p->tamTabela = tamanho;
 	}
 
-	if (indice_mepc != -1)
+	uint32_t j = hashNoChamada(pai, endereco, trap) & (p->tamTabela - 1);
+	for (; p->tabela[j] != 0; j = (j + 1) & (p->tamTabela - 1))
 	{
-		registradoresCSRs[indice_mepc] = endereco_instrucao; // escrevendo o endereço da instrução que causou
+		const NoChamada *no = &p->nos[p->tabela[j] - 1];
+		if (no->pai == pai && no->endereco == endereco && no->trap == trap)
+			return p->tabela[j] - 1;
 	}
 
-	*pc_ptr = registradoresCSRs[indice_mtvec];
+	if (p->numNos == p->capNos)
+	{
+		const uint32_t capacidade = p->capNos ? 2 * p->capNos : 256;
+		NoChamada *nos = realloc(p->nos, capacidade * sizeof(NoChamada));
+		if (nos == NULL)
+			return UINT32_MAX;
+		p->nos = nos;
+		p->capNos = capacidade;
+	}
+	p->nos[p->numNos] = (NoChamada){pai, endereco, trap, 0};
+	p->tabela[j] = p->numNos + 1;
+	return p->numNos++;
+}
 
-	// Ignora exceção de breakpoint (cause == 3), pois já foi tratada por 'ebreak'
-	if (causa == 0x3)
+// as instruções desde o último evento pertencem ao quadro do topo
+static void atribuirPilha(PilhaChamadas *p, uint64_t instrucoes)
+{
+	p->nos[p->quadros[p->profundidade - 1].no].exclusivas += instrucoes - p->atribuidas;
+	p->atribuidas = instrucoes;
+}
+
+static void empilharChamada(PilhaChamadas *p, uint64_t instrucoes, uint32_t endereco, uint32_t retorno, uint32_t trap)
+{
+	atribuirPilha(p, instrucoes);
+	if (p->profundidade == p->capQuadros)
 	{
-		return; // Evita print duplicado para ebreak
+		if (p->capQuadros >= MAX_PROFUNDIDADE_PILHA)
+			return; // recursão sem fim: o excedente fica no quadro do topo
+		QuadroChamada *quadros = realloc(p->quadros, 2 * p->capQuadros * sizeof(QuadroChamada));
+		if (quadros == NULL)
+			return;
+		p->quadros = quadros;
+		p->capQuadros *= 2;
 	}
+	const uint32_t no = filhoChamada(p, p->quadros[p->profundidade - 1].no, endereco, trap);
+	if (no != UINT32_MAX)
+		p->quadros[p->profundidade++] = (QuadroChamada){no, retorno, trap};
+}
 
-	// Mapeamento de códigos de causa para nomes de exceção (exceto breakpoint)
-	const char *nome_exc =
-		(causa == 0x0) ? "instruction_misaligned" : (causa == 0x1) ? "instruction_fault"
-												: (causa == 0x2)   ? "illegal_instruction"
-												: (causa == 0x4)   ? "load_misaligned"
-												: (causa == 0x5)   ? "load_fault"
-												: (causa == 0x6)   ? "store_misaligned"
-												: (causa == 0x7)   ? "store_fault"
-												: (causa == 0xB)   ? "environment_call"
-																   : "unknown";
+// retorno para destino: desempilha até a chamada que esperava esse endereço, sem atravessar um trap
+// (retornos que não casam com nenhuma chamada, como saltos com ra, não mexem na pilha)
+static void retornarChamada(PilhaChamadas *p, uint64_t instrucoes, uint32_t destino)
+{
+	atribuirPilha(p, instrucoes);
+	for (uint32_t i = p->profundidade - 1; i > 0 && !p->quadros[i].trap; i--)
+	{
+		if (p->quadros[i].retorno == destino)
+		{
+			p->profundidade = i;
+			return;
+		}
+	}
+}
 
-	fprintf(output, ">exception:%-20s cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
-			nome_exc, causa, endereco_instrucao, tval);
+// mret: desempilha até o quadro de trap mais recente, inclusive
+static void retornarTrap(PilhaChamadas *p, uint64_t instrucoes)
+{
+	atribuirPilha(p, instrucoes);
+	for (uint32_t i = p->profundidade - 1; i > 0; i--)
+	{
+		if (p->quadros[i].trap)
+		{
+			p->profundidade = i;
+			return;
+		}
+	}
 }
 
-int main(int argc, char *argv[])
-{ // argumento para abrir o projeto no terminal, entrega a entrada e fala a saida
-  // "./meuprograma" "entrada.hex"  "saida.out"
+// estatísticas de execução: instruções por mnemônico, desvios tomados, acessos por região e traps
+// (uma contagem por instrução no começo do laço; a decodificação só roda quando estão ligadas)
+enum
+{
+	MN_LUI, MN_AUIPC, MN_JAL, MN_JALR,
+	MN_BEQ, MN_BNE, MN_BLT, MN_BGE, MN_BLTU, MN_BGEU,
+	MN_LB, MN_LH, MN_LW, MN_LBU, MN_LHU, MN_SB, MN_SH, MN_SW,
+	MN_ADDI, MN_SLTI, MN_SLTIU, MN_XORI, MN_ORI, MN_ANDI, MN_SLLI, MN_SRLI, MN_SRAI,
+	MN_ADD, MN_SUB, MN_SLL, MN_SLT, MN_SLTU, MN_XOR, MN_SRL, MN_SRA, MN_OR, MN_AND,
+	MN_MUL, MN_MULH, MN_MULHSU, MN_MULHU, MN_DIV, MN_DIVU, MN_REM, MN_REMU,
+	MN_LR_W, MN_SC_W, MN_AMOSWAP_W, MN_AMOADD_W, MN_AMOXOR_W, MN_AMOAND_W, MN_AMOOR_W,
+	MN_AMOMIN_W, MN_AMOMAX_W, MN_AMOMINU_W, MN_AMOMAXU_W,
+	MN_ECALL, MN_EBREAK, MN_MRET, MN_WFI,
+	MN_CSRRW, MN_CSRRS, MN_CSRRC, MN_CSRRWI, MN_CSRRSI, MN_CSRRCI,
+	MN_INVALIDA,
+	NUM_MNEMONICOS
+};
+
+static const char *nomesMnemonicos[NUM_MNEMONICOS] = {
+	"lui", "auipc", "jal", "jalr",
+	"beq", "bne", "blt", "bge", "bltu", "bgeu",
+	"lb", "lh", "lw", "lbu", "lhu", "sb", "sh", "sw",
+	"addi", "slti", "sltiu", "xori", "ori", "andi", "slli", "srli", "srai",
+	"add", "sub", "sll", "slt", "sltu", "xor", "srl", "sra", "or", "and",
+	"mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu",
+	"lr.w", "sc.w", "amoswap.w", "amoadd.w", "amoxor.w", "amoand.w", "amoor.w",
+	"amomin.w", "amomax.w", "amominu.w", "amomaxu.w",
+	"ecall", "ebreak", "mret", "wfi",
+	"csrrw", "csrrs", "csrrc", "csrrwi", "csrrsi", "csrrci",
+	"invalida",
+};
+
+// regiões dos acessos de load/store
+enum
+{
+	REGIAO_RAM,
+	REGIAO_CLINT,
+	REGIAO_PLIC,
+	REGIAO_UART,
+	REGIAO_OUTRA,
+	NUM_REGIOES
+};
+
+static const char *nomesRegioes[NUM_REGIOES] = {"ram", "clint", "plic", "uart", "outra"};
+
+struct Estatisticas
+{
+	uint64_t mnemonicos[NUM_MNEMONICOS];
+	uint64_t desvios[2]; // não tomados, tomados
+	uint64_t loads[NUM_REGIOES];
+	uint64_t stores[NUM_REGIOES];
+	uint64_t excecoes[16];	  // por mcause
+	uint64_t interrupcoes[16]; // por código (3 = software, 7 = timer, 11 = externa)
+};
+
+static int regiaoEndereco(uint32_t endereco)
+{
+	if (endereco - OFFSET_MEMORIA < TAM_MEMORIA)
+		return REGIAO_RAM;
+	if (endereco >= 0x02000000 && endereco < 0x02010000)
+		return REGIAO_CLINT;
+	if (endereco >= 0x0C000000 && endereco < 0x10000000)
+		return REGIAO_PLIC;
+	if (endereco >= 0x10000000 && endereco < 0x10000008)
+		return REGIAO_UART;
+	return REGIAO_OUTRA;
+}
+
+// efeito de uma instrução, decodificado uma vez antes de executá-la (os registradores ainda têm os valores de
+// entrada) e compartilhado pelas estatísticas, pelo mapa de acessos, pelos modelos de tempo e pelo gatilho
+enum
+{
+	ACESSO_NENHUM,
+	ACESSO_LOAD,
+	ACESSO_STORE,
+	ACESSO_ATOMICO, // lr.w, sc.w e amo*.w
+};
+
+typedef struct
+{
+	uint32_t endereco; // endereço efetivo do acesso a dados
+	uint8_t acesso;	   // ACESSO_*
+	uint8_t leitura;
+	uint8_t escrita;
+	uint8_t tamanho; // bytes acessados
+	int8_t desvio;	 // desvio condicional: 1 = tomado, 0 = não tomado, -1 = não é desvio
+	uint32_t alvo;	 // destino do desvio condicional (tomado ou não), do jal ou do jalr
+	uint32_t proximo; // pc seguinte se a instrução não gerar trap
+} EfeitoInstrucao;
+
+static void decodificarEfeito(uint32_t pc, uint32_t instrucao, const uint32_t *registradores, EfeitoInstrucao *ef)
+{
+	const uint32_t funct3 = (instrucao >> 12) & 0b111;
+	const uint32_t a = registradores[(instrucao >> 15) & 0b11111];
+	const uint32_t b = registradores[(instrucao >> 20) & 0b11111];
+
+	*ef = (EfeitoInstrucao){.desvio = -1, .proximo = pc + 4};
+	switch (instrucao & 0b1111111)
+	{
+	case 0b0000011:
+		if (funct3 == 0b011 || funct3 >= 0b110)
+			break;
+		*ef = (EfeitoInstrucao){a + (uint32_t)((int32_t)instrucao >> 20), ACESSO_LOAD, 1, 0, 1u << (funct3 & 0b11), -1, 0,
+								pc + 4};
+		break;
+	case 0b0100011:
+		if (funct3 >= 0b011)
+			break;
+		*ef = (EfeitoInstrucao){a + (uint32_t)(((int32_t)(instrucao & 0xFE000000) >> 20) | ((instrucao >> 7) & 0x1F)),
+								ACESSO_STORE, 0, 1, 1u << funct3, -1, 0, pc + 4};
+		break;
+	case 0b0101111:
+	{
+		const uint32_t funct5 = instrucao >> 27;
+		const int valido = funct3 == 0b010 && (funct5 <= 0b00100 || funct5 == 0b01000 || funct5 == 0b01100 ||
+											   (funct5 >= 0b10000 && (funct5 & 0b00011) == 0));
+		if (valido)
+			*ef = (EfeitoInstrucao){a, ACESSO_ATOMICO, funct5 != 0b00011, funct5 != 0b00010, 4, -1, 0, pc + 4}; // sc.w só escreve, lr.w só lê
+		break;
+	}
+	case 0b1100011:
+		if (funct3 == 0b010 || funct3 == 0b011)
+			break;
+		ef->desvio = (funct3 == 0b000)	 ? a == b
+					 : (funct3 == 0b001) ? a != b
+					 : (funct3 == 0b100) ? (int32_t)a < (int32_t)b
+					 : (funct3 == 0b101) ? (int32_t)a >= (int32_t)b
+					 : (funct3 == 0b110) ? a < b
+										 : a >= b;
+		ef->alvo = pc + (uint32_t)((((int32_t)instrucao >> 31) << 12) | ((instrucao >> 7) & 0x1) << 11 |
+								   ((instrucao >> 25) & 0x3F) << 5 | ((instrucao >> 8) & 0xF) << 1);
+		if (ef->desvio)
+			ef->proximo = ef->alvo;
+		break;
+	case 0b1101111:
+		ef->alvo = ef->proximo = pc + (uint32_t)((((int32_t)instrucao >> 31) << 20) | (instrucao & 0xFF000) |
+												 ((instrucao >> 20) & 0x1) << 11 | ((instrucao >> 21) & 0x3FF) << 1);
+		break;
+	case 0b1100111:
+		ef->alvo = ef->proximo = (a + (uint32_t)((int32_t)instrucao >> 20)) & ~1u;
+		break;
+	}
+}
 
-	 FILE *input = fopen(argv[1], "r");	// abre um arquivo de entrada
-	 FILE *output = fopen(argv[2], "w"); // abre/cria em arquivo de saida (os arquivos do argumento do main)
+// conta a instrução antes de executá-la
+static void contarInstrucao(Estatisticas *e, uint32_t instrucao, const EfeitoInstrucao *ef)
+{
+	static const uint8_t desvios[8] = {MN_BEQ, MN_BNE, MN_INVALIDA, MN_INVALIDA, MN_BLT, MN_BGE, MN_BLTU, MN_BGEU};
+	static const uint8_t loads[8] = {MN_LB, MN_LH, MN_LW, MN_INVALIDA, MN_LBU, MN_LHU, MN_INVALIDA, MN_INVALIDA};
+	static const uint8_t stores[8] = {MN_SB, MN_SH, MN_SW, MN_INVALIDA, MN_INVALIDA, MN_INVALIDA, MN_INVALIDA, MN_INVALIDA};
+	static const uint8_t opImm[8] = {MN_ADDI, MN_SLLI, MN_SLTI, MN_SLTIU, MN_XORI, MN_SRLI, MN_ORI, MN_ANDI};
+	static const uint8_t op[8] = {MN_ADD, MN_SLL, MN_SLT, MN_SLTU, MN_XOR, MN_SRL, MN_OR, MN_AND};
+	static const uint8_t opM[8] = {MN_MUL, MN_MULH, MN_MULHSU, MN_MULHU, MN_DIV, MN_DIVU, MN_REM, MN_REMU};
+	static const uint8_t csrs[8] = {MN_INVALIDA, MN_CSRRW, MN_CSRRS, MN_CSRRC, MN_INVALIDA, MN_CSRRWI, MN_CSRRSI, MN_CSRRCI};
+
+	const uint32_t funct3 = (instrucao >> 12) & 0b111;
+	const uint32_t funct7 = instrucao >> 25;
+	int mnemonico = MN_INVALIDA;
+
+	switch (instrucao & 0b1111111)
+	{
+	case 0b0110111:
+		mnemonico = MN_LUI;
+		break;
+	case 0b0010111:
+		mnemonico = MN_AUIPC;
+		break;
+	case 0b1101111:
+		mnemonico = MN_JAL;
+		break;
+	case 0b1100111:
+		mnemonico = funct3 == 0 ? MN_JALR : MN_INVALIDA;
+		break;
+	case 0b1100011:
+		mnemonico = desvios[funct3];
+		if (ef->desvio >= 0)
+			e->desvios[ef->desvio]++;
+		break;
+	case 0b0000011:
+		mnemonico = loads[funct3];
+		break;
+	case 0b0100011:
+		mnemonico = stores[funct3];
+		break;
+	case 0b0010011:
+		mnemonico = (funct3 == 0b101 && funct7 == 0b0100000) ? MN_SRAI : opImm[funct3];
+		break;
+	case 0b0110011:
+		if (funct7 == 0b0000001)
+			mnemonico = opM[funct3];
+		else if (funct7 == 0b0100000)
+			mnemonico = funct3 == 0b000 ? MN_SUB : funct3 == 0b101 ? MN_SRA : MN_INVALIDA;
+		else if (funct7 == 0)
+			mnemonico = op[funct3];
+		break;
+	case 0b0101111:
+		switch (funct7 >> 2)
+		{
+		case 0b00010: mnemonico = MN_LR_W; break;
+		case 0b00011: mnemonico = MN_SC_W; break;
+		case 0b00001: mnemonico = MN_AMOSWAP_W; break;
+		case 0b00000: mnemonico = MN_AMOADD_W; break;
+		case 0b00100: mnemonico = MN_AMOXOR_W; break;
+		case 0b01100: mnemonico = MN_AMOAND_W; break;
+		case 0b01000: mnemonico = MN_AMOOR_W; break;
+		case 0b10000: mnemonico = MN_AMOMIN_W; break;
+		case 0b10100: mnemonico = MN_AMOMAX_W; break;
+		case 0b11000: mnemonico = MN_AMOMINU_W; break;
+		case 0b11100: mnemonico = MN_AMOMAXU_W; break;
+		}
+		break;
+	case 0b1110011:
+		if (funct3 != 0)
+			mnemonico = csrs[funct3];
+		else
+			mnemonico = (instrucao >> 20) == 0x000 ? MN_ECALL
+						: (instrucao >> 20) == 0x001 ? MN_EBREAK
+						: (instrucao >> 20) == 0x302 ? MN_MRET
+						: (instrucao >> 20) == 0x105 ? MN_WFI
+													 : MN_INVALIDA;
+		break;
+	}
+	e->mnemonicos[mnemonico]++;
+}
 
-	FILE *input2 = fopen("qemu.terminal.in", "r");	 // Abre o arquivo de entrada UART
-	FILE *output2 = fopen("qemu.terminal.out", "w"); // Abre/cria o arquivo de saída UART
+// latências de traps: quando a fonte da interrupção ficou pendente, quando o trap foi tomado e quando o mret voltou
+// (exceções são síncronas: ficam pendentes no mesmo instante em que são tomadas)
+// histogramas em potências de 2: balde 0 = valor 0, balde k = [2^(k-1), 2^k)
+#define BALDES_LATENCIA 65
+#define MAX_TRAPS_ATIVOS 16
 
-	//FILE *input = fopen("input.hex", "r");
-	//FILE *output = fopen("output.out", "w");
+typedef struct
+{
+	uint64_t quantidade;
+	uint64_t soma;
+	uint64_t minimo;
+	uint64_t maximo;
+	uint64_t baldes[BALDES_LATENCIA];
+} Histograma;
+
+// trap em tratamento (há mais de um quando o tratador religa mstatus.MIE)
+typedef struct
+{
+	int tipo; // índice dos histogramas
+	uint64_t instrucoes;
+	uint64_t mtime;
+} TrapAtivo;
 
-	// offset é o ponto de partida da memória simulada
-	// const uint32_t offset = 0x80000000; // Vamos fingir que a memória do processador começa no endereço 0x80000000. offset significa deslocamento
-	const uint32_t offset = 0x80000000;
+// tipos de trap: 0..15 exceções por mcause, 16..31 interrupções por código (3 = software, 7 = timer, 11 = externa)
+#define TIPOS_TRAP 32
+#define TIPO_TRAP(causa) ((((causa) >> 31) << 4) | ((causa) & 0xF))
 
-	uint32_t registradores[32] = {0}; // 32 registradores inicializados com 0
-	// abreviações do RISC-V para os registradores0
-	const char *regNomes[32] = {"zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+struct Latencias
+{
+	// fontes de interrupção pendentes (por código) e quando ficaram pendentes
+	uint8_t pendente[16];
+	uint64_t pendenteInstrucoes[16];
+	uint64_t pendenteMtime[16];
+
+	TrapAtivo traps[MAX_TRAPS_ATIVOS];
+	int numTraps; // pode passar de MAX_TRAPS_ATIVOS: os mais internos não são guardados
+
+	uint64_t tomados[TIPOS_TRAP];
+	Histograma esperaInstrucoes[TIPOS_TRAP]; // pendente -> tomado
+	Histograma esperaMtime[TIPOS_TRAP];
+	Histograma tratamentoInstrucoes[TIPOS_TRAP]; // tomado -> mret
+	Histograma tratamentoMtime[TIPOS_TRAP];
+};
+
+static void registrarLatencia(Histograma *h, uint64_t valor)
+{
+	if (h->quantidade == 0 || valor < h->minimo)
+		h->minimo = valor;
+	if (valor > h->maximo)
+		h->maximo = valor;
+	h->quantidade++;
+	h->soma += valor;
+	h->baldes[valor == 0 ? 0 : 64 - __builtin_clzll(valor)]++;
+}
 
-	// registradores CSRs
-	uint32_t registradoresCSRs[7] = {0};
-	// nome dos registradores CSRs
-	const char *regNomesCSRs[7] = {"mstatus", "mie", "mtvec", "mepc", "mcause", "mtval", "mip"};
+// chamada depois de cada instrução, antes da verificação das interrupções: marca quando cada fonte passou a
+// pedir interrupção (mtime atingiu mtimecmp, msip escrito, UART ligou o bit 10 de plic_pending)
+static void observarPendencias(Latencias *l, const Maquina *m, uint64_t instrucoes)
+{
+	const uint8_t ativas[3] = {
+		m->clint_mtime >= __atomic_load_n(&m->clint_mtimecmp, __ATOMIC_RELAXED),
+		__atomic_load_n(&m->clint_msip, __ATOMIC_RELAXED) & 0x1,
+		(m->plic_pending >> 10) & 0x1,
+	};
+	static const uint8_t codigos[3] = {7, 3, 11};
+	for (int i = 0; i < 3; i++)
+	{
+		const int c = codigos[i];
+		if (ativas[i] && !l->pendente[c])
+		{
+			l->pendente[c] = 1;
+			l->pendenteInstrucoes[c] = instrucoes;
+			l->pendenteMtime[c] = m->clint_mtime;
+		}
+		else if (!ativas[i])
+		{
+			l->pendente[c] = 0;
+		}
+	}
+}
 
-	// registradores uart
-	uint32_t registradoresUART[6] = {0};
+// entrada em trap (mcause já escrito); a fonte volta a contar como pendente a partir daqui se continuar ativa
+static void entrarTrap(Latencias *l, const Maquina *m, uint32_t causa, uint64_t instrucoes)
+{
+	const int tipo = TIPO_TRAP(causa);
+	uint64_t esperaInstrucoes = 0, esperaMtime = 0;
+	if ((causa >> 31) && l->pendente[causa & 0xF])
+	{
+		esperaInstrucoes = instrucoes - l->pendenteInstrucoes[causa & 0xF];
+		esperaMtime = m->clint_mtime - l->pendenteMtime[causa & 0xF];
+		l->pendenteInstrucoes[causa & 0xF] = instrucoes;
+		l->pendenteMtime[causa & 0xF] = m->clint_mtime;
+	}
+	l->tomados[tipo]++;
+	registrarLatencia(&l->esperaInstrucoes[tipo], esperaInstrucoes);
+	registrarLatencia(&l->esperaMtime[tipo], esperaMtime);
 
-	// Registradores clint
-	uint32_t clint_msip = 0;	  // interrupção de software (MSIP)
-	uint64_t clint_mtime = 0;	  // contador de tempo (MTIME)
-	uint64_t clint_mtimecmp = -1; // alvo da interrupção (MTIMECMP)
+	if (l->numTraps < MAX_TRAPS_ATIVOS)
+		l->traps[l->numTraps] = (TrapAtivo){tipo, instrucoes, m->clint_mtime};
+	l->numTraps++;
+}
 
-	// Registradores PLIC
-	uint32_t plic_priority = 0;
-	uint32_t plic_pending = 0;
-	uint32_t plic_enable = 0;
-	uint32_t plic_threshold = 0;
-	uint32_t plic_claim = 0;
+// mret: fecha o trap mais recente
+static void sairTrap(Latencias *l, const Maquina *m, uint64_t instrucoes)
+{
+	if (l->numTraps == 0)
+		return; // mret sem trap registrado (instrumentação ligada no meio de um tratador)
+	l->numTraps--;
+	if (l->numTraps >= MAX_TRAPS_ATIVOS)
+		return;
+	const TrapAtivo *t = &l->traps[l->numTraps];
+	registrarLatencia(&l->tratamentoInstrucoes[t->tipo], instrucoes - t->instrucoes);
+	registrarLatencia(&l->tratamentoMtime[t->tipo], m->clint_mtime - t->mtime);
+}
 
-	// inicialização de mtvec pra ebreak
-	// tirar no projeto final
-	registradoresUART[5] = 0x04;
+// mapa de acessos à memória: leituras e escritas por bloco de TAM_BLOCO_ACESSO bytes da RAM (vetor sombra de mem)
+// e por registrador MMIO; a cada "cada" instruções guarda quantos blocos distintos foram tocados (conjunto de trabalho)
+#define TAM_BLOCO_ACESSO 64
+#define BLOCOS_ACESSO (TAM_MEMORIA / TAM_BLOCO_ACESSO)
+#define MAX_REGISTRADORES_MMIO 64
 
-	// registrador pc inicializado com offset. pq o offset é quem esta com o endereço inicial da memoria simulada
-	//  o pc é o marca pagina (mostra onde vc esta agora e avança para a proxima instrução)
-	//  aponta para o endereço da próxima instrução a ser executada.
-	uint32_t pc = offset;
+typedef struct
+{
+	uint64_t instrucoes;
+	uint32_t janela;	// blocos tocados desde a amostra anterior
+	uint32_t acumulado; // blocos tocados desde o início
+} AmostraConjunto;
 
-	// 32 KIB alocados dinamicamente para armazenar dados e instruções
-	// mem será a memória simulada que o processador acessa durante a execução.
-	uint8_t *mem = (uint8_t *)malloc(32 * 1024); // Cada posição de memória armazena 1 byte (8 bits) por isso uint8_t; 1 KiB = 1024 bytes
+struct MapaAcessos
+{
+	uint32_t leituras[BLOCOS_ACESSO];
+	uint32_t escritas[BLOCOS_ACESSO];
+	uint64_t tocadosJanela[(BLOCOS_ACESSO + 63) / 64];
+	uint64_t tocados[(BLOCOS_ACESSO + 63) / 64];
 
-	// leitura do conteúdo da memória a partir de um arquivo hexadecimal de entrada
-	// o input é o ponteiro da entrada
-	uint32_t contadorMem = offset; // variavel para atualizar o endereço apartir do offset e depois armazenar na memmoria
-	char entrada[1000];			   // variavel para armazenar os carateres do arquivo de entrada
+	// registradores MMIO pelo endereço exato (os que passam de MAX_REGISTRADORES_MMIO vão para outrosMmio)
+	struct
+	{
+		uint32_t endereco;
+		uint64_t leituras;
+		uint64_t escritas;
+	} mmio[MAX_REGISTRADORES_MMIO];
+	int numMmio;
+	uint64_t outrosMmio[2];
+
+	uint64_t cada;
+	uint64_t proxima;
+	AmostraConjunto *amostras;
+	size_t numAmostras;
+	size_t capacidadeAmostras;
+};
+
+static int contarBits(const uint64_t *bits, size_t palavras)
+{
+	int total = 0;
+	for (size_t i = 0; i < palavras; i++)
+		total += __builtin_popcountll(bits[i]);
+	return total;
+}
 
-	while (1)
+static void amostrarConjunto(MapaAcessos *a, uint64_t instrucoes)
+{
+	if (a->numAmostras == a->capacidadeAmostras)
 	{
-		char enderecoHex[10]; // para armazenar e depois converter o endereço dos dados
-		if (fgets(entrada, sizeof(entrada), input) == NULL)
-			break; // caso a leitura do arquivo acabe o laço para de rodar
-		if (entrada[0] == '@')
-		{ // separando o endereço
-			for (int i = 0; i < 8; i++)
-			{
-				enderecoHex[i] = entrada[i + 1]; // ignora o @ e armazenar os 8 caracteres em enderecoHex
-			}
-			enderecoHex[8] = '\0';						  // para terminar a string
-			contadorMem = strtoll(enderecoHex, NULL, 16); // convertendo a entrada de endereço (dado que começa com @)
-		}
+		const size_t capacidade = a->capacidadeAmostras ? 2 * a->capacidadeAmostras : 256;
+		AmostraConjunto *novas = realloc(a->amostras, capacidade * sizeof(AmostraConjunto));
+		if (novas == NULL)
+			return; // sem memória: a curva para aqui, os contadores continuam
+		a->amostras = novas;
+		a->capacidadeAmostras = capacidade;
+	}
+	a->amostras[a->numAmostras++] = (AmostraConjunto){instrucoes, contarBits(a->tocadosJanela, sizeof(a->tocadosJanela) / 8),
+													  contarBits(a->tocados, sizeof(a->tocados) / 8)};
+	memset(a->tocadosJanela, 0, sizeof(a->tocadosJanela));
+}
 
+static void contarAcesso(MapaAcessos *a, uint32_t endereco, int escrita)
+{
+	const uint32_t deslocamento = endereco - OFFSET_MEMORIA;
+	if (deslocamento < TAM_MEMORIA)
+	{
+		const uint32_t bloco = deslocamento / TAM_BLOCO_ACESSO;
+		if (escrita)
+			a->escritas[bloco]++;
 		else
-		{
-			unsigned int byte;
-			char *p = entrada;
-			while (sscanf(p, "%2x", &byte) == 1)
-			{
-				mem[contadorMem - offset] = (uint8_t)byte;
-				contadorMem++;
-
-				while (*p == ' ')
-					p++; // pula espaços extras
-				p += 2;	 // avança pro próximo par de caracteres hex
-			}
-		}
+			a->leituras[bloco]++;
+		a->tocadosJanela[bloco / 64] |= 1ull << (bloco % 64);
+		a->tocados[bloco / 64] |= 1ull << (bloco % 64);
+		return;
 	}
 
-	// inicio do simulador de instruções
-	uint8_t run = 1; // pra controlar o loop
-	// laço principal de execução do simulador
-	while (run)
+	for (int i = 0; i < a->numMmio; i++)
 	{
-		// Tratamento da exceção 1 — Instruction Access Fault. Quando pc está fora da memória válida
-		if (pc < offset || pc >= offset + 32 * 1024)
+		if (a->mmio[i].endereco == endereco)
 		{
-			prepMstatus(&registradoresCSRs[0]);							 // preparar mstatus para a excessão
-			registrarExcecao(1, pc, pc, registradoresCSRs, output, &pc); // Instruction access fault
-			continue;
+			escrita ? a->mmio[i].escritas++ : a->mmio[i].leituras++;
+			return;
 		}
+	}
+	if (a->numMmio == MAX_REGISTRADORES_MMIO)
+	{
+		a->outrosMmio[escrita]++;
+		return;
+	}
+	a->mmio[a->numMmio].endereco = endereco;
+	a->mmio[a->numMmio].leituras = !escrita;
+	a->mmio[a->numMmio].escritas = escrita;
+	a->numMmio++;
+}
 
-		// converte mem para um tipo de 4 bytes, acessa a posição correta da instrução dividindo por 4 para acessar apenas 1  instrução inteira  por indice
-		// uint32_t instrucao = ((uint32_t*)mem)[(pc - offset)>>2];
-		uint32_t instrucao = ((uint32_t *)(mem))[(pc - offset) >> 2];
+// fecha a janela do conjunto de trabalho quando ela completa "cada" instruções
+static void avancarJanelaAcessos(MapaAcessos *a, uint64_t instrucoes)
+{
+	if (instrucoes >= a->proxima)
+	{
+		amostrarConjunto(a, instrucoes);
+		a->proxima = instrucoes + a->cada;
+	}
+}
 
-		// if (pc < offset || pc >= offset + 32 * 1024)
-		//{
-		//	printf("PC fora do intervalo da memória: 0x%08x\n", pc);
-		//	run = 0;
-		//	break; // ou run = 0;
-		// }
+// modelo de caches L1 (instruções e dados) para estimar ciclos: associativas por conjunto, write-back com
+// alocação na escrita; só a RAM passa pelas caches (MMIO não é cacheável)
+// estimativa: 1 ciclo por instrução + penalidade por falta e por linha suja escrita de volta
+enum
+{
+	POLITICA_LRU,
+	POLITICA_FIFO,
+	POLITICA_ALEATORIA,
+};
 
-		// agora cada indice de mem pega 4 bytes que é uma instrução inteira
-		// caso não funcione trocara /4 por >>2
-		// obtenfdo o opcode para manter os 7 bits menos significativos (da direita) da instrução, e ignorar o resto
-		const uint32_t opcode = instrucao & 0b1111111; // o & vai filtrar o bits que queremos pois ele só repete 1 se for exatamente igual então armazena exatamente o mesmo numero no mesmo lugar
-		// inicializando os campos que tem que usar para identificar as instruções
-		// o >> desloca a quantidade de bits necessaria
-		const uint8_t funct7 = instrucao >> 25;			  // complemento, usado em operações
-		const int32_t imm_i = ((int32_t)instrucao) >> 20; // valor imediato com sinal (Tipo I)
-		// const uint8_t uimm = (instrucao >> 20) & 0b11111; // valor imediato sem sinal (shift, Tipo I)
-		const uint8_t rs1 = (instrucao >> 15) & 0b11111;  // registrador de origem 1
-		const uint8_t rs2 = (instrucao >> 20) & 0b11111;  // registrador de origem 2
-		const uint8_t funct3 = (instrucao >> 12) & 0b111; // diferencia instruções com o mesmo opcode
-		const uint8_t rd = (instrucao >> 7) & 0b11111;	  // registrador onde armazena o resultado
-														  // const int32_t imm_s = ((instrucao >> 25) << 5) | ((instrucao >> 7) & 0b11111); // imediato do tipo S (armazenamento)
-		int32_t imm_b = ((instrucao >> 31) & 0x1) << 12 |
-						((instrucao >> 7) & 0x1) << 11 |
-						((instrucao >> 25) & 0x3F) << 5 |
-						((instrucao >> 8) & 0xF) << 1;
+static const char *nomesPoliticas[] = {"lru", "fifo", "aleatoria"};
 
-		if (imm_b & 0x1000)
-			imm_b |= 0xFFFFE000;
+typedef struct
+{
+	uint32_t bloco;	   // endereço / linha (a tag inclui o índice do conjunto)
+	uint8_t valida;
+	uint8_t suja;
+	uint64_t carimbo; // último uso (LRU) ou chegada (FIFO)
+} LinhaCache;
 
-		int32_t imm_j = 0;
-		imm_j |= ((instrucao >> 31) & 0x1) << 20;
-		imm_j |= ((instrucao >> 21) & 0x3FF) << 1;
-		imm_j |= ((instrucao >> 20) & 0x1) << 11;
-		imm_j |= ((instrucao >> 12) & 0xFF) << 12;
-		if (imm_j & (1 << 20))
-			imm_j |= 0xFFF00000; // imediato do tipo J (jump)
+typedef struct
+{
+	uint32_t tamanho;
+	uint32_t vias;
+	uint32_t linha;
+	uint32_t conjuntos;
+	int bitsLinha;
+	int politica;
+	LinhaCache *linhas; // conjuntos * vias
+	uint64_t relogio;
+	uint32_t semente; // xorshift da política aleatória
+
+	uint64_t acessos;
+	uint64_t faltas;
+	uint64_t escritasDeVolta;
+} Cache;
+
+struct ModeloCache
+{
+	Cache instrucoes;
+	Cache dados;
+	uint32_t penalidade; // ciclos por falta (e por escrita de volta)
+};
 
-		const int32_t imm_u = instrucao & 0xFFFFF000;	   // imediato do tipo U (lui/auipc)
-		const uint8_t shamt = (instrucao >> 20) & 0b11111; // extrai 5 bits
+// configuração "tamanho,vias,linha[,politica]" (bytes; politica = lru, fifo ou aleatoria)
+static int configurarCache(Cache *c, const char *config, const char *nome)
+{
+	char politica[16] = "lru";
+	memset(c, 0, sizeof(*c));
+	if (sscanf(config, "%u,%u,%u,%15s", &c->tamanho, &c->vias, &c->linha, politica) < 3 || c->vias == 0 ||
+		c->linha < 4 || (c->linha & (c->linha - 1)) != 0 || c->tamanho % (c->vias * c->linha) != 0)
+	{
+		fprintf(stderr, "Configuração inválida da %s: %s (use tamanho,vias,linha[,lru|fifo|aleatoria]).\n", nome, config);
+		return -1;
+	}
+	c->conjuntos = c->tamanho / (c->vias * c->linha);
+	if (c->conjuntos == 0 || (c->conjuntos & (c->conjuntos - 1)) != 0)
+	{
+		fprintf(stderr, "Configuração inválida da %s: o número de conjuntos precisa ser potência de 2.\n", nome);
+		return -1;
+	}
+	c->politica = -1;
+	for (int i = 0; i < (int)(sizeof(nomesPoliticas) / sizeof(nomesPoliticas[0])); i++)
+	{
+		if (strcmp(politica, nomesPoliticas[i]) == 0)
+			c->politica = i;
+	}
+	if (c->politica < 0)
+	{
+		fprintf(stderr, "Política de substituição desconhecida na %s: %s.\n", nome, politica);
+		return -1;
+	}
+	c->bitsLinha = __builtin_ctz(c->linha);
+	c->semente = 0x9E3779B9u;
+	c->linhas = calloc((size_t)c->conjuntos * c->vias, sizeof(LinhaCache));
+	if (c->linhas == NULL)
+	{
+		fprintf(stderr, "Sem memória para a %s.\n", nome);
+		return -1;
+	}
+	return 0;
+}
 
-		int32_t imm_s = (((instrucao >> 25) & 0x7F) << 5) | ((instrucao >> 7) & 0x1F);
-		if (imm_s & 0x800)
-			imm_s |= 0xFFFFF000;
+// retorna 1 em acerto
+static int acessarCache(Cache *c, uint32_t endereco, int escrita)
+{
+	const uint32_t bloco = endereco >> c->bitsLinha;
+	LinhaCache *linhas = &c->linhas[(bloco & (c->conjuntos - 1)) * c->vias];
+	c->relogio++;
+	c->acessos++;
 
-		// instruções tipo R
-		switch (opcode)
+	for (uint32_t v = 0; v < c->vias; v++)
+	{
+		if (linhas[v].valida && linhas[v].bloco == bloco)
 		{
-			// tipo R-type
-		case 0b0110011:
-			// add (soma)
-			if (funct3 == 0b000 && funct7 == 0b0000000)
-			{
-				const uint32_t resultado = registradores[rs1] + registradores[rs2];
-				fprintf(output, "0x%08x:add %s,%s,%s %s=0x%08x+0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						registradores[rs2], // Valor de rs2
-						resultado);
+			if (c->politica == POLITICA_LRU)
+				linhas[v].carimbo = c->relogio;
+			linhas[v].suja |= escrita;
+			return 1;
+		}
+	}
 
-				// Atualizando o registrador de destino, se não for registradores[0]
-				if (rd != 0)
-				{ // Ela atualiza o registrador destino rd com o valor do cálculo (data), mas só se o registrador rd não for o registrador x0.
-					registradores[rd] = resultado;
-				}
-			}
-			// sub (subtração)
-			else if (funct7 == 0b0100000 && funct3 == 0b000)
+	// falta: ocupa uma via livre ou substitui uma pela política
+	c->faltas++;
+	uint32_t vitima = c->vias;
+	for (uint32_t v = 0; v < c->vias && vitima == c->vias; v++)
+	{
+		if (!linhas[v].valida)
+			vitima = v;
+	}
+	if (vitima == c->vias)
+	{
+		if (c->politica == POLITICA_ALEATORIA)
+		{
+			c->semente ^= c->semente << 13;
+			c->semente ^= c->semente >> 17;
+			c->semente ^= c->semente << 5;
+			vitima = c->semente % c->vias;
+		}
+		else
+		{
+			vitima = 0;
+			for (uint32_t v = 1; v < c->vias; v++)
 			{
-				const uint32_t resultado = registradores[rs1] - registradores[rs2];
-				fprintf(output, "0x%08x:sub %s,%s,%s %s=0x%08x-0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						registradores[rs2], // Valor de rs2
-						resultado);
-
-				if (rd != 0)
-				{
-					registradores[rd] = resultado;
-				}
+				if (linhas[v].carimbo < linhas[vitima].carimbo)
+					vitima = v;
 			}
+		}
+		if (linhas[vitima].suja)
+			c->escritasDeVolta++;
+	}
+	linhas[vitima] = (LinhaCache){bloco, 1, (uint8_t)escrita, c->relogio};
+	return 0;
+}
 
-			// sll (desloca o conteúdo de rs1 logicamente para a esquerda)
-			else if (funct3 == 0b001 && funct7 == 0b0000000)
-			{
-				const uint8_t deslocar = registradores[rs2] & 0b11111;	   // filtra os 5 bits menos significativos
-				const uint32_t resultado = registradores[rs1] << deslocar; // desloca os 5 bits a esquerda
+// acesso a dados de um load/store/AMO que executou: chamada depois da instrução, então os que geram exceção
+// (fora da memória, funct3 inválido, AMO desalinhado) não contam nas estatísticas, no mapa de acessos nem na cache
+// de dados (só a RAM passa pela cache)
+static void registrarAcessoDados(Estatisticas *e, MapaAcessos *a, ModeloCache *mc, const EfeitoInstrucao *ef)
+{
+	if (e != NULL && ef->acesso == ACESSO_LOAD)
+		e->loads[regiaoEndereco(ef->endereco)]++;
+	else if (e != NULL && ef->acesso == ACESSO_STORE)
+		e->stores[regiaoEndereco(ef->endereco)]++;
+	if (a != NULL && ef->leitura)
+		contarAcesso(a, ef->endereco, 0);
+	if (a != NULL && ef->escrita)
+		contarAcesso(a, ef->endereco, 1);
+	if (mc != NULL && ef->endereco - OFFSET_MEMORIA < TAM_MEMORIA)
+		acessarCache(&mc->dados, ef->endereco, ef->escrita);
+}
 
-				fprintf(output, "0x%08x:sll %s,%s,%s %s=0x%08x<<u5=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						resultado);
+static uint64_t ciclosEstimados(const ModeloCache *mc)
+{
+	return mc->instrucoes.acessos + (uint64_t)mc->penalidade * (mc->instrucoes.faltas + mc->dados.faltas +
+																 mc->dados.escritasDeVolta);
+}
 
-				if (rd != 0)
-				{
-					registradores[rd] = resultado;
-				}
-			}
+// modelo de tempo de um pipeline em ordem de 5 estágios (IF ID EX MEM WB) com adiantamento:
+// 1 ciclo por instrução + 4 para encher o pipeline + bolhas (load seguido de uso do resultado, mul/div de vários
+// ciclos, desvios e saltos, redirecionamentos por trap/mret); com o modelo de caches ligado, as faltas também contam
+// desvios condicionais são resolvidos em EX (erro de previsão = 2 bolhas) e o alvo de um desvio previsto tomado e de
+// jal só é conhecido em ID (1 bolha); jalr espera EX (2 bolhas)
+enum
+{
+	PREDITOR_ESTATICO, // para trás tomado, para frente não tomado
+	PREDITOR_BIMODAL,  // contadores de 2 bits indexados pelo pc
+	PREDITOR_GSHARE,   // contadores de 2 bits indexados por pc xor histórico global
+};
+
+static const char *nomesPreditores[] = {"estatico", "bimodal", "gshare"};
+
+enum
+{
+	BOLHA_LOAD_USO,
+	BOLHA_MUL,
+	BOLHA_DIV,
+	BOLHA_PREVISAO, // desvio condicional previsto errado
+	BOLHA_SALTO,	// desvio tomado previsto certo, jal e jalr
+	BOLHA_TRAP,		// exceção, interrupção ou mret
+	NUM_BOLHAS
+};
+
+static const char *nomesBolhas[NUM_BOLHAS] = {"load_uso", "mul", "div", "previsao_errada", "saltos", "traps"};
+
+struct ModeloPipeline
+{
+	int preditor;
+	int bitsTabela;
+	uint8_t *contadores; // 2^bitsTabela contadores saturados de 2 bits
+	uint32_t historico;
+	uint32_t latenciaMul;
+	uint32_t latenciaDiv;
+
+	uint64_t instrucoes;
+	uint64_t bolhas[NUM_BOLHAS];
+	uint64_t desvios;
+	uint64_t desviosTomados;
+	uint64_t previsoesErradas;
+	uint64_t saltos;
+
+	uint32_t rdLoad;	  // destino do load anterior (0 = a instrução anterior não era load)
+	uint32_t pcSeguinte; // pc esperado da próxima instrução; outro valor = trap ou mret
+	int iniciado;
+};
+
+// prevê e treina o preditor; retorna a previsão
+static int preverDesvio(ModeloPipeline *mp, uint32_t pc, uint32_t alvo, int tomado)
+{
+	if (mp->preditor == PREDITOR_ESTATICO)
+		return alvo <= pc;
+
+	const uint32_t mascara = (1u << mp->bitsTabela) - 1;
+	const uint32_t indice = ((pc >> 2) ^ (mp->preditor == PREDITOR_GSHARE ? mp->historico : 0)) & mascara;
+	uint8_t *contador = &mp->contadores[indice];
+	const int previsto = *contador >= 2;
+	if (tomado && *contador < 3)
+		(*contador)++;
+	else if (!tomado && *contador > 0)
+		(*contador)--;
+	mp->historico = ((mp->historico << 1) | (uint32_t)tomado) & mascara;
+	return previsto;
+}
+
+// conta a instrução antes de executá-la (o resultado dos desvios e o alvo de jalr vêm do efeito decodificado)
+static void simularPipeline(ModeloPipeline *mp, uint32_t pc, uint32_t instrucao, const EfeitoInstrucao *ef)
+{
+	const uint32_t opcode = instrucao & 0b1111111;
+	const uint32_t rd = (instrucao >> 7) & 0b11111;
+	const uint32_t rs1 = (instrucao >> 15) & 0b11111;
+	const uint32_t rs2 = (instrucao >> 20) & 0b11111;
+	const uint32_t funct3 = (instrucao >> 12) & 0b111;
+
+	mp->instrucoes++;
+	if (mp->iniciado && pc != mp->pcSeguinte)
+		mp->bolhas[BOLHA_TRAP] += 2; // o pipeline é esvaziado como num erro de previsão
+	mp->iniciado = 1;
+
+	// load seguido de instrução que usa o valor: o adiantamento de MEM para EX custa 1 ciclo
+	// (em csrr*i o campo rs1 é o imediato e ecall/ebreak/mret/wfi não leem registradores)
+	const int usaRs1 = opcode != 0b0110111 && opcode != 0b0010111 && opcode != 0b1101111 &&
+					   !(opcode == 0b1110011 && (funct3 == 0b000 || (funct3 & 0b100)));
+	const int usaRs2 = opcode == 0b1100011 || opcode == 0b0100011 || opcode == 0b0110011 || opcode == 0b0101111;
+	if (mp->rdLoad != 0 && ((usaRs1 && rs1 == mp->rdLoad) || (usaRs2 && rs2 == mp->rdLoad)))
+		mp->bolhas[BOLHA_LOAD_USO]++;
+	mp->rdLoad = (opcode == 0b0000011 || opcode == 0b0101111) ? rd : 0;
+
+	switch (opcode)
+	{
+	case 0b0110011:
+		if ((instrucao >> 25) == 0b0000001)
+		{
+			if (funct3 < 0b100)
+				mp->bolhas[BOLHA_MUL] += mp->latenciaMul - 1;
+			else
+				mp->bolhas[BOLHA_DIV] += mp->latenciaDiv - 1;
+		}
+		break;
+	case 0b1100011:
+	{
+		if (ef->desvio < 0)
+			break;
+		const int tomado = ef->desvio;
+		const int previsto = preverDesvio(mp, pc, ef->alvo, tomado);
+
+		mp->desvios++;
+		mp->desviosTomados += tomado;
+		if (previsto != tomado)
+		{
+			mp->previsoesErradas++;
+			mp->bolhas[BOLHA_PREVISAO] += 2;
+		}
+		else if (tomado)
+		{
+			mp->bolhas[BOLHA_SALTO]++;
+		}
+		break;
+	}
+	case 0b1101111:
+		mp->saltos++;
+		mp->bolhas[BOLHA_SALTO]++;
+		break;
+	case 0b1100111:
+		mp->saltos++;
+		mp->bolhas[BOLHA_SALTO] += 2;
+		break;
+	}
+	mp->pcSeguinte = ef->proximo;
+}
+
+// vetores de blocos básicos (BBV, formato do SimPoint): a cada "intervalo" instruções grava uma linha
+// "T:id:instrucoes :id:instrucoes ..." com as instruções executadas em cada bloco no intervalo; um bloco começa
+// depois de desvio, salto ou instrução de sistema e em todo pc que não segue o anterior (traps)
+struct VetorBlocos
+{
+	uint16_t ids[TAM_MEMORIA / 4];			 // bloco que começa em cada palavra da RAM (0 = nenhum)
+	uint32_t contagens[TAM_MEMORIA / 4 + 1]; // instruções por bloco no intervalo atual
+	uint16_t tocados[TAM_MEMORIA / 4];		 // blocos com contagem no intervalo atual
+	int numTocados;
+	uint16_t numBlocos;
+	uint16_t blocoAtual;
+	uint32_t pcSeguinte;
+	int fimDeBloco;
+	uint64_t intervalo;
+	uint64_t proximo;
+	FILE *saida;
+};
+
+static void gravarIntervaloBlocos(VetorBlocos *vb)
+{
+	fputc('T', vb->saida);
+	for (int i = 0; i < vb->numTocados; i++)
+	{
+		const uint16_t id = vb->tocados[i];
+		fprintf(vb->saida, ":%u:%u ", id, vb->contagens[id]);
+		vb->contagens[id] = 0;
+	}
+	fputc('\n', vb->saida);
+	vb->numTocados = 0;
+}
+
+static void contarBlocoBasico(VetorBlocos *vb, uint32_t pc, uint32_t instrucao, uint64_t instrucoes)
+{
+	if (pc != vb->pcSeguinte || vb->fimDeBloco || vb->blocoAtual == 0)
+	{
+		uint16_t *id = &vb->ids[(pc - OFFSET_MEMORIA) >> 2];
+		if (*id == 0)
+			*id = ++vb->numBlocos;
+		vb->blocoAtual = *id;
+	}
+	if (vb->contagens[vb->blocoAtual]++ == 0)
+		vb->tocados[vb->numTocados++] = vb->blocoAtual;
+
+	const uint32_t opcode = instrucao & 0b1111111;
+	vb->fimDeBloco = opcode == 0b1100011 || opcode == 0b1101111 || opcode == 0b1100111 || opcode == 0b1110011;
+	vb->pcSeguinte = pc + 4;
+
+	if (instrucoes >= vb->proximo)
+	{
+		gravarIntervaloBlocos(vb);
+		vb->proximo += vb->intervalo;
+	}
+}
+
+// gatilho do avanço rápido: confere, antes de executar a instrução, se ela é a primeira a ser rastreada
+static int verificarGatilho(const Gatilho *g, uint32_t pc, uint32_t instrucao, const uint32_t *registradores,
+							uint64_t instrucoes)
+{
+	EfeitoInstrucao ef;
+	switch (g->tipo)
+	{
+	case GATILHO_INSTRUCOES:
+		return instrucoes >= g->valor;
+	case GATILHO_PC:
+		return pc == g->valor;
+	case GATILHO_ESCRITA:
+		decodificarEfeito(pc, instrucao, registradores, &ef);
+		return ef.escrita && (uint32_t)g->valor - ef.endereco < ef.tamanho;
+	default:
+		return 0;
+	}
+}
+
+// liga o trace guardado pelo gatilho e desliga o gatilho; devolve o arquivo de trace
+static FILE *dispararGatilho(Maquina *m)
+{
+	m->saida = m->gatilho->trace;
+	free(m->gatilho);
+	m->gatilho = NULL;
+	return m->saida;
+}
+
+// cobertura de arestas no formato do AFL: cada desvio tomado, jal e jalr incrementa (saturando em 255) o byte
+// id(destino) ^ (id(origem) >> 1) de um mapa de TAM_MAPA_COBERTURA bytes; instruções sem salto não custam nada
+struct Cobertura
+{
+	uint8_t *mapa;
+	int donoMapa; // 0 = mapa de quem chamou poximAtivarCobertura (fuzzer, memória compartilhada do AFL)
+};
+
+static inline uint32_t idBlocoCobertura(uint32_t pc)
+{
+	return ((pc >> 2) * 0x9E3779B1u) >> (32 - BITS_MAPA_COBERTURA);
+}
+
+static inline void marcarAresta(uint8_t *mapa, uint32_t origem, uint32_t destino)
+{
+	uint8_t *contador = &mapa[idBlocoCobertura(destino) ^ (idBlocoCobertura(origem) >> 1)];
+	*contador += *contador != 255;
+}
+
+// contadores de desempenho Zicntr/Zihpm: nenhum é incrementado por instrução, o valor é calculado na leitura
+// (ciclos = instruções retiradas, time = mtime do CLINT, mhpmcounters a partir das estatísticas de execução)
+// csr & 0x1F escolhe o contador: 0 = cycle, 1 = time, 2 = instret, 3..31 = hpmcounter; o bit 0x80 é a metade alta
+// (também valem para mhpmevent3..31, 0x323..0x33F)
+// nome do contador no trace
+static const char *nomeCsrContador(uint32_t csr, char *nome, size_t tamanho)
+{
+	static const char *fixos[3] = {"cycle", "time", "instret"};
+	const uint32_t indice = csr & 0x1F;
+	const char *alta = (csr & 0x80) ? "h" : "";
+	if (csr >= 0x323 && csr <= 0x33F)
+		snprintf(nome, tamanho, "mhpmevent%u", indice);
+	else if (indice < 3)
+		snprintf(nome, tamanho, "%s%s%s", (csr >= 0xC00) ? "" : "m", fixos[indice], alta);
+	else
+		snprintf(nome, tamanho, "%shpmcounter%u%s", (csr >= 0xC00) ? "" : "m", indice, alta);
+	return nome;
+}
+
+// total atual de um evento de mhpmevent (0 enquanto as estatísticas estão desligadas)
+static uint64_t contagemEventoHpm(const Maquina *m, uint32_t evento)
+{
+	const ModeloCache *mc = m->modeloCache;
+	if (evento >= HPM_ICACHE_ACESSOS && evento <= HPM_CICLOS_ESTIMADOS)
+	{
+		if (mc == NULL)
+			return 0;
+		switch (evento)
+		{
+		case HPM_ICACHE_ACESSOS:
+			return mc->instrucoes.acessos;
+		case HPM_ICACHE_FALTAS:
+			return mc->instrucoes.faltas;
+		case HPM_DCACHE_ACESSOS:
+			return mc->dados.acessos;
+		case HPM_DCACHE_FALTAS:
+			return mc->dados.faltas;
+		case HPM_DCACHE_ESCRITAS_DE_VOLTA:
+			return mc->dados.escritasDeVolta;
+		default:
+			return ciclosEstimados(mc);
+		}
+	}
+
+	const Estatisticas *e = m->estatisticas;
+	uint64_t total = 0;
+	if (e == NULL)
+		return 0;
+	switch (evento)
+	{
+	case HPM_LOADS:
+		for (int i = 0; i < NUM_REGIOES; i++)
+			total += e->loads[i];
+		break;
+	case HPM_STORES:
+		for (int i = 0; i < NUM_REGIOES; i++)
+			total += e->stores[i];
+		break;
+	case HPM_DESVIOS_TOMADOS:
+		total = e->desvios[1];
+		break;
+	case HPM_EXCECOES:
+		for (int i = 0; i < 16; i++)
+			total += e->excecoes[i];
+		break;
+	case HPM_INTERRUPCOES:
+		for (int i = 0; i < 16; i++)
+			total += e->interrupcoes[i];
+		break;
+	case HPM_MMIO:
+		for (int i = REGIAO_RAM + 1; i < NUM_REGIOES; i++)
+			total += e->loads[i] + e->stores[i];
+		break;
+	}
+	return total;
+}
+
+// valor de 64 bits do contador (instrucoes inclui a instrução que está lendo, que ainda não terminou)
+static uint64_t valorContador(const Maquina *m, uint32_t indice, uint64_t instrucoes)
+{
+	if (indice == 1)
+		return m->clint_mtime;
+	if (indice == 0 || indice == 2)
+		return instrucoes - 1 - m->baseContadores[indice];
+	return contagemEventoHpm(m, m->eventosHpm[indice]) - m->baseContadores[indice];
+}
+
+static uint32_t lerContador(const Maquina *m, uint32_t csr, uint64_t instrucoes)
+{
+	if (csr >= 0x323 && csr <= 0x33F)
+		return m->eventosHpm[csr & 0x1F];
+	const uint64_t valor = valorContador(m, csr & 0x1F, instrucoes);
+	return (csr & 0x80) ? (uint32_t)(valor >> 32) : (uint32_t)valor;
+}
+
+// liga o modelo que conta o evento (caches ou estatísticas), se ainda não estiver ligado
+static void ativarFonteEvento(Maquina *m, uint32_t evento)
+{
+	if (evento >= HPM_ICACHE_ACESSOS && evento <= HPM_CICLOS_ESTIMADOS)
+	{
+		if (m->modeloCache == NULL)
+			poximAtivarCaches(m, NULL, NULL, 0); // configuração padrão
+	}
+	else if (evento != HPM_NENHUM && m->estatisticas == NULL)
+	{
+		poximAtivarEstatisticas(m);
+	}
+}
+
+// escrita em mcycle/minstret/mhpmcounter (metade baixa ou alta) ou em mhpmevent: só muda a base de cada contador
+static void escreverContador(Maquina *m, uint32_t csr, uint32_t valor, uint64_t instrucoes)
+{
+	const uint32_t indice = csr & 0x1F;
+	if (csr >= 0x323 && csr <= 0x33F)
+	{
+		// troca de evento: o contador continua do valor atual
+		const uint64_t atual = valorContador(m, indice, instrucoes);
+		ativarFonteEvento(m, valor);
+		m->eventosHpm[indice] = valor;
+		m->baseContadores[indice] = contagemEventoHpm(m, valor) - atual;
+		return;
+	}
+
+	const uint64_t atual = valorContador(m, indice, instrucoes);
+	const uint64_t novo = (csr & 0x80) ? ((uint64_t)valor << 32) | (uint32_t)atual : (atual & ~0xFFFFFFFFull) | valor;
+	if (indice == 0 || indice == 2)
+		m->baseContadores[indice] = instrucoes - novo; // a próxima instrução lê novo
+	else
+		m->baseContadores[indice] = contagemEventoHpm(m, m->eventosHpm[indice]) - novo;
+}
+
+// descritor de um CSR: onde fica o valor, quais bits o programa pode escrever e, quando o valor não é
+// só armazenado, as funções que o calculam/aplicam (recebem instrucoes, que ainda não está em m->instrucoes)
+typedef struct
+{
+	const char *nome; // NULL em CSRs com nome calculado (contadores) ou não implementados
+	int8_t indice;	  // posição em registradoresCSRs (-1 = sem armazenamento)
+	uint32_t mascaraEscrita;
+	uint32_t valorFixo; // valor dos CSRs sem armazenamento nem leitura própria (misa, mvendorid, ...)
+	uint32_t (*ler)(const Maquina *m, uint32_t csr, uint64_t instrucoes);
+	void (*escrever)(Maquina *m, uint32_t csr, uint32_t valor, uint64_t instrucoes); // recebe o valor já mascarado
+} DescritorCsr;
+
+#define CSR_CONTADOR {NULL, -1, 0xFFFFFFFF, 0, lerContador, escreverContador}
+
+// tabela de todos os 4096 endereços de CSR; entradas zeradas são CSRs não suportados
+// os endereços 0xC00..0xFFF (bits 11:10 = 11) são só de leitura: escrever neles é instrução ilegal
+static const DescritorCsr tabelaCsrs[4096] = {
+	[0x300] = {"mstatus", 0, (1 << 3) | (1 << 7)}, // só MIE e MPIE são escritos pelo programa
+	[0x301] = {"misa", -1, 0, 0x40001101},		   // RV32 I, M, A (escritas ignoradas)
+	[0x304] = {"mie", 1, 0xFFFFFFFF},
+	[0x305] = {"mtvec", 2, 0xFFFFFFFF},
+	[0x310] = {"mstatush", -1, 0, 0},
+	[0x323 ... 0x33F] = CSR_CONTADOR, // mhpmevent3..31
+	[0x340] = {"mscratch", 8, 0xFFFFFFFF},
+	[0x341] = {"mepc", 3, 0xFFFFFFFF},
+	[0x342] = {"mcause", 4, 0xFFFFFFFF},
+	[0x343] = {"mtval", 5, 0xFFFFFFFF},
+	[0x344] = {"mip", 6, 0xFFFFFFFF},
+	[0xB00] = CSR_CONTADOR, // mcycle
+	[0xB02 ... 0xB1F] = CSR_CONTADOR, // minstret, mhpmcounter3..31
+	[0xB80] = CSR_CONTADOR,
+	[0xB82 ... 0xB9F] = CSR_CONTADOR,
+	[0xC00 ... 0xC1F] = CSR_CONTADOR, // cycle, time, instret, hpmcounter3..31
+	[0xC80 ... 0xC9F] = CSR_CONTADOR,
+	[0xF11] = {"mvendorid", -1, 0, 0},
+	[0xF12] = {"marchid", -1, 0, 0},
+	[0xF13] = {"mimpid", -1, 0, 0},
+	[0xF14] = {"mhartid", 7, 0},
+	[0xF15] = {"mconfigptr", -1, 0, 0},
+};
+
+// posição do CSR em registradoresCSRs, ou -1 se ele não tem armazenamento (ou não é suportado)
+int csrIndex(uint16_t endereco)
+{
+	const DescritorCsr *csr = &tabelaCsrs[endereco & 0xFFF];
+	return (csr->nome != NULL) ? csr->indice : -1;
+}
+
+static const char *nomeCsr(uint32_t csr, char *nome, size_t tamanho)
+{
+	return (tabelaCsrs[csr].nome != NULL) ? tabelaCsrs[csr].nome : nomeCsrContador(csr, nome, tamanho);
+}
+
+// trace das instruções de CSR, no formato de cada uma (funct3); fonte = rs1 ou o imediato, novo = valor final do CSR
+static void imprimirCsr(FILE *output, uint32_t funct3, uint32_t pc, uint32_t rd, uint32_t rs1, const char *nome,
+						uint32_t antigo, uint32_t fonte, uint32_t novo)
+{
+	switch (funct3)
+	{
+	case 0b001:
+		TRACE(output, "0x%08x:csrrw  %s,%s,%s     %s=%s=0x%08x,%s=%s=0x%08x\n", pc, regNomes[rd], nome, regNomes[rs1],
+				regNomes[rd], nome, antigo, nome, regNomes[rs1], fonte);
+		break;
+	case 0b010:
+		TRACE(output, "0x%08x:csrrs  %s,%s,%s     %s=%s=0x%08x,%s|=%s=0x%08x|0x%08x=0x%08x\n", pc, regNomes[rd], nome,
+				regNomes[rs1], regNomes[rd], nome, antigo, nome, regNomes[rs1], antigo, fonte, antigo | fonte);
+		break;
+	case 0b011:
+		TRACE(output, "0x%08x:csrrc  %s,%s,%s     %s=%s=0x%08x,%s&=~%s=0x%08x&~0x%08x=0x%08x\n", pc, regNomes[rd], nome,
+				regNomes[rs1], regNomes[rd], nome, antigo, nome, regNomes[rs1], antigo, fonte, antigo & ~fonte);
+		break;
+	case 0b101:
+		TRACE(output, "0x%08x:csrrwi %s,%s,%u     %s=%s=0x%08x,%s=u5=0x%07x\n", pc, regNomes[rd], nome, fonte,
+				regNomes[rd], nome, antigo, nome, fonte);
+		break;
+	case 0b110:
+		TRACE(output, "0x%08x:csrrsi %s,%s,%u      %s=%s=0x%08x,%s|=u5=0x%08x|0x%08x=0x%08x\n", pc, regNomes[rd], nome,
+				fonte, regNomes[rd], nome, antigo, nome, antigo, fonte, novo);
+		break;
+	case 0b111:
+		TRACE(output, "0x%08x:csrrci %s,%s,%u      %s=%s=0x%08x,%s&~=u5=0x%08x&~0x%08x=0x%08x\n", pc, regNomes[rd], nome,
+				fonte, regNomes[rd], nome, antigo, nome, antigo, fonte, novo);
+		break;
+	}
+}
+
+// nome de uma exceção no trace (mapeamento de códigos de causa para nomes)
+static const char *nomeExcecao(uint32_t causa)
+{
+	return (causa == 0x0) ? "instruction_misaligned" : (causa == 0x1) ? "instruction_fault"
+												   : (causa == 0x2)   ? "illegal_instruction"
+												   : (causa == 0x3)   ? "breakpoint"
+												   : (causa == 0x4)   ? "load_misaligned"
+												   : (causa == 0x5)   ? "load_fault"
+												   : (causa == 0x6)   ? "store_misaligned"
+												   : (causa == 0x7)   ? "store_fault"
+												   : (causa == 0xB)   ? "environment_call"
+																	  : "unknown";
+}
+
+// função para tratar as excessões; devolve EVENTO_EXCECAO se a causa está em m->excecoesParada
+int registrarExcecao(Maquina *m, uint64_t instrucoes, uint32_t causa, uint32_t endereco_instrucao, uint32_t tval, uint32_t *pc_ptr)
+{
+	uint32_t *registradoresCSRs = m->registradoresCSRs;
+	FILE *output = m->saida;
+	int indice_mcause = csrIndex(834); // endereço de mcause
+	int indice_mepc = csrIndex(833);   // endereço de mepc
+	int indice_mtvec = csrIndex(773);  // endereço de mtvec
+
+	if (indice_mcause != -1)
+	{
+		registradoresCSRs[indice_mcause] = causa; // escrevendo a causa da excessão
+	}
+
+	if (indice_mepc != -1)
+	{
+		registradoresCSRs[indice_mepc] = endereco_instrucao; // escrevendo o endereço da instrução que causou
+	}
+
+	*pc_ptr = registradoresCSRs[indice_mtvec];
+
+	// Ignora exceção de breakpoint (cause == 3), pois já foi tratada por 'ebreak'
+	if (causa == 0x3)
+	{
+		return EVENTO_NENHUM; // Evita print duplicado para ebreak
+	}
+
+	if (m->estatisticas != NULL)
+		m->estatisticas->excecoes[causa & 0xF]++;
+	if (m->pilhaChamadas != NULL)
+		empilharChamada(m->pilhaChamadas, instrucoes, causa, 0, 1); // o tratador aparece como um quadro próprio
+	if (m->latencias != NULL)
+		entrarTrap(m->latencias, m, causa, instrucoes);
+
+	TRACE(output, ">exception:%-20s cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
+			nomeExcecao(causa), causa, endereco_instrucao, tval);
+	return ((m->excecoesParada >> (causa & 0x1F)) & 1) ? EVENTO_EXCECAO : EVENTO_NENHUM;
+}
+
+// tabela de conversão de caractere hexadecimal para valor (0xFF = não é dígito hex)
+static const uint8_t tabelaHex[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+#if defined(__SSSE3__)
+// decodifica 16 bytes no formato "HH HH ... HH" (48 caracteres) de uma vez
+// retorna 0 se o bloco não estiver exatamente nesse formato (o chamador volta para o caminho escalar)
+static int decodificarBloco16(const char *p, uint8_t *destino)
+{
+	const __m128i a = _mm_loadu_si128((const __m128i *)p);
+	const __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+	const __m128i c = _mm_loadu_si128((const __m128i *)(p + 32));
+
+	// posições 3k (nibble alto), 3k+1 (nibble baixo) e 3k+2 (separador) distribuídas nos 3 vetores
+	const __m128i altoA = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i altoB = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+	const __m128i altoC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+	const __m128i baixoA = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i baixoB = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+	const __m128i baixoC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+	const __m128i sepA = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i sepB = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+	const __m128i sepC = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+	const __m128i alto = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, altoA), _mm_shuffle_epi8(b, altoB)), _mm_shuffle_epi8(c, altoC));
+	const __m128i baixo = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, baixoA), _mm_shuffle_epi8(b, baixoB)), _mm_shuffle_epi8(c, baixoC));
+	const __m128i sep = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, sepA), _mm_shuffle_epi8(b, sepB)), _mm_shuffle_epi8(c, sepC));
+
+	// separadores aceitos: espaço, tab, \r e \n
+	const __m128i sepValido = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(sep, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(sep, _mm_set1_epi8('\n'))),
+		_mm_or_si128(_mm_cmpeq_epi8(sep, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(sep, _mm_set1_epi8('\t'))));
+	if (_mm_movemask_epi8(sepValido) != 0xFFFF)
+	{
+		return 0;
+	}
+
+	__m128i nibbles[2] = {alto, baixo};
+	for (int i = 0; i < 2; i++)
+	{
+		const __m128i ch = nibbles[i];
+		const __m128i digito = _mm_and_si128(_mm_cmpgt_epi8(ch, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(ch, _mm_set1_epi8('9' + 1)));
+		const __m128i maiuscula = _mm_and_si128(_mm_cmpgt_epi8(ch, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(ch, _mm_set1_epi8('F' + 1)));
+		const __m128i minuscula = _mm_and_si128(_mm_cmpgt_epi8(ch, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(ch, _mm_set1_epi8('f' + 1)));
+		if (_mm_movemask_epi8(_mm_or_si128(digito, _mm_or_si128(maiuscula, minuscula))) != 0xFFFF)
+		{
+			return 0;
+		}
+		const __m128i ajuste = _mm_or_si128(_mm_and_si128(digito, _mm_set1_epi8('0')),
+											_mm_or_si128(_mm_and_si128(maiuscula, _mm_set1_epi8('A' - 10)),
+														 _mm_and_si128(minuscula, _mm_set1_epi8('a' - 10))));
+		nibbles[i] = _mm_sub_epi8(ch, ajuste);
+	}
+
+	// nibble alto <= 0xF, então o deslocamento de 16 bits não vaza para o byte vizinho
+	const __m128i bytes = _mm_or_si128(_mm_slli_epi16(nibbles[0], 4), nibbles[1]);
+	_mm_storeu_si128((__m128i *)destino, bytes);
+	return 1;
+}
+#endif
+
+// carrega a imagem hexadecimal (registros "@XXXXXXXX" seguidos de bytes "HH HH ...") direto na memória simulada
+// o arquivo é mapeado com mmap e percorrido uma única vez, sem sscanf e sem limite de tamanho de linha
+// retorna 0 em caso de sucesso e -1 se o arquivo não puder ser aberto
+int carregarHex(const char *caminho, uint8_t *mem, uint32_t offset, uint32_t tamanho)
+{
+	int fd = open(caminho, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Não foi possível abrir a imagem %s.\n", caminho);
+		return -1;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		fprintf(stderr, "Não foi possível ler o tamanho de %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	// arquivo vazio: nada para carregar
+	if (info.st_size == 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	const char *inicio = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // o mapeamento continua válido após fechar o descritor
+	if (inicio == MAP_FAILED)
+	{
+		fprintf(stderr, "Não foi possível mapear a imagem %s.\n", caminho);
+		return -1;
+	}
+	madvise((void *)inicio, info.st_size, MADV_SEQUENTIAL);
+
+	const char *p = inicio;
+	const char *fim = inicio + info.st_size;
+	uint32_t contadorMem = offset; // endereço atual de escrita
+	uint64_t ignorados = 0;		   // bytes fora da memória simulada
+
+	while (p < fim)
+	{
+		// registro de endereço: '@' no começo da linha seguido de até 8 dígitos hex
+		if (*p == '@')
+		{
+			p++;
+			uint32_t endereco = 0;
+			for (int i = 0; i < 8 && p < fim && tabelaHex[(uint8_t)*p] != 0xFF; i++, p++)
+			{
+				endereco = (endereco << 4) | tabelaHex[(uint8_t)*p];
+			}
+			contadorMem = endereco;
+
+			// o resto da linha é ignorado
+			while (p < fim && *p != '\n')
+				p++;
+			if (p < fim)
+				p++;
+			continue;
+		}
+
+		// linha de dados: pares hex separados por espaços
+		while (p < fim && *p != '\n')
+		{
+			if (*p == ' ' || *p == '\t' || *p == '\r')
+			{
+				p++; // pula espaços extras
+				continue;
+			}
+
+#if defined(__SSSE3__)
+			// caminho rápido: 16 bytes de uma vez quando o bloco inteiro cabe na memória simulada
+			// o último separador fica para o laço escalar, que decide se a linha terminou
+			if (fim - p >= 48 && contadorMem >= offset && (uint64_t)contadorMem + 16 <= (uint64_t)offset + tamanho &&
+				decodificarBloco16(p, &mem[contadorMem - offset]))
+			{
+				contadorMem += 16;
+				p += 47;
+				continue;
+			}
+#endif
+
+			const uint8_t alto = tabelaHex[(uint8_t)*p];
+			if (alto == 0xFF)
+			{
+				// caractere inválido: descarta o restante da linha (mesmo comportamento do sscanf)
+				while (p < fim && *p != '\n')
+					p++;
+				break;
+			}
+			p++;
+
+			uint8_t byte = alto;
+			if (p < fim && tabelaHex[(uint8_t)*p] != 0xFF)
+			{
+				byte = (alto << 4) | tabelaHex[(uint8_t)*p];
+				p++;
+			}
+
+			if (contadorMem >= offset && contadorMem - offset < tamanho)
+			{
+				mem[contadorMem - offset] = byte;
+			}
+			else
+			{
+				ignorados++;
+			}
+			contadorMem++;
+		}
+		if (p < fim)
+			p++; // consome o '\n'
+	}
+
+	munmap((void *)inicio, info.st_size);
+
+	if (ignorados != 0)
+	{
+		fprintf(stderr, "Aviso: %llu bytes da imagem estão fora da memória simulada e foram ignorados.\n",
+				(unsigned long long)ignorados);
+	}
+	return 0;
+}
+
+static int compararSimbolos(const void *a, const void *b)
+{
+	const Simbolo *sa = a;
+	const Simbolo *sb = b;
+	return (sa->endereco > sb->endereco) - (sa->endereco < sb->endereco);
+}
+
+// procura o símbolo que contém o endereço (busca binária); retorna NULL se não houver
+const Simbolo *poximBuscarSimbolo(const Maquina *m, uint32_t endereco)
+{
+	const Simbolo *simbolos = m->simbolos;
+	int esq = 0, dir = m->numSimbolos - 1, achado = -1;
+	while (esq <= dir)
+	{
+		const int meio = (esq + dir) / 2;
+		if (simbolos[meio].endereco <= endereco)
+		{
+			achado = meio;
+			esq = meio + 1;
+		}
+		else
+		{
+			dir = meio - 1;
+		}
+	}
+	if (achado < 0)
+		return NULL;
+
+	const Simbolo *sim = &simbolos[achado];
+	// símbolos sem tamanho cobrem até o próximo símbolo
+	if (sim->tamanho != 0 && endereco - sim->endereco >= sim->tamanho)
+		return NULL;
+	return sim;
+}
+
+// lê símbolos de um arquivo de mapa texto, uma linha por símbolo: "endereco [tipo] nome" (saída do nm também serve)
+// os símbolos se juntam aos já carregados (do ELF); linhas que não começam com um endereço hex são ignoradas
+int poximCarregarMapa(Maquina *m, const char *caminho)
+{
+	FILE *arquivo = fopen(caminho, "r");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir o mapa de símbolos %s.\n", caminho);
+		return -1;
+	}
+
+	char linha[512];
+	int capacidade = m->numSimbolos; // o vetor cresce em dobro, não a cada linha
+	while (fgets(linha, sizeof(linha), arquivo) != NULL)
+	{
+		char *fimEndereco;
+		const unsigned long endereco = strtoul(linha, &fimEndereco, 16);
+		if (fimEndereco == linha || (*fimEndereco != ' ' && *fimEndereco != '\t'))
+			continue;
+
+		// o nome é o último campo da linha
+		char *nome = NULL;
+		char *resto = NULL;
+		for (char *campo = strtok_r(fimEndereco, " \t\r\n", &resto); campo != NULL; campo = strtok_r(NULL, " \t\r\n", &resto))
+			nome = campo;
+		if (nome == NULL || endereco < OFFSET_MEMORIA || endereco - OFFSET_MEMORIA >= TAM_MEMORIA)
+			continue;
+
+		if (m->numSimbolos == capacidade)
+		{
+			const int novaCapacidade = capacidade ? 2 * capacidade : 256;
+			Simbolo *simbolos = realloc(m->simbolos, novaCapacidade * sizeof(Simbolo));
+			if (simbolos == NULL)
+				break;
+			m->simbolos = simbolos;
+			capacidade = novaCapacidade;
+		}
+		Simbolo *novo = &m->simbolos[m->numSimbolos++];
+		novo->endereco = endereco;
+		novo->tamanho = 0; // vai até o próximo símbolo
+		snprintf(novo->nome, sizeof(novo->nome), "%s", nome);
+	}
+	fclose(arquivo);
+
+	qsort(m->simbolos, m->numSimbolos, sizeof(Simbolo), compararSimbolos);
+	return 0;
+}
+
+// coloca um trecho do arquivo na memória simulada
+// trechos somente leitura alinhados à página são mapeados MAP_PRIVATE direto do arquivo (sem cópia, copy-on-write);
+// o restante (e trechos graváveis) é lido com pread
+static int mapearTrecho(int fd, uint64_t deslocArquivo, uint32_t tamArquivo, uint8_t *destino, int somenteLeitura)
+{
+	const long pagina = sysconf(_SC_PAGESIZE);
+	uint32_t mapeados = 0;
+
+	if (somenteLeitura && ((uintptr_t)destino % pagina) == 0 && (deslocArquivo % pagina) == 0)
+	{
+		mapeados = tamArquivo - (tamArquivo % pagina);
+		if (mapeados != 0 &&
+			mmap(destino, mapeados, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, deslocArquivo) == MAP_FAILED)
+		{
+			mapeados = 0; // não conseguiu mapear: copia tudo
+		}
+	}
+
+	uint32_t lidos = mapeados;
+	while (lidos < tamArquivo)
+	{
+		const ssize_t n = pread(fd, destino + lidos, tamArquivo - lidos, deslocArquivo + lidos);
+		if (n <= 0)
+			return -1;
+		lidos += n;
+	}
+	return 0;
+}
+
+// arquivos com cabeçalho + memória (cache e snapshot): o cabeçalho ocupa uma página inteira
+// para que a memória comece alinhada e possa ser mapeada direto do arquivo
+#define PAGINA_CABECALHO 4096
+
+// grava cabeçalho + memória em um arquivo temporário (único por processo e thread) e renomeia,
+// assim execuções paralelas nunca leem um arquivo pela metade
+int gravarComCabecalho(const char *caminho, const void *cabecalho, size_t tamCabecalho, const uint8_t *mem, uint32_t tamanho)
+{
+	char caminhoTemp[4200];
+	snprintf(caminhoTemp, sizeof(caminhoTemp), "%s.%d.%lx.tmp", caminho, (int)getpid(), (unsigned long)pthread_self());
+	int fd = open(caminhoTemp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	uint8_t pagina[PAGINA_CABECALHO] = {0};
+	memcpy(pagina, cabecalho, tamCabecalho < sizeof(pagina) ? tamCabecalho : sizeof(pagina));
+
+	int ok = write(fd, pagina, sizeof(pagina)) == (ssize_t)sizeof(pagina);
+	uint32_t escritos = 0;
+	while (ok && escritos < tamanho)
+	{
+		const ssize_t n = write(fd, mem + escritos, tamanho - escritos);
+		ok = n > 0;
+		escritos += ok ? n : 0;
+	}
+	close(fd);
+
+	if (!ok || rename(caminhoTemp, caminho) != 0)
+	{
+		unlink(caminhoTemp);
+		return -1;
+	}
+	return 0;
+}
+
+// carrega um executável ELF RV32 (little-endian): segmentos PT_LOAD, ponto de entrada e tabela de símbolos
+int carregarElf(const char *caminho, uint8_t *mem, uint32_t offset, uint32_t tamanho, uint32_t *entrada,
+				Simbolo **simbolos, int *numSimbolos)
+{
+	int fd = open(caminho, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Não foi possível abrir a imagem %s.\n", caminho);
+		return -1;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(Elf32_Ehdr))
+	{
+		fprintf(stderr, "ELF inválido: %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	// o arquivo inteiro fica mapeado só para leitura dos cabeçalhos e da tabela de símbolos
+	const uint8_t *arquivo = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (arquivo == MAP_FAILED)
+	{
+		fprintf(stderr, "Não foi possível mapear a imagem %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	const Elf32_Ehdr *cab = (const Elf32_Ehdr *)arquivo;
+	if (cab->e_ident[EI_CLASS] != ELFCLASS32 || cab->e_ident[EI_DATA] != ELFDATA2LSB || cab->e_machine != EM_RISCV ||
+		(uint64_t)cab->e_phoff + (uint64_t)cab->e_phnum * sizeof(Elf32_Phdr) > (uint64_t)info.st_size)
+	{
+		fprintf(stderr, "%s não é um executável RV32 little-endian.\n", caminho);
+		munmap((void *)arquivo, info.st_size);
+		close(fd);
+		return -1;
+	}
+
+	// segmentos carregáveis
+	const Elf32_Phdr *prog = (const Elf32_Phdr *)(arquivo + cab->e_phoff);
+	for (int i = 0; i < cab->e_phnum; i++)
+	{
+		if (prog[i].p_type != PT_LOAD || prog[i].p_memsz == 0)
+			continue;
+
+		const uint32_t endereco = prog[i].p_paddr != 0 ? prog[i].p_paddr : prog[i].p_vaddr;
+		if (endereco < offset || (uint64_t)endereco + prog[i].p_memsz > (uint64_t)offset + tamanho ||
+			prog[i].p_filesz > prog[i].p_memsz || (uint64_t)prog[i].p_offset + prog[i].p_filesz > (uint64_t)info.st_size)
+		{
+			fprintf(stderr, "Aviso: segmento %d (0x%08x, %u bytes) fora da memória simulada foi ignorado.\n",
+					i, endereco, prog[i].p_memsz);
+			continue;
+		}
+
+		// a parte do arquivo é mapeada/lida; o restante (.bss) já está zerado
+		if (mapearTrecho(fd, prog[i].p_offset, prog[i].p_filesz, &mem[endereco - offset], !(prog[i].p_flags & PF_W)) != 0)
+		{
+			fprintf(stderr, "Erro ao ler o segmento %d de %s.\n", i, caminho);
+			munmap((void *)arquivo, info.st_size);
+			close(fd);
+			return -1;
+		}
+	}
+
+	*entrada = cab->e_entry;
+
+	// tabela de símbolos (opcional; executáveis "stripped" não têm)
+	if (cab->e_shoff != 0 && (uint64_t)cab->e_shoff + (uint64_t)cab->e_shnum * sizeof(Elf32_Shdr) <= (uint64_t)info.st_size)
+	{
+		const Elf32_Shdr *secoes = (const Elf32_Shdr *)(arquivo + cab->e_shoff);
+		for (int i = 0; i < cab->e_shnum; i++)
+		{
+			if (secoes[i].sh_type != SHT_SYMTAB || secoes[i].sh_link >= cab->e_shnum)
+				continue;
+
+			const Elf32_Shdr *strtab = &secoes[secoes[i].sh_link];
+			if ((uint64_t)secoes[i].sh_offset + secoes[i].sh_size > (uint64_t)info.st_size ||
+				(uint64_t)strtab->sh_offset + strtab->sh_size > (uint64_t)info.st_size)
+				continue;
+
+			const Elf32_Sym *sym = (const Elf32_Sym *)(arquivo + secoes[i].sh_offset);
+			const int total = secoes[i].sh_size / sizeof(Elf32_Sym);
+			const char *nomes = (const char *)(arquivo + strtab->sh_offset);
+
+			if (total == 0)
+				continue;
+			Simbolo *novos = realloc(*simbolos, (*numSimbolos + total) * sizeof(Simbolo));
+			if (novos == NULL)
+			{
+				// os símbolos já lidos continuam em *simbolos para quem chamou liberar
+				fprintf(stderr, "Memória insuficiente para os símbolos de %s.\n", caminho);
+				munmap((void *)arquivo, info.st_size);
+				close(fd);
+				return -1;
+			}
+			*simbolos = novos;
+			for (int j = 0; j < total; j++)
+			{
+				const int tipo = ELF32_ST_TYPE(sym[j].st_info);
+				if ((tipo != STT_FUNC && tipo != STT_OBJECT && tipo != STT_NOTYPE) || sym[j].st_shndx == SHN_UNDEF ||
+					sym[j].st_name == 0 || sym[j].st_name >= strtab->sh_size || sym[j].st_value < offset ||
+					sym[j].st_value >= offset + tamanho)
+					continue;
+
+				Simbolo *novo = &(*simbolos)[(*numSimbolos)++];
+				novo->endereco = sym[j].st_value;
+				novo->tamanho = sym[j].st_size;
+				snprintf(novo->nome, sizeof(novo->nome), "%.*s", (int)(strtab->sh_size - sym[j].st_name), nomes + sym[j].st_name);
+			}
+		}
+		qsort(*simbolos, *numSimbolos, sizeof(Simbolo), compararSimbolos);
+	}
+
+	munmap((void *)arquivo, info.st_size);
+	close(fd); // os segmentos mapeados continuam válidos
+	return 0;
+}
+
+// carrega uma imagem binária crua a partir do início da memória simulada (entrada = offset)
+// a imagem é mapeada MAP_PRIVATE do arquivo, então escritas do programa não alteram o arquivo
+int carregarBinario(const char *caminho, uint8_t *mem, uint32_t offset, uint32_t tamanho, uint32_t *entrada)
+{
+	int fd = open(caminho, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Não foi possível abrir a imagem %s.\n", caminho);
+		return -1;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		fprintf(stderr, "Não foi possível ler o tamanho de %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	uint32_t bytes = info.st_size;
+	if ((uint64_t)info.st_size > tamanho)
+	{
+		fprintf(stderr, "Aviso: %s tem %lld bytes; só os primeiros %u cabem na memória simulada.\n",
+				caminho, (long long)info.st_size, tamanho);
+		bytes = tamanho;
+	}
+
+	const int resultado = mapearTrecho(fd, 0, bytes, mem, 1);
+	close(fd);
+	if (resultado != 0)
+	{
+		fprintf(stderr, "Erro ao ler %s.\n", caminho);
+		return -1;
+	}
+
+	*entrada = offset;
+	return 0;
+}
+
+// cabeçalho do cache de imagens (ocupa a primeira página do arquivo; a memória vem logo depois)
+#define CACHE_MAGICO 0x31435850u // "PXC1"
+
+typedef struct
+{
+	uint32_t magico;
+	uint32_t offset;		 // endereço base da memória simulada
+	uint32_t tamanho;		 // bytes de memória gravados depois do cabeçalho
+	uint32_t reservado;
+	uint64_t hash;			 // hash do conteúdo do arquivo hex original
+	uint64_t tamanhoArquivo; // tamanho do arquivo hex original (confere colisões)
+} CabecalhoCache;
+
+// hash de 64 bits do conteúdo (8 bytes por vez, mistura multiplicativa)
+uint64_t hashConteudo(const uint8_t *dados, size_t tamanho)
+{
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ tamanho;
+	size_t i = 0;
+	for (; i + 8 <= tamanho; i += 8)
+	{
+		uint64_t palavra;
+		memcpy(&palavra, dados + i, 8);
+		h = (h ^ palavra) * 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+	}
+	for (; i < tamanho; i++)
+	{
+		h = (h ^ dados[i]) * 0x100000001B3ull;
+	}
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// carrega a imagem hex usando o cache em dirCache
+// se já existe uma imagem pronta para o mesmo conteúdo, ela é mapeada direto (copy-on-write) sem reprocessar o texto;
+// senão o arquivo é decodificado normalmente e o resultado é gravado no cache para as próximas execuções
+int carregarHexComCache(const char *caminho, const char *dirCache, uint8_t *mem, uint32_t offset, uint32_t tamanho)
+{
+	int fd = open(caminho, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Não foi possível abrir a imagem %s.\n", caminho);
+		return -1;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return carregarHex(caminho, mem, offset, tamanho);
+	}
+
+	const uint8_t *conteudo = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (conteudo == MAP_FAILED)
+	{
+		return carregarHex(caminho, mem, offset, tamanho);
+	}
+	const uint64_t hash = hashConteudo(conteudo, info.st_size);
+	munmap((void *)conteudo, info.st_size);
+
+	char caminhoCache[4096];
+	snprintf(caminhoCache, sizeof(caminhoCache), "%s/%016llx.img", dirCache, (unsigned long long)hash);
+
+	// acerto no cache: confere o cabeçalho e mapeia a memória pronta
+	int fdCache = open(caminhoCache, O_RDONLY);
+	if (fdCache >= 0)
+	{
+		CabecalhoCache cab;
+		struct stat infoCache;
+		if (pread(fdCache, &cab, sizeof(cab), 0) == (ssize_t)sizeof(cab) && fstat(fdCache, &infoCache) == 0 &&
+			cab.magico == CACHE_MAGICO && cab.offset == offset && cab.tamanho == tamanho && cab.hash == hash &&
+			cab.tamanhoArquivo == (uint64_t)info.st_size && infoCache.st_size >= (off_t)(PAGINA_CABECALHO + tamanho) &&
+			mapearTrecho(fdCache, PAGINA_CABECALHO, tamanho, mem, 1) == 0)
+		{
+			close(fdCache);
+			return 0;
+		}
+		close(fdCache);
+	}
+
+	// falta no cache: decodifica o texto e grava a imagem
+	if (carregarHex(caminho, mem, offset, tamanho) != 0)
+	{
+		return -1;
+	}
+
+	mkdir(dirCache, 0755); // pode já existir
+
+	CabecalhoCache cab = {CACHE_MAGICO, offset, tamanho, 0, hash, (uint64_t)info.st_size};
+	if (gravarComCabecalho(caminhoCache, &cab, sizeof(cab), mem, tamanho) != 0)
+	{
+		fprintf(stderr, "Aviso: não foi possível gravar o cache em %s.\n", dirCache);
+	}
+	return 0; // a imagem já está carregada; o cache é só otimização
+}
+
+// escolhe o carregador pelo conteúdo/extensão: ELF (assinatura 0x7F 'E' 'L' 'F'), binário cru (".bin") ou texto hex
+// para ELF o pc começa no ponto de entrada; nos outros formatos, no início da memória
+int poximCarregarImagem(Maquina *m, const char *caminho)
+{
+	uint8_t *mem = m->mem;
+	const uint32_t offset = OFFSET_MEMORIA;
+	const uint32_t tamanho = TAM_MEMORIA;
+	uint32_t *entrada = &m->pc;
+
+	unsigned char assinatura[SELFMAG] = {0};
+	FILE *arquivo = fopen(caminho, "rb");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir a imagem %s.\n", caminho);
+		return -1;
+	}
+	const size_t lidos = fread(assinatura, 1, SELFMAG, arquivo);
+	fclose(arquivo);
+
+	if (lidos == SELFMAG && memcmp(assinatura, ELFMAG, SELFMAG) == 0)
+	{
+		return carregarElf(caminho, mem, offset, tamanho, entrada, &m->simbolos, &m->numSimbolos);
+	}
+
+	const size_t tamCaminho = strlen(caminho);
+	if (tamCaminho >= 4 && strcmp(caminho + tamCaminho - 4, ".bin") == 0)
+	{
+		return carregarBinario(caminho, mem, offset, tamanho, entrada);
+	}
+
+	*entrada = offset;
+
+	// imagens hex podem usar o cache de imagens prontas (variável de ambiente POXIM_CACHE = diretório do cache)
+	const char *dirCache = getenv("POXIM_CACHE");
+	if (dirCache != NULL && dirCache[0] != '\0')
+	{
+		return carregarHexComCache(caminho, dirCache, mem, offset, tamanho);
+	}
+	return carregarHex(caminho, mem, offset, tamanho);
+}
+
+// estado completo da máquina gravado no snapshot (a memória vem depois, na próxima página do arquivo)
+#define SNAPSHOT_MAGICO 0x32535850u // "PXS2"
+
+typedef struct
+{
+	uint32_t magico;
+	uint32_t offset;  // endereço base da memória simulada
+	uint32_t tamanho; // bytes de memória gravados depois do cabeçalho
+	uint32_t pc;
+	uint32_t registradores[32];
+	uint32_t registradoresCSRs[16]; // arquivo de CSRs inteiro, inclusive mhartid e mscratch
+	uint32_t registradoresUART[6];
+	uint32_t clint_msip;
+	uint32_t plic_priority;
+	uint32_t plic_pending;
+	uint32_t plic_enable;
+	uint32_t plic_threshold;
+	uint32_t plic_claim;
+	uint64_t clint_mtime;
+	uint64_t clint_mtimecmp;
+	uint64_t instrucoes;	 // instruções executadas até o snapshot
+	int64_t posEntradaUART; // posição em qemu.terminal.in
+	int64_t posSaidaUART;	 // posição em qemu.terminal.out
+	uint32_t eventosHpm[32]; // mhpmevent3..31
+	uint64_t contadores[32]; // valores de mcycle, minstret e mhpmcounter3..31 (as bases dependem de quem restaura)
+} Snapshot;
+
+// grava o estado e a memória simulada em um arquivo binário
+int salvarSnapshot(const char *caminho, Snapshot *estado, const uint8_t *mem)
+{
+	estado->magico = SNAPSHOT_MAGICO;
+	if (gravarComCabecalho(caminho, estado, sizeof(*estado), mem, estado->tamanho) != 0)
+	{
+		fprintf(stderr, "Não foi possível gravar o snapshot %s.\n", caminho);
+		return -1;
+	}
+	return 0;
+}
+
+// snapshots incrementais guardam só as páginas da memória escritas desde o snapshot anterior da cadeia
+#define SNAPSHOT_INCREMENTAL 0x32495850u // "PXI2"
+
+typedef struct
+{
+	Snapshot estado;	// estado completo da máquina (magico = SNAPSHOT_INCREMENTAL)
+	char anterior[256]; // snapshot anterior da cadeia (relativo ao diretório deste arquivo)
+	uint32_t numPaginas; // páginas gravadas em seguida: índice (uint32_t) + TAM_PAGINA_SUJA bytes
+} CabecalhoIncremental;
+
+// marca como suja a página que contém o deslocamento (chamada nos caminhos de sb/sh/sw)
+static inline void marcarPaginaSuja(uint64_t *paginasSujas, uint32_t deslocamento)
+{
+	const uint32_t pagina = deslocamento / TAM_PAGINA_SUJA;
+	paginasSujas[pagina / 64] |= 1ull << (pagina % 64);
+}
+
+// grava um snapshot incremental: estado completo + só as páginas marcadas em paginasSujas
+int salvarSnapshotIncremental(const char *caminho, const char *anterior, Snapshot *estado, const uint8_t *mem,
+							  const uint64_t *paginasSujas)
+{
+	CabecalhoIncremental cab;
+	memset(&cab, 0, sizeof(cab));
+	cab.estado = *estado;
+	cab.estado.magico = SNAPSHOT_INCREMENTAL;
+
+	// só o nome do arquivo: a cadeia inteira fica no mesmo diretório
+	const char *barra = strrchr(anterior, '/');
+	snprintf(cab.anterior, sizeof(cab.anterior), "%s", barra != NULL ? barra + 1 : anterior);
+
+	const uint32_t totalPaginas = estado->tamanho / TAM_PAGINA_SUJA;
+	for (uint32_t i = 0; i < totalPaginas; i++)
+	{
+		if (paginasSujas[i / 64] & (1ull << (i % 64)))
+			cab.numPaginas++;
+	}
+
+	char caminhoTemp[4200];
+	snprintf(caminhoTemp, sizeof(caminhoTemp), "%s.%d.%lx.tmp", caminho, (int)getpid(), (unsigned long)pthread_self());
+	FILE *arquivo = fopen(caminhoTemp, "wb");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar o snapshot %s.\n", caminho);
+		return -1;
+	}
+
+	int ok = fwrite(&cab, sizeof(cab), 1, arquivo) == 1;
+	for (uint32_t i = 0; ok && i < totalPaginas; i++)
+	{
+		if (paginasSujas[i / 64] & (1ull << (i % 64)))
+		{
+			ok = fwrite(&i, sizeof(i), 1, arquivo) == 1 &&
+				 fwrite(mem + i * TAM_PAGINA_SUJA, TAM_PAGINA_SUJA, 1, arquivo) == 1;
+		}
+	}
+	ok = (fclose(arquivo) == 0) && ok;
+
+	if (!ok || rename(caminhoTemp, caminho) != 0)
+	{
+		unlink(caminhoTemp);
+		fprintf(stderr, "Não foi possível gravar o snapshot %s.\n", caminho);
+		return -1;
+	}
+	return 0;
+}
+
+// lê o estado de um snapshot; a memória é mapeada direto do arquivo (copy-on-write)
+// snapshots incrementais restauram primeiro o anterior da cadeia e depois aplicam as páginas gravadas
+int restaurarSnapshot(const char *caminho, Snapshot *estado, uint8_t *mem, uint32_t offset, uint32_t tamanho)
+{
+	int fd = open(caminho, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Não foi possível abrir o snapshot %s.\n", caminho);
+		return -1;
+	}
+
+	struct stat info;
+	if (pread(fd, estado, sizeof(*estado), 0) != (ssize_t)sizeof(*estado) || fstat(fd, &info) != 0 ||
+		(estado->magico != SNAPSHOT_MAGICO && estado->magico != SNAPSHOT_INCREMENTAL) ||
+		estado->offset != offset || estado->tamanho != tamanho)
+	{
+		fprintf(stderr, "Snapshot inválido: %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	if (estado->magico == SNAPSHOT_INCREMENTAL)
+	{
+		CabecalhoIncremental cab;
+		if (pread(fd, &cab, sizeof(cab), 0) != (ssize_t)sizeof(cab))
+		{
+			fprintf(stderr, "Snapshot inválido: %s.\n", caminho);
+			close(fd);
+			return -1;
+		}
+		cab.anterior[sizeof(cab.anterior) - 1] = '\0';
+
+		// o anterior fica no mesmo diretório deste arquivo
+		char caminhoAnterior[4400];
+		const char *barra = strrchr(caminho, '/');
+		snprintf(caminhoAnterior, sizeof(caminhoAnterior), "%.*s%s",
+				 barra != NULL ? (int)(barra - caminho + 1) : 0, caminho, cab.anterior);
+
+		Snapshot estadoAnterior;
+		if (restaurarSnapshot(caminhoAnterior, &estadoAnterior, mem, offset, tamanho) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		off_t posicao = sizeof(cab);
+		for (uint32_t i = 0; i < cab.numPaginas; i++)
+		{
+			uint32_t pagina;
+			if (pread(fd, &pagina, sizeof(pagina), posicao) != (ssize_t)sizeof(pagina) ||
+				pagina >= tamanho / TAM_PAGINA_SUJA ||
+				pread(fd, mem + pagina * TAM_PAGINA_SUJA, TAM_PAGINA_SUJA, posicao + sizeof(pagina)) != TAM_PAGINA_SUJA)
+			{
+				fprintf(stderr, "Erro ao ler a memória do snapshot %s.\n", caminho);
+				close(fd);
+				return -1;
+			}
+			posicao += sizeof(pagina) + TAM_PAGINA_SUJA;
+		}
+		close(fd);
+		return 0;
+	}
+
+	if (info.st_size < (off_t)(PAGINA_CABECALHO + tamanho))
+	{
+		fprintf(stderr, "Snapshot inválido: %s.\n", caminho);
+		close(fd);
+		return -1;
+	}
+
+	const int resultado = mapearTrecho(fd, PAGINA_CABECALHO, tamanho, mem, 1);
+	close(fd);
+	if (resultado != 0)
+	{
+		fprintf(stderr, "Erro ao ler a memória do snapshot %s.\n", caminho);
+	}
+	return resultado;
+}
+
+// resultado de uma execução filha do servidor de fork (memória compartilhada com o pai)
+typedef struct
+{
+	uint32_t pc;		 // pc final
+	uint32_t a0;		 // valor de a0 no fim da execução
+	uint64_t instrucoes; // instruções executadas (incluindo as do processo pai antes do fork)
+} ResultadoFork;
+
+// servidor de fork: a partir do estado atual da máquina, cria um processo filho por arquivo listado em caminhoLista
+// cada filho herda a memória simulada copy-on-write e continua a execução com seu próprio arquivo de entrada UART
+// no filho retorna o arquivo de entrada a usar (e o espaço do resultado em *resultado);
+// no pai espera todos os filhos, grava "<lista>.resultados" e retorna NULL (*erro = 1 se algo deu errado)
+const char *servidorFork(const char *caminhoLista, int paralelo, ResultadoFork **resultado, int *erro)
+{
+	*erro = 0;
+	FILE *lista = fopen(caminhoLista, "r");
+	if (lista == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir a lista de entradas %s.\n", caminhoLista);
+		*erro = 1;
+		return NULL;
+	}
+
+	// uma entrada UART por linha (linhas vazias são ignoradas)
+	char **entradas = NULL;
+	int total = 0;
+	char linha[4096];
+	while (fgets(linha, sizeof(linha), lista) != NULL)
+	{
+		linha[strcspn(linha, "\r\n")] = '\0';
+		if (linha[0] == '\0')
+			continue;
+		entradas = realloc(entradas, (total + 1) * sizeof(char *));
+		entradas[total++] = strdup(linha);
+	}
+	fclose(lista);
+
+	ResultadoFork *resultados = mmap(NULL, (total + 1) * sizeof(ResultadoFork), PROT_READ | PROT_WRITE,
+									 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	pid_t *pids = calloc(total + 1, sizeof(pid_t));
+	int *codigos = calloc(total + 1, sizeof(int));
+	if (resultados == MAP_FAILED || pids == NULL || codigos == NULL)
+	{
+		fprintf(stderr, "Sem memória para o servidor de fork.\n");
+		*erro = 1;
+		for (int i = 0; i < total; i++)
+			free(entradas[i]);
+		free(entradas);
+		free(pids);
+		free(codigos);
+		if (resultados != MAP_FAILED)
+			munmap(resultados, (total + 1) * sizeof(ResultadoFork));
+		return NULL;
+	}
+
+	// tudo que já está nos buffers pertence ao pai; sem isso os filhos duplicariam a saída
+	fflush(NULL);
+
+	int proxima = 0, ativos = 0;
+	while (proxima < total || ativos > 0)
+	{
+		if (proxima < total && ativos < paralelo)
+		{
+			const pid_t pid = fork();
+			if (pid == 0)
+			{
+				*resultado = &resultados[proxima];
+				return entradas[proxima];
+			}
+			if (pid < 0)
+			{
+				fprintf(stderr, "fork falhou para %s.\n", entradas[proxima]);
+				codigos[proxima] = -1;
+				*erro = 1;
+			}
+			else
+			{
+				pids[proxima] = pid;
+				ativos++;
+			}
+			proxima++;
+			continue;
+		}
+
+		int status;
+		const pid_t pid = wait(&status);
+		if (pid < 0)
+			break;
+		ativos--;
+		for (int i = 0; i < proxima; i++)
+		{
+			if (pids[i] == pid)
+			{
+				// código de saída do simulador, ou 128 + sinal se o filho morreu
+				codigos[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+				break;
+			}
+		}
+	}
+
+	char caminhoResultados[4200];
+	snprintf(caminhoResultados, sizeof(caminhoResultados), "%s.resultados", caminhoLista);
+	FILE *saida = fopen(caminhoResultados, "w");
+	if (saida != NULL)
+	{
+		for (int i = 0; i < total; i++)
+		{
+			fprintf(saida, "%s codigo=%d pc=0x%08x a0=0x%08x instrucoes=%llu\n", entradas[i], codigos[i],
+					resultados[i].pc, resultados[i].a0, (unsigned long long)resultados[i].instrucoes);
+		}
+		fclose(saida);
+	}
+	else
+	{
+		fprintf(stderr, "Não foi possível gravar %s.\n", caminhoResultados);
+		*erro = 1;
+	}
+
+	// só o pai chega aqui: os filhos já receberam as suas entradas
+	for (int i = 0; i < total; i++)
+		free(entradas[i]);
+	free(entradas);
+	free(pids);
+	free(codigos);
+	munmap(resultados, (total + 1) * sizeof(ResultadoFork));
+	return NULL;
+}
+
+// uma linha do manifesto do modo lote e o resultado da sua execução
+typedef struct
+{
+	char *imagem;	// imagem de entrada (hex, ELF ou binário)
+	char *entrada;	// arquivo de entrada UART (NULL = sem entrada)
+	char *esperada; // saída UART esperada (NULL = não confere)
+	int codigo;		// 0 = ebreak, 1 = CSR não suportado, 2 = limite de instruções, 3 = erro ao carregar
+	int confere;	// 1 = saída UART igual à esperada, 0 = diferente, -1 = não conferida
+	uint32_t pc;
+	uint32_t a0;
+	uint64_t instrucoes;
+} TarefaLote;
+
+// fila de cada thread: um intervalo contínuo de tarefas
+// a dona consome do início; uma thread ociosa rouba a metade final do intervalo de outra
+typedef struct
+{
+	_Alignas(64) pthread_mutex_t trava;
+	int inicio;
+	int fim;
+} FilaLote;
+
+typedef struct
+{
+	TarefaLote *tarefas;
+	FilaLote *filas;
+	int numThreads;
+	uint64_t limite;
+	const char *dirTrace; // NULL = trace descartado
+} ContextoLote;
+
+typedef struct
+{
+	ContextoLote *contexto;
+	int id;
+} ArgumentoLote;
+
+// pega a próxima tarefa da própria fila; se estiver vazia, rouba metade da fila mais cheia
+// retorna -1 quando não sobrou tarefa em nenhuma fila
+static int proximaTarefaLote(ContextoLote *contexto, int id)
+{
+	FilaLote *propria = &contexto->filas[id];
+	while (1)
+	{
+		pthread_mutex_lock(&propria->trava);
+		if (propria->inicio < propria->fim)
+		{
+			const int tarefa = propria->inicio;
+			__atomic_store_n(&propria->inicio, tarefa + 1, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&propria->trava);
+			return tarefa;
+		}
+		pthread_mutex_unlock(&propria->trava);
+
+		// a leitura sem trava só escolhe a vítima (por isso inicio/fim são escritos com stores atômicos);
+		// o roubo em si confere de novo sob a trava dela
+		int vitima = -1, maior = 0;
+		for (int i = 0; i < contexto->numThreads; i++)
+		{
+			const int pendentes = __atomic_load_n(&contexto->filas[i].fim, __ATOMIC_RELAXED) -
+								  __atomic_load_n(&contexto->filas[i].inicio, __ATOMIC_RELAXED);
+			if (i != id && pendentes > maior)
+			{
+				maior = pendentes;
+				vitima = i;
+			}
+		}
+		if (vitima < 0)
+			return -1;
+
+		FilaLote *outra = &contexto->filas[vitima];
+		int roubadoInicio = 0, roubadoFim = 0;
+		pthread_mutex_lock(&outra->trava);
+		if (outra->inicio < outra->fim)
+		{
+			roubadoFim = outra->fim;
+			roubadoInicio = outra->fim - (outra->fim - outra->inicio + 1) / 2;
+			__atomic_store_n(&outra->fim, roubadoInicio, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&outra->trava);
+
+		if (roubadoInicio < roubadoFim)
+		{
+			pthread_mutex_lock(&propria->trava);
+			__atomic_store_n(&propria->inicio, roubadoInicio, __ATOMIC_RELAXED);
+			__atomic_store_n(&propria->fim, roubadoFim, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&propria->trava);
+		}
+	}
+}
+
+// compara o conteúdo de um arquivo com um buffer
+static int conferirArquivo(const char *caminho, const char *dados, size_t tamanho)
+{
+	FILE *arquivo = fopen(caminho, "rb");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir a saída esperada %s.\n", caminho);
+		return 0;
+	}
+	int igual = 1;
+	char bloco[4096];
+	size_t lidos, posicao = 0;
+	while (igual && (lidos = fread(bloco, 1, sizeof(bloco), arquivo)) > 0)
+	{
+		igual = posicao + lidos <= tamanho && memcmp(bloco, dados + posicao, lidos) == 0;
+		posicao += lidos;
+	}
+	fclose(arquivo);
+	return igual && posicao == tamanho;
+}
+
+// código de saída de uma execução terminada (o mesmo do main): 0 = ebreak, 1 = CSR não suportado, 2 = limite
+static int codigoEvento(int evento)
+{
+	return (evento == EVENTO_EBREAK) ? 0 : (evento == EVENTO_CSR_INVALIDO) ? 1 : 2;
+}
+
+// executa uma tarefa do lote na máquina da thread; a saída UART fica em memória para ser conferida
+static void executarTarefaLote(Maquina *m, TarefaLote *tarefa, int indice, const ContextoLote *contexto)
+{
+	char *saidaUART = NULL;
+	size_t tamSaidaUART = 0;
+	char caminhoTrace[4200];
+
+	poximReiniciar(m);
+	m->saida = NULL; // sem --lote-trace o trace nem é formatado
+	if (contexto->dirTrace != NULL)
+	{
+		snprintf(caminhoTrace, sizeof(caminhoTrace), "%s/%d.saida", contexto->dirTrace, indice);
+		m->saida = fopen(caminhoTrace, "w");
+	}
+	m->entradaUART = fopen(tarefa->entrada != NULL ? tarefa->entrada : "/dev/null", "r");
+	m->saidaUART = open_memstream(&saidaUART, &tamSaidaUART);
+	tarefa->confere = -1;
+
+	if ((contexto->dirTrace != NULL && m->saida == NULL) || m->entradaUART == NULL || m->saidaUART == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir os arquivos da tarefa %d (%s).\n", indice, tarefa->imagem);
+		tarefa->codigo = 3;
+	}
+	else if (poximCarregarImagem(m, tarefa->imagem) != 0)
+	{
+		tarefa->codigo = 3;
+	}
+	else
+	{
+		int evento;
+		do
+		{
+			evento = poximExecutar(m, contexto->limite - m->instrucoes);
+		} while (evento == EVENTO_WFI || evento == EVENTO_UART_VAZIA);
+		tarefa->codigo = codigoEvento(evento);
+	}
+
+	if (m->saida != NULL)
+		fclose(m->saida);
+	if (m->entradaUART != NULL)
+		fclose(m->entradaUART);
+	if (m->saidaUART != NULL)
+		fclose(m->saidaUART); // só depois do fclose saidaUART/tamSaidaUART têm o conteúdo final
+	m->saida = m->entradaUART = m->saidaUART = NULL;
+
+	if (tarefa->codigo != 3 && tarefa->esperada != NULL)
+		tarefa->confere = conferirArquivo(tarefa->esperada, saidaUART, tamSaidaUART);
+	free(saidaUART);
+
+	tarefa->pc = m->pc;
+	tarefa->a0 = m->registradores[10];
+	tarefa->instrucoes = m->instrucoes;
+}
+
+static void *trabalhadorLote(void *parametro)
+{
+	ArgumentoLote *argumento = parametro;
+	ContextoLote *contexto = argumento->contexto;
+
+	// cada thread tem a sua própria máquina, reutilizada entre as tarefas
+	Maquina *m = poximCriar();
+	if (m == NULL)
+	{
+		fprintf(stderr, "Não foi possível alocar a máquina da thread %d.\n", argumento->id);
+		return NULL;
+	}
+
+	int tarefa;
+	while ((tarefa = proximaTarefaLote(contexto, argumento->id)) >= 0)
+	{
+		executarTarefaLote(m, &contexto->tarefas[tarefa], tarefa, contexto);
+	}
+
+	poximDestruir(m);
+	return NULL;
+}
+
+// lê o manifesto do modo lote/frota; cada linha: "imagem [entradaUART [saidaEsperada]]"
+// ("-" = ausente; linhas com # são comentários). Retorna o número de tarefas, ou -1 em erro
+static int lerManifestoLote(const char *caminhoManifesto, TarefaLote **resultado)
+{
+	FILE *manifesto = fopen(caminhoManifesto, "r");
+	if (manifesto == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir o manifesto %s.\n", caminhoManifesto);
+		return -1;
+	}
+
+	TarefaLote *tarefas = NULL;
+	int total = 0, capacidade = 0;
+	char linha[3 * 4096];
+	while (fgets(linha, sizeof(linha), manifesto) != NULL)
+	{
+		char *campos[3] = {NULL, NULL, NULL};
+		char *resto = NULL;
+		int numCampos = 0;
+		for (char *campo = strtok_r(linha, " \t\r\n", &resto); campo != NULL && numCampos < 3;
+			 campo = strtok_r(NULL, " \t\r\n", &resto))
+		{
+			campos[numCampos++] = campo;
+		}
+		if (numCampos == 0 || campos[0][0] == '#')
+			continue;
+
+		if (total == capacidade)
+		{
+			capacidade = capacidade ? 2 * capacidade : 256;
+			tarefas = realloc(tarefas, capacidade * sizeof(TarefaLote));
+		}
+		TarefaLote *tarefa = &tarefas[total++];
+		memset(tarefa, 0, sizeof(*tarefa));
+		tarefa->imagem = strdup(campos[0]);
+		tarefa->entrada = (campos[1] != NULL && strcmp(campos[1], "-") != 0) ? strdup(campos[1]) : NULL;
+		tarefa->esperada = (campos[2] != NULL && strcmp(campos[2], "-") != 0) ? strdup(campos[2]) : NULL;
+	}
+	fclose(manifesto);
+
+	*resultado = tarefas;
+	return total;
+}
+
+// grava os resultados na ordem do manifesto e o resumo no fim; retorna o número de tarefas que falharam
+static int gravarResultadosLote(const char *caminhoResultados, const TarefaLote *tarefas, int total, int numThreads,
+								double segundos)
+{
+	FILE *saida = fopen(caminhoResultados, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar %s.\n", caminhoResultados);
+		saida = stderr;
+	}
+	int ok = 0, falhas = 0, semEsperada = 0;
+	uint64_t totalInstrucoes = 0;
+	for (int i = 0; i < total; i++)
+	{
+		const TarefaLote *tarefa = &tarefas[i];
+		const int passou = tarefa->codigo == 0 && tarefa->confere != 0;
+		ok += passou;
+		falhas += !passou;
+		semEsperada += tarefa->confere == -1;
+		totalInstrucoes += tarefa->instrucoes;
+		fprintf(saida, "%s %s codigo=%d pc=0x%08x a0=0x%08x instrucoes=%llu saida=%s\n", passou ? "OK" : "FALHA",
+				tarefa->imagem, tarefa->codigo, tarefa->pc, tarefa->a0, (unsigned long long)tarefa->instrucoes,
+				tarefa->confere == 1 ? "igual" : tarefa->confere == 0 ? "diferente" : "-");
+	}
+	fprintf(saida, "# tarefas=%d ok=%d falhas=%d sem_esperada=%d instrucoes=%llu threads=%d tempo=%.3fs mips=%.1f\n",
+			total, ok, falhas, semEsperada, (unsigned long long)totalInstrucoes, numThreads, segundos,
+			segundos > 0 ? totalInstrucoes / segundos / 1e6 : 0.0);
+	if (saida != stderr)
+		fclose(saida);
+	return falhas;
+}
+
+static void liberarTarefasLote(TarefaLote *tarefas, int total)
+{
+	for (int i = 0; i < total; i++)
+	{
+		free(tarefas[i].imagem);
+		free(tarefas[i].entrada);
+		free(tarefas[i].esperada);
+	}
+	free(tarefas);
+}
+
+static double segundosDesde(const struct timespec *inicio)
+{
+	struct timespec agora;
+	clock_gettime(CLOCK_MONOTONIC, &agora);
+	return (agora.tv_sec - inicio->tv_sec) + (agora.tv_nsec - inicio->tv_nsec) / 1e9;
+}
+
+// modo lote: executa as tarefas do manifesto em numThreads threads e grava os resultados em caminhoResultados
+// retorna 0 se todas as tarefas terminaram em ebreak com a saída esperada, 1 caso contrário
+int executarLote(const char *caminhoManifesto, const char *caminhoResultados, int numThreads, uint64_t limite,
+				 const char *dirTrace)
+{
+	TarefaLote *tarefas = NULL;
+	const int total = lerManifestoLote(caminhoManifesto, &tarefas);
+	if (total < 0)
+		return 1;
+
+	if (numThreads > total)
+		numThreads = total;
+	if (numThreads < 1)
+		numThreads = 1;
+
+	// divide as tarefas em intervalos iguais; o roubo de trabalho equilibra as tarefas mais longas
+	ContextoLote contexto = {tarefas, NULL, numThreads, limite, dirTrace};
+	contexto.filas = aligned_alloc(64, numThreads * sizeof(FilaLote));
+	pthread_t *threads = calloc(numThreads, sizeof(pthread_t));
+	int *criadas = calloc(numThreads, sizeof(int));
+	ArgumentoLote *argumentos = calloc(numThreads, sizeof(ArgumentoLote));
+	if (contexto.filas == NULL || threads == NULL || criadas == NULL || argumentos == NULL)
+	{
+		fprintf(stderr, "Sem memória para o modo lote.\n");
+		return 1;
+	}
+	for (int i = 0; i < numThreads; i++)
+	{
+		pthread_mutex_init(&contexto.filas[i].trava, NULL);
+		contexto.filas[i].inicio = (int)((int64_t)total * i / numThreads);
+		contexto.filas[i].fim = (int)((int64_t)total * (i + 1) / numThreads);
+	}
+
+	struct timespec inicio;
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		argumentos[i].contexto = &contexto;
+		argumentos[i].id = i;
+		// se a thread não for criada, as tarefas da fila dela são roubadas pelas outras
+		criadas[i] = pthread_create(&threads[i], NULL, trabalhadorLote, &argumentos[i]) == 0;
+		if (!criadas[i])
+			fprintf(stderr, "Não foi possível criar a thread %d.\n", i);
+	}
+	for (int i = 0; i < numThreads; i++)
+	{
+		if (criadas[i])
+			pthread_join(threads[i], NULL);
+	}
+
+	const int falhas = gravarResultadosLote(caminhoResultados, tarefas, total, numThreads, segundosDesde(&inicio));
+
+	for (int i = 0; i < numThreads; i++)
+		pthread_mutex_destroy(&contexto.filas[i].trava);
+	liberarTarefasLote(tarefas, total);
+	free(contexto.filas);
+	free(threads);
+	free(criadas);
+	free(argumentos);
+
+	return falhas != 0;
+}
+
+// imagem carregada uma vez no modo frota; as instâncias mapeiam o memfd copy-on-write
+typedef struct
+{
+	uint64_t hash;	  // hashConteudo da memória carregada (imagens iguais com nomes diferentes também são compartilhadas)
+	uint32_t entrada; // pc inicial
+	int fd;			  // memfd com os TAM_MEMORIA bytes da imagem
+} ImagemFrota;
+
+// instância do modo frota: a máquina e os buffers da UART (sem descritores de arquivo por instância)
+typedef struct
+{
+	Maquina *m;
+	int tarefa;
+	char *entradaUART; // conteúdo do arquivo de entrada, lido pela máquina com fmemopen
+	char *saidaUART;   // saída capturada com open_memstream
+	size_t tamSaidaUART;
+} InstanciaFrota;
+
+typedef struct
+{
+	const char *caminho;
+	int tarefa;
+} OrdemFrota;
+
+static int compararOrdemFrota(const void *a, const void *b)
+{
+	const OrdemFrota *oa = a;
+	const OrdemFrota *ob = b;
+	const int c = strcmp(oa->caminho, ob->caminho);
+	return c != 0 ? c : oa->tarefa - ob->tarefa;
+}
+
+// lê um arquivo inteiro para a memória (NULL em erro)
+static char *lerArquivoInteiro(const char *caminho, size_t *tamanho)
+{
+	FILE *arquivo = fopen(caminho, "rb");
+	if (arquivo == NULL)
+		return NULL;
+	char *dados = NULL;
+	size_t usados = 0, capacidade = 0, lidos;
+	do
+	{
+		if (usados == capacidade)
+		{
+			capacidade = capacidade ? 2 * capacidade : 4096;
+			dados = realloc(dados, capacidade);
+		}
+		lidos = fread(dados + usados, 1, capacidade - usados, arquivo);
+		usados += lidos;
+	} while (lidos > 0);
+	fclose(arquivo);
+	*tamanho = usados;
+	return dados;
+}
+
+// carrega a imagem em um memfd, reaproveitando um já existente quando o conteúdo é idêntico
+// retorna o índice em *imagens, ou -1 se a imagem não pôde ser carregada
+static int carregarImagemFrota(Maquina *carregadora, const char *caminho, ImagemFrota **imagens, int *numImagens)
+{
+	poximReiniciar(carregadora);
+	if (poximCarregarImagem(carregadora, caminho) != 0)
+		return -1;
+
+	const uint64_t hash = hashConteudo(carregadora->mem, TAM_MEMORIA);
+	for (int i = 0; i < *numImagens; i++)
+	{
+		if ((*imagens)[i].hash == hash && (*imagens)[i].entrada == carregadora->pc)
+			return i;
+	}
+
+	const int fd = memfd_create("poximv2-frota", 0);
+	if (fd < 0 || ftruncate(fd, TAM_MEMORIA) != 0 || pwrite(fd, carregadora->mem, TAM_MEMORIA, 0) != TAM_MEMORIA)
+	{
+		fprintf(stderr, "Não foi possível criar a memória compartilhada de %s.\n", caminho);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	*imagens = realloc(*imagens, (*numImagens + 1) * sizeof(ImagemFrota));
+	(*imagens)[*numImagens] = (ImagemFrota){hash, carregadora->pc, fd};
+	return (*numImagens)++;
+}
+
+// termina uma instância: guarda o resultado na tarefa e libera a máquina
+static void encerrarInstanciaFrota(InstanciaFrota *instancia, TarefaLote *tarefa, int evento)
+{
+	Maquina *m = instancia->m;
+	tarefa->codigo = codigoEvento(evento);
+	tarefa->pc = m->pc;
+	tarefa->a0 = m->registradores[10];
+	tarefa->instrucoes = m->instrucoes;
+
+	fclose(m->entradaUART);
+	fclose(m->saidaUART);
+	tarefa->confere = (tarefa->esperada != NULL)
+						  ? conferirArquivo(tarefa->esperada, instancia->saidaUART, instancia->tamSaidaUART)
+						  : -1;
+	free(instancia->entradaUART);
+	free(instancia->saidaUART);
+	m->saida = NULL; // o trace descartado é compartilhado
+	poximDestruir(m);
+	instancia->m = NULL;
+}
+
+// modo frota: todas as tarefas do manifesto intercaladas em uma única thread (escalonamento cooperativo M:N)
+// cada instância roda até fatia instruções e cede a vez antes disso se executar wfi ou esperar entrada na UART;
+// imagens iguais compartilham a memória copy-on-write, então cada instância só ocupa as páginas que escreveu
+// retorna 0 se todas as tarefas terminaram em ebreak com a saída esperada, 1 caso contrário
+int executarFrota(const char *caminhoManifesto, const char *caminhoResultados, uint64_t fatia, uint64_t limite)
+{
+	TarefaLote *tarefas = NULL;
+	const int total = lerManifestoLote(caminhoManifesto, &tarefas);
+	if (total < 0)
+		return 1;
+
+	// instâncias da mesma imagem ficam vizinhas na fila: as páginas compartilhadas continuam quentes no cache
+	OrdemFrota *ordem = malloc((total + 1) * sizeof(OrdemFrota));
+	InstanciaFrota *instancias = calloc(total + 1, sizeof(InstanciaFrota)); // fixas: o open_memstream guarda o endereço
+	InstanciaFrota **fila = malloc((total + 1) * sizeof(InstanciaFrota *));
+	Maquina *carregadora = poximCriar();
+	if (ordem == NULL || instancias == NULL || fila == NULL || carregadora == NULL)
+	{
+		fprintf(stderr, "Sem memória para o modo frota.\n");
+		return 1;
+	}
+	for (int i = 0; i < total; i++)
+		ordem[i] = (OrdemFrota){tarefas[i].imagem, i};
+	qsort(ordem, total, sizeof(OrdemFrota), compararOrdemFrota);
+
+	struct timespec inicio;
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	// cria as instâncias
+	ImagemFrota *imagens = NULL;
+	int numImagens = 0, ativas = 0, imagemAtual = -1;
+	for (int i = 0; i < total; i++)
+	{
+		TarefaLote *tarefa = &tarefas[ordem[i].tarefa];
+		tarefa->confere = -1;
+		tarefa->pc = OFFSET_MEMORIA; // falha na carga: o mesmo pc do modo lote (máquina reiniciada)
+		if (i == 0 || strcmp(ordem[i].caminho, ordem[i - 1].caminho) != 0)
+			imagemAtual = carregarImagemFrota(carregadora, tarefa->imagem, &imagens, &numImagens);
+		if (imagemAtual < 0)
+		{
+			tarefa->codigo = 3;
+			continue;
+		}
+
+		InstanciaFrota *instancia = &instancias[ativas];
+		size_t tamEntrada = 0;
+		instancia->tarefa = ordem[i].tarefa;
+		instancia->entradaUART = (tarefa->entrada != NULL) ? lerArquivoInteiro(tarefa->entrada, &tamEntrada) : NULL;
+		if (tarefa->entrada != NULL && instancia->entradaUART == NULL)
+		{
+			fprintf(stderr, "Não foi possível abrir a entrada UART %s.\n", tarefa->entrada);
+			tarefa->codigo = 3;
+			continue;
+		}
+
+		Maquina *m = poximCriar();
+		if (m == NULL ||
+			mmap(m->mem, TAM_MEMORIA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, imagens[imagemAtual].fd, 0) ==
+				MAP_FAILED)
+		{
+			fprintf(stderr, "Não foi possível criar a instância da tarefa %d.\n", instancia->tarefa);
+			poximDestruir(m);
+			free(instancia->entradaUART);
+			tarefa->codigo = 3;
+			continue;
+		}
+		m->pc = imagens[imagemAtual].entrada;
+		m->saida = NULL; // sem trace: as instâncias não formatam nada
+		m->entradaUART = fmemopen(instancia->entradaUART != NULL ? instancia->entradaUART : "", tamEntrada, "r");
+		m->saidaUART = open_memstream(&instancia->saidaUART, &instancia->tamSaidaUART);
+		instancia->m = m;
+		fila[ativas++] = instancia;
+	}
+
+	// rodadas de escalonamento: cada instância ativa recebe uma fatia; as que terminam saem da fila
+	while (ativas > 0)
+	{
+		int restantes = 0;
+		for (int i = 0; i < ativas; i++)
+		{
+			InstanciaFrota *instancia = fila[i];
+			Maquina *m = instancia->m;
+			const uint64_t orcamento = (limite - m->instrucoes < fatia) ? limite - m->instrucoes : fatia;
+			const int evento = poximExecutar(m, orcamento);
+
+			const int cedeu = evento == EVENTO_WFI || evento == EVENTO_UART_VAZIA || evento == EVENTO_LIMITE;
+			if (cedeu && m->instrucoes < limite)
+			{
+				fila[restantes++] = instancia;
+				continue;
+			}
+			encerrarInstanciaFrota(instancia, &tarefas[instancia->tarefa], evento);
+		}
+		ativas = restantes;
+	}
+
+	const int falhas = gravarResultadosLote(caminhoResultados, tarefas, total, 1, segundosDesde(&inicio));
+
+	for (int i = 0; i < numImagens; i++)
+		close(imagens[i].fd);
+	free(imagens);
+	poximDestruir(carregadora);
+	free(instancias);
+	free(fila);
+	free(ordem);
+	liberarTarefasLote(tarefas, total);
+	return falhas != 0;
+}
+
+// modo lockstep: K cópias da mesma imagem andam juntas enquanto têm o mesmo pc
+// os registradores ficam em estrutura de arrays (registradores[r][pista]), então as instruções de ALU
+// viram uma operação vetorial por bloco de pistas (AVX2/AVX-512 quando o compilador tem o alvo)
+#define MAX_PISTAS 64
+#if defined(__AVX512F__)
+#define PISTAS_POR_VETOR 16
+#else
+#define PISTAS_POR_VETOR 8
+#endif
+typedef uint32_t VetorU32 __attribute__((vector_size(PISTAS_POR_VETOR * 4)));
+typedef int32_t VetorI32 __attribute__((vector_size(PISTAS_POR_VETOR * 4)));
+
+typedef struct
+{
+	_Alignas(64) uint32_t registradores[32][MAX_PISTAS]; // valem só para as pistas do grupo
+	Maquina *pistas[MAX_PISTAS];
+	int numPistas;
+	int ativas[MAX_PISTAS]; // pistas que ainda andam juntas
+	int numAtivas;
+	int eventos[MAX_PISTAS]; // EVENTO_* final de cada pista (EVENTO_NENHUM = ainda rodando)
+	uint32_t pc;
+	uint64_t pendentes;			  // instruções vetoriais ainda não somadas em instrucoes/mtime das pistas
+	int interrupcoesPossiveis;	  // alguma pista pode receber interrupção (então tudo passa pelo caminho escalar)
+	uint64_t instrucoesVetoriais; // instruções executadas uma vez para o grupo todo
+	uint64_t passosEscalares;	  // instruções executadas pista a pista
+	uint64_t divergencias;		  // pistas que saíram do grupo
+} GrupoLockstep;
+
+// operações de ALU que o caminho vetorial sabe fazer
+enum
+{
+	VETOR_NENHUMA = 0,
+	VETOR_ADD,
+	VETOR_SUB,
+	VETOR_SLL,
+	VETOR_SLT,
+	VETOR_SLTU,
+	VETOR_XOR,
+	VETOR_SRL,
+	VETOR_SRA,
+	VETOR_OR,
+	VETOR_AND,
+	VETOR_MUL,
+	VETOR_CONSTANTE, // lui/auipc: rd recebe o mesmo valor em todas as pistas
+};
+
+// decodifica instruções de ALU sem efeitos além de rd (e o pc + 4); o resto fica com o caminho escalar
+static int operacaoVetorial(uint32_t instrucao, uint32_t pc, uint32_t *imediato, int *usaImediato)
+{
+	const uint32_t opcode = instrucao & 0b1111111;
+	const uint32_t funct3 = (instrucao >> 12) & 0b111;
+	const uint32_t funct7 = instrucao >> 25;
+	static const int operacoesOp[8] = {VETOR_ADD, VETOR_SLL, VETOR_SLT, VETOR_SLTU, VETOR_XOR, VETOR_SRL, VETOR_OR, VETOR_AND};
+
+	*usaImediato = 0;
+	switch (opcode)
+	{
+	case 0b0110011: // R: add, sub, sll, slt, sltu, xor, srl, sra, or, and, mul
+		if (funct7 == 0b0000000)
+			return operacoesOp[funct3];
+		if (funct7 == 0b0100000 && funct3 == 0b000)
+			return VETOR_SUB;
+		if (funct7 == 0b0100000 && funct3 == 0b101)
+			return VETOR_SRA;
+		if (funct7 == 0b0000001 && funct3 == 0b000)
+			return VETOR_MUL;
+		return VETOR_NENHUMA; // mulh*/div/rem e codificações inválidas
+	case 0b0010011: // I: addi, slti, sltiu, xori, ori, andi, slli, srli, srai
+		*usaImediato = 1;
+		*imediato = (uint32_t)(((int32_t)instrucao) >> 20);
+		if (funct3 == 0b001 || funct3 == 0b101)
+		{
+			*imediato = (instrucao >> 20) & 0b11111;
+			if (funct3 == 0b101 && funct7 == 0b0100000)
+				return VETOR_SRA;
+			if (funct7 != 0b0000000)
+				return VETOR_NENHUMA;
+		}
+		return operacoesOp[funct3];
+	case 0b0110111: // lui
+		*imediato = instrucao & 0xFFFFF000;
+		return VETOR_CONSTANTE;
+	case 0b0010111: // auipc
+		*imediato = pc + (instrucao & 0xFFFFF000);
+		return VETOR_CONSTANTE;
+	default:
+		return VETOR_NENHUMA;
+	}
+}
+
+// rd = rs1 (op) rs2/imediato em todas as pistas, um bloco de PISTAS_POR_VETOR por vez
+static void executarVetorial(GrupoLockstep *g, int operacao, uint32_t rd, uint32_t rs1, uint32_t rs2, uint32_t imediato,
+							 int usaImediato)
+{
+	if (rd == 0)
+		return;
+	const int blocos = (g->numPistas + PISTAS_POR_VETOR - 1) / PISTAS_POR_VETOR;
+	VetorU32 *destino = (VetorU32 *)g->registradores[rd];
+	const VetorU32 *a = (const VetorU32 *)g->registradores[rs1];
+	const VetorU32 *b = (const VetorU32 *)g->registradores[rs2];
+	const VetorU32 constante = (VetorU32){0} + imediato;
+
+	for (int i = 0; i < blocos; i++)
+	{
+		const VetorU32 x = a[i];
+		const VetorU32 y = usaImediato ? constante : b[i];
+		VetorU32 r;
+		switch (operacao)
+		{
+		case VETOR_ADD:
+			r = x + y;
+			break;
+		case VETOR_SUB:
+			r = x - y;
+			break;
+		case VETOR_SLL:
+			r = x << (y & 31);
+			break;
+		case VETOR_SLT:
+			r = (VetorU32)((VetorI32)x < (VetorI32)y) & 1;
+			break;
+		case VETOR_SLTU:
+			r = (VetorU32)(x < y) & 1;
+			break;
+		case VETOR_XOR:
+			r = x ^ y;
+			break;
+		case VETOR_SRL:
+			r = x >> (y & 31);
+			break;
+		case VETOR_SRA:
+			r = (VetorU32)((VetorI32)x >> (VetorI32)(y & 31));
+			break;
+		case VETOR_OR:
+			r = x | y;
+			break;
+		case VETOR_AND:
+			r = x & y;
+			break;
+		case VETOR_MUL:
+			r = x * y;
+			break;
+		default: // VETOR_CONSTANTE
+			r = constante;
+			break;
+		}
+		destino[i] = r;
+	}
+}
+
+// soma nas pistas as instruções vetoriais acumuladas (contador de instruções e mtime andam juntos)
+static void sincronizarContadores(GrupoLockstep *g)
+{
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		Maquina *m = g->pistas[g->ativas[i]];
+		m->instrucoes += g->pendentes;
+		m->clint_mtime += g->pendentes;
+	}
+	g->pendentes = 0;
+}
+
+// confere se alguma pista do grupo pode ser interrompida (mstatus.MIE e alguma fonte habilitada em mie)
+static void atualizarInterrupcoes(GrupoLockstep *g)
+{
+	g->interrupcoesPossiveis = 0;
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		const Maquina *m = g->pistas[g->ativas[i]];
+		if ((m->registradoresCSRs[0] & (1 << 3)) && (m->registradoresCSRs[1] & ((1 << 3) | (1 << 7) | (1 << 11))))
+			g->interrupcoesPossiveis = 1;
+	}
+}
+
+// tira do grupo as pistas marcadas em saindo; elas recebem todos os registradores e seguem sozinhas depois
+static void separarPistas(GrupoLockstep *g, const uint8_t *saindo)
+{
+	int restantes = 0;
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		const int p = g->ativas[i];
+		Maquina *m = g->pistas[p];
+		if (!saindo[p])
+		{
+			g->ativas[restantes++] = p;
+			continue;
+		}
+		for (int r = 1; r < 32; r++)
+			m->registradores[r] = g->registradores[r][p];
+		if (g->eventos[p] == EVENTO_NENHUM)
+			g->divergencias++;
+	}
+	g->numAtivas = restantes;
+}
+
+// uma instrução pista a pista: só rs1, rs2 e rd (os campos da instrução) precisam ir e voltar da Maquina
+static void passoEscalar(GrupoLockstep *g, uint32_t instrucao, uint64_t limite)
+{
+	const uint32_t rd = (instrucao >> 7) & 0b11111;
+	const uint32_t rs1 = (instrucao >> 15) & 0b11111;
+	const uint32_t rs2 = (instrucao >> 20) & 0b11111;
+
+	sincronizarContadores(g);
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		const int p = g->ativas[i];
+		Maquina *m = g->pistas[p];
+		m->registradores[rs1] = g->registradores[rs1][p];
+		m->registradores[rs2] = g->registradores[rs2][p];
+		m->registradores[rd] = g->registradores[rd][p];
+		m->pc = g->pc;
+
+		const int evento = poximPasso(m);
+		g->registradores[rd][p] = m->registradores[rd];
+		if (evento == EVENTO_EBREAK || evento == EVENTO_CSR_INVALIDO)
+			g->eventos[p] = evento;
+		else if (m->instrucoes >= limite)
+			g->eventos[p] = EVENTO_LIMITE;
+		g->passosEscalares++;
+	}
+
+	// o grupo segue o pc da maioria das pistas que continuam
+	int maior = 0;
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		const int p = g->ativas[i];
+		if (g->eventos[p] != EVENTO_NENHUM)
+			continue;
+		int iguais = 0;
+		for (int j = 0; j < g->numAtivas; j++)
+			iguais += g->eventos[g->ativas[j]] == EVENTO_NENHUM && g->pistas[g->ativas[j]]->pc == g->pistas[p]->pc;
+		if (iguais > maior)
+		{
+			maior = iguais;
+			g->pc = g->pistas[p]->pc;
+		}
+	}
+
+	uint8_t saindo[MAX_PISTAS];
+	for (int i = 0; i < g->numAtivas; i++)
+	{
+		const int p = g->ativas[i];
+		saindo[p] = g->eventos[p] != EVENTO_NENHUM || g->pistas[p]->pc != g->pc;
+	}
+	separarPistas(g, saindo);
+	atualizarInterrupcoes(g);
+}
+
+// executa o grupo em lockstep até todas as pistas terminarem ou divergirem
+static void executarGrupo(GrupoLockstep *g, uint64_t limite)
+{
+	uint8_t saindo[MAX_PISTAS];
+	atualizarInterrupcoes(g);
+	while (g->numAtivas > 0)
+	{
+		Maquina *primeira = g->pistas[g->ativas[0]];
+		if (primeira->instrucoes + g->pendentes >= limite)
+		{
+			// todas as pistas do grupo têm a mesma contagem: param juntas
+			sincronizarContadores(g);
+			for (int i = 0; i < g->numAtivas; i++)
+			{
+				const int p = g->ativas[i];
+				g->pistas[p]->pc = g->pc;
+				g->eventos[p] = EVENTO_LIMITE;
+				saindo[p] = 1;
+			}
+			separarPistas(g, saindo);
+			break;
+		}
+		if (g->pc < OFFSET_MEMORIA || g->pc - OFFSET_MEMORIA >= TAM_MEMORIA)
+		{
+			passoEscalar(g, 0, limite); // cada pista trata a exceção de acesso
+			continue;
+		}
+
+		// código diferente (RAM alterada pela entrada) também é divergência: ficam as pistas iguais à primeira
+		const uint32_t indice = (g->pc - OFFSET_MEMORIA) >> 2;
+		const uint32_t instrucao = ((uint32_t *)primeira->mem)[indice];
+		int diferentes = 0;
+		for (int i = 0; i < g->numAtivas; i++)
+		{
+			const int p = g->ativas[i];
+			saindo[p] = ((uint32_t *)g->pistas[p]->mem)[indice] != instrucao;
+			diferentes += saindo[p];
+		}
+		if (diferentes > 0)
+		{
+			sincronizarContadores(g);
+			for (int i = 0; i < g->numAtivas; i++)
+				g->pistas[g->ativas[i]]->pc = g->pc;
+			separarPistas(g, saindo);
+			atualizarInterrupcoes(g);
+		}
+
+		uint32_t imediato = 0;
+		int usaImediato;
+		const int operacao = operacaoVetorial(instrucao, g->pc, &imediato, &usaImediato);
+		if (operacao == VETOR_NENHUMA || g->interrupcoesPossiveis)
+		{
+			passoEscalar(g, instrucao, limite);
+			continue;
+		}
+
+		executarVetorial(g, operacao, (instrucao >> 7) & 0b11111, (instrucao >> 15) & 0b11111, (instrucao >> 20) & 0b11111,
+						 imediato, usaImediato);
+		g->pendentes++;
+		g->instrucoesVetoriais++;
+		g->pc += 4;
+	}
+}
+
+// modo lockstep: a imagem roda em uma pista por linha de caminhoLista ("entradaUART [endereco=valor ...]",
+// "-" = sem entrada; cada endereco=valor grava uma palavra na RAM da pista antes de começar)
+// as pistas que divergem terminam sozinhas; grava "<lista>.resultados" e a saída UART em "<entrada>.terminal.out"
+int executarLockstep(const char *caminhoImagem, const char *caminhoLista, uint64_t limite)
+{
+	FILE *lista = fopen(caminhoLista, "r");
+	if (lista == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir a lista de entradas %s.\n", caminhoLista);
+		return 1;
+	}
+
+	GrupoLockstep *g = aligned_alloc(64, sizeof(GrupoLockstep));
+	Maquina *carregadora = poximCriar();
+	ImagemFrota *imagens = NULL;
+	int numImagens = 0;
+	if (g == NULL || carregadora == NULL ||
+		carregarImagemFrota(carregadora, caminhoImagem, &imagens, &numImagens) < 0)
+	{
+		fprintf(stderr, "Não foi possível preparar o modo lockstep.\n");
+		fclose(lista);
+		return 1;
+	}
+	memset(g, 0, sizeof(*g));
+	g->pc = imagens[0].entrada;
+
+	char *nomes[MAX_PISTAS];
+	char linha[4096];
+	while (fgets(linha, sizeof(linha), lista) != NULL && g->numPistas < MAX_PISTAS)
+	{
+		char *resto = NULL;
+		char *entrada = strtok_r(linha, " \t\r\n", &resto);
+		if (entrada == NULL || entrada[0] == '#')
+			continue;
+
+		Maquina *m = poximCriar();
+		if (m == NULL ||
+			mmap(m->mem, TAM_MEMORIA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, imagens[0].fd, 0) == MAP_FAILED)
+		{
+			fprintf(stderr, "Não foi possível criar a pista de %s.\n", entrada);
+			return 1;
+		}
+		m->pc = imagens[0].entrada;
+		m->saida = NULL; // sem trace: as pistas não formatam nada
+		m->entradaUART = fopen(strcmp(entrada, "-") != 0 ? entrada : "/dev/null", "r");
+		char nome[4200];
+		snprintf(nome, sizeof(nome), "%s.terminal.out", strcmp(entrada, "-") != 0 ? entrada : caminhoLista);
+		m->saidaUART = fopen(nome, "w");
+		if (m->entradaUART == NULL || m->saidaUART == NULL)
+		{
+			fprintf(stderr, "Não foi possível abrir os arquivos UART de %s.\n", entrada);
+			return 1;
+		}
+
+		// alterações iniciais da RAM desta pista
+		for (char *alteracao = strtok_r(NULL, " \t\r\n", &resto); alteracao != NULL;
+			 alteracao = strtok_r(NULL, " \t\r\n", &resto))
+		{
+			char *valor = strchr(alteracao, '=');
+			const uint32_t palavra = (valor != NULL) ? strtoul(valor + 1, NULL, 0) : 0;
+			if (valor == NULL || poximEscreverMemoria(m, strtoul(alteracao, NULL, 0), &palavra, 4) != 0)
+				fprintf(stderr, "Alteração de memória inválida ignorada: %s\n", alteracao);
+		}
+
+		nomes[g->numPistas] = strdup(entrada);
+		g->pistas[g->numPistas] = m;
+		g->ativas[g->numAtivas++] = g->numPistas;
+		g->numPistas++;
+	}
+	if (g->numPistas == MAX_PISTAS && fgets(linha, sizeof(linha), lista) != NULL)
+		fprintf(stderr, "Aviso: só as primeiras %d entradas são usadas no modo lockstep.\n", MAX_PISTAS);
+	fclose(lista);
+
+	executarGrupo(g, limite);
+
+	// pistas que divergiram terminam no caminho escalar
+	for (int p = 0; p < g->numPistas; p++)
+	{
+		Maquina *m = g->pistas[p];
+		while (g->eventos[p] == EVENTO_NENHUM)
+		{
+			const int evento = poximExecutar(m, limite - m->instrucoes);
+			if (evento == EVENTO_EBREAK || evento == EVENTO_CSR_INVALIDO)
+				g->eventos[p] = evento;
+			else if (m->instrucoes >= limite)
+				g->eventos[p] = EVENTO_LIMITE;
+		}
+	}
+
+	char caminhoResultados[4200];
+	snprintf(caminhoResultados, sizeof(caminhoResultados), "%s.resultados", caminhoLista);
+	FILE *saida = fopen(caminhoResultados, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar %s.\n", caminhoResultados);
+		saida = stderr;
+	}
+	for (int p = 0; p < g->numPistas; p++)
+	{
+		const Maquina *m = g->pistas[p];
+		fprintf(saida, "%s codigo=%d pc=0x%08x a0=0x%08x instrucoes=%llu\n", nomes[p], codigoEvento(g->eventos[p]), m->pc,
+				m->registradores[10], (unsigned long long)m->instrucoes);
+	}
+	fprintf(saida, "# pistas=%d largura=%d instrucoes_vetoriais=%llu passos_escalares=%llu divergencias=%llu\n",
+			g->numPistas, PISTAS_POR_VETOR, (unsigned long long)g->instrucoesVetoriais,
+			(unsigned long long)g->passosEscalares, (unsigned long long)g->divergencias);
+	if (saida != stderr)
+		fclose(saida);
+
+	for (int p = 0; p < g->numPistas; p++)
+	{
+		Maquina *m = g->pistas[p];
+		fclose(m->entradaUART);
+		fclose(m->saidaUART);
+		poximDestruir(m);
+		free(nomes[p]);
+	}
+	close(imagens[0].fd);
+	free(imagens);
+	poximDestruir(carregadora);
+	free(g);
+	return 0;
+}
+
+// profiler por amostragem: o pc é amostrado a cada N instruções, sem depender do trace
+// (o interpretador não muda: quem roda a máquina para nos pontos de amostra)
+typedef struct
+{
+	uint64_t cada;					   // instruções entre amostras (0 = desligado)
+	uint64_t proxima;				   // m->instrucoes da próxima amostra
+	uint64_t amostras;				   // total de amostras
+	uint64_t fora;					   // amostras com pc fora da RAM
+	uint64_t contagens[TAM_MEMORIA / 4]; // amostras por palavra da RAM
+} Perfil;
+
+typedef struct
+{
+	uint64_t amostras;
+	uint32_t inicio;
+	uint32_t fim; // endereço da última instrução
+	const char *nome;
+} ItemPerfil;
+
+static int compararItensPerfil(const void *a, const void *b)
+{
+	const ItemPerfil *ia = a;
+	const ItemPerfil *ib = b;
+	if (ia->amostras != ib->amostras)
+		return (ia->amostras < ib->amostras) - (ia->amostras > ib->amostras); // decrescente
+	return (ia->inicio > ib->inicio) - (ia->inicio < ib->inicio);
+}
+
+void amostrarPerfil(Perfil *perfil, const Maquina *m)
+{
+	while (m->instrucoes >= perfil->proxima)
+	{
+		if (m->pc >= OFFSET_MEMORIA && m->pc - OFFSET_MEMORIA < TAM_MEMORIA)
+			perfil->contagens[(m->pc - OFFSET_MEMORIA) >> 2]++;
+		else
+			perfil->fora++;
+		perfil->amostras++;
+		perfil->proxima += perfil->cada;
+	}
+}
+
+// marca o início de cada bloco básico decodificando a RAM: alvos de desvio/jal, instruções depois
+// de desvios, saltos e instruções de sistema, símbolos e o ponto de entrada (dados decodificados
+// como instrução só criam divisões a mais)
+static void marcarLideres(const Maquina *m, uint32_t entrada, uint8_t *lider)
+{
+	const uint32_t *palavras = (const uint32_t *)m->mem;
+	const uint32_t total = TAM_MEMORIA / 4;
+	lider[0] = 1;
+	if (entrada >= OFFSET_MEMORIA && entrada - OFFSET_MEMORIA < TAM_MEMORIA)
+		lider[(entrada - OFFSET_MEMORIA) >> 2] = 1;
+	for (int i = 0; i < m->numSimbolos; i++)
+		lider[(m->simbolos[i].endereco - OFFSET_MEMORIA) >> 2] = 1;
+
+	for (uint32_t i = 0; i < total; i++)
+	{
+		const uint32_t instrucao = palavras[i];
+		const uint32_t pc = OFFSET_MEMORIA + 4 * i;
+		int32_t deslocamento;
+		switch (instrucao & 0b1111111)
+		{
+		case 0b1100011: // desvios
+			deslocamento = (((int32_t)(instrucao & 0x80000000)) >> 19) | ((instrucao & 0x80) << 4) |
+						   ((instrucao >> 20) & 0x7e0) | ((instrucao >> 7) & 0x1e);
+			break;
+		case 0b1101111: // jal
+			deslocamento = (((int32_t)(instrucao & 0x80000000)) >> 11) | (instrucao & 0xff000) |
+						   ((instrucao >> 9) & 0x800) | ((instrucao >> 20) & 0x7fe);
+			break;
+		case 0b1100111: // jalr
+		case 0b1110011: // ecall, ebreak, mret, wfi, CSRs
+			deslocamento = 0;
+			break;
+		default:
+			continue;
+		}
+		if (deslocamento != 0 && pc + deslocamento - OFFSET_MEMORIA < TAM_MEMORIA)
+			lider[(pc + deslocamento - OFFSET_MEMORIA) >> 2] = 1;
+		if (i + 1 < total)
+			lider[i + 1] = 1;
+	}
+}
+
+static void gravarItensPerfil(FILE *saida, const char *titulo, ItemPerfil *itens, int numItens, uint64_t amostras,
+							  int maximo)
+{
+	qsort(itens, numItens, sizeof(ItemPerfil), compararItensPerfil);
+	fprintf(saida, "\n# %s\n", titulo);
+	for (int i = 0; i < numItens && i < maximo && itens[i].amostras != 0; i++)
+	{
+		fprintf(saida, "%10llu %6.2f%%  0x%08x", (unsigned long long)itens[i].amostras,
+				100.0 * itens[i].amostras / amostras, itens[i].inicio);
+		if (itens[i].fim != itens[i].inicio)
+			fprintf(saida, "-0x%08x", itens[i].fim);
+		fprintf(saida, "  %s\n", itens[i].nome != NULL ? itens[i].nome : "?");
+	}
+}
+
+// relatório do perfil: endereços, blocos básicos e (com símbolos) funções mais amostrados
+int gravarPerfil(const Perfil *perfil, const Maquina *m, uint32_t entrada, const char *caminho, int maximo)
+{
+	FILE *saida = fopen(caminho, "w");
+	uint8_t *lider = calloc(TAM_MEMORIA / 4, 1);
+	// uma entrada por palavra da RAM ou por símbolo (o mapa pode ter mais símbolos que palavras)
+	const int maxItens = (m->numSimbolos > TAM_MEMORIA / 4) ? m->numSimbolos : TAM_MEMORIA / 4;
+	ItemPerfil *itens = malloc(maxItens * sizeof(ItemPerfil));
+	if (saida == NULL || lider == NULL || itens == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar o perfil em %s.\n", caminho);
+		if (saida != NULL)
+			fclose(saida);
+		free(lider);
+		free(itens);
+		return -1;
+	}
+	const uint64_t amostras = perfil->amostras != 0 ? perfil->amostras : 1;
+	fprintf(saida, "# perfil: %llu amostras, uma a cada %llu instruções (%llu instruções, %llu amostras fora da RAM)\n",
+			(unsigned long long)perfil->amostras, (unsigned long long)perfil->cada, (unsigned long long)m->instrucoes,
+			(unsigned long long)perfil->fora);
+
+	// endereços
+	int numItens = 0;
+	for (uint32_t i = 0; i < TAM_MEMORIA / 4; i++)
+	{
+		if (perfil->contagens[i] == 0)
+			continue;
+		const uint32_t endereco = OFFSET_MEMORIA + 4 * i;
+		const Simbolo *simbolo = poximBuscarSimbolo(m, endereco);
+		itens[numItens++] = (ItemPerfil){perfil->contagens[i], endereco, endereco, simbolo ? simbolo->nome : NULL};
+	}
+	gravarItensPerfil(saida, "enderecos", itens, numItens, amostras, maximo);
+
+	// blocos básicos
+	marcarLideres(m, entrada, lider);
+	numItens = 0;
+	for (uint32_t i = 0; i < TAM_MEMORIA / 4;)
+	{
+		uint32_t fim = i + 1;
+		uint64_t soma = perfil->contagens[i];
+		while (fim < TAM_MEMORIA / 4 && !lider[fim])
+			soma += perfil->contagens[fim++];
+		if (soma != 0)
+		{
+			const Simbolo *simbolo = poximBuscarSimbolo(m, OFFSET_MEMORIA + 4 * i);
+			itens[numItens++] = (ItemPerfil){soma, OFFSET_MEMORIA + 4 * i, OFFSET_MEMORIA + 4 * (fim - 1),
+											 simbolo ? simbolo->nome : NULL};
+		}
+		i = fim;
+	}
+	gravarItensPerfil(saida, "blocos", itens, numItens, amostras, maximo);
+
+	// funções (só com símbolos)
+	if (m->numSimbolos > 0)
+	{
+		numItens = 0;
+		for (int s = 0; s < m->numSimbolos; s++)
+		{
+			const Simbolo *simbolo = &m->simbolos[s];
+			uint32_t fim = (s + 1 < m->numSimbolos) ? m->simbolos[s + 1].endereco : OFFSET_MEMORIA + TAM_MEMORIA;
+			if (simbolo->tamanho != 0 && simbolo->endereco + simbolo->tamanho < fim)
+				fim = simbolo->endereco + simbolo->tamanho;
+			uint64_t soma = 0;
+			for (uint32_t e = simbolo->endereco & ~3u; e < fim; e += 4)
+				soma += perfil->contagens[(e - OFFSET_MEMORIA) >> 2];
+			itens[numItens++] = (ItemPerfil){soma, simbolo->endereco, simbolo->endereco, simbolo->nome};
+		}
+		gravarItensPerfil(saida, "funcoes", itens, numItens, amostras, m->numSimbolos);
+	}
+
+	fclose(saida);
+	free(lider);
+	free(itens);
+	return 0;
+}
+
+// procura uma opção "--nome=valor" depois dos argumentos obrigatórios; retorna o valor ou NULL
+const char *buscarOpcao(int argc, char *argv[], const char *nome)
+{
+	const size_t tamNome = strlen(nome);
+	for (int i = 3; i < argc; i++)
+	{
+		if (strncmp(argv[i], nome, tamNome) == 0 && argv[i][tamNome] == '=')
+		{
+			return argv[i] + tamNome + 1;
+		}
+	}
+	return NULL;
+}
+
+// copia o estado da máquina para o formato do snapshot
+static void capturarEstado(const Maquina *m, Snapshot *estado)
+{
+	memset(estado, 0, sizeof(*estado));
+	estado->offset = OFFSET_MEMORIA;
+	estado->tamanho = TAM_MEMORIA;
+	estado->pc = m->pc;
+	memcpy(estado->registradores, m->registradores, sizeof(estado->registradores));
+	memcpy(estado->registradoresCSRs, m->registradoresCSRs, sizeof(estado->registradoresCSRs));
+	memcpy(estado->registradoresUART, m->registradoresUART, sizeof(estado->registradoresUART));
+	estado->clint_msip = m->clint_msip;
+	estado->clint_mtime = m->clint_mtime;
+	estado->clint_mtimecmp = m->clint_mtimecmp;
+	estado->plic_priority = m->plic_priority;
+	estado->plic_pending = m->plic_pending;
+	estado->plic_enable = m->plic_enable;
+	estado->plic_threshold = m->plic_threshold;
+	estado->plic_claim = m->plic_claim;
+	estado->instrucoes = m->instrucoes;
+	memcpy(estado->eventosHpm, m->eventosHpm, sizeof(estado->eventosHpm));
+	for (uint32_t i = 0; i < 32; i++)
+	{
+		if (i != 1) // time vem de clint_mtime
+			estado->contadores[i] = valorContador(m, i, m->instrucoes + 1);
+	}
+	estado->posEntradaUART = (m->entradaUART != NULL) ? ftell(m->entradaUART) : 0;
+	if (m->saidaUART != NULL)
+	{
+		fflush(m->saidaUART);
+		estado->posSaidaUART = ftell(m->saidaUART);
+	}
+}
+
+int poximSalvarSnapshot(Maquina *m, const char *caminho)
+{
+	Snapshot estado;
+	capturarEstado(m, &estado);
+	if (salvarSnapshot(caminho, &estado, m->mem) != 0)
+		return -1;
+
+	// um snapshot completo é a nova base das páginas sujas
+	memset(m->paginasSujas, 0, sizeof(m->paginasSujas));
+	return 0;
+}
+
+int poximSalvarIncremental(Maquina *m, const char *caminho, const char *anterior)
+{
+	Snapshot estado;
+	capturarEstado(m, &estado);
+	if (salvarSnapshotIncremental(caminho, anterior, &estado, m->mem, m->paginasSujas) != 0)
+		return -1;
+
+	memset(m->paginasSujas, 0, sizeof(m->paginasSujas));
+	return 0;
+}
+
+// copia o estado do formato do snapshot para a máquina (a memória já foi restaurada)
+static void aplicarEstado(Maquina *m, const Snapshot *estado)
+{
+	memcpy(m->registradores, estado->registradores, sizeof(m->registradores));
+	memcpy(m->registradoresCSRs, estado->registradoresCSRs, sizeof(m->registradoresCSRs));
+	m->hartid = estado->registradoresCSRs[7];
+	memcpy(m->registradoresUART, estado->registradoresUART, sizeof(m->registradoresUART));
+	m->pc = estado->pc;
+	m->clint_msip = estado->clint_msip;
+	m->clint_mtime = estado->clint_mtime;
+	m->clint_mtimecmp = estado->clint_mtimecmp;
+	m->plic_priority = estado->plic_priority;
+	m->plic_pending = estado->plic_pending;
+	m->plic_enable = estado->plic_enable;
+	m->plic_threshold = estado->plic_threshold;
+	m->plic_claim = estado->plic_claim;
+	m->instrucoes = estado->instrucoes;
+	memcpy(m->eventosHpm, estado->eventosHpm, sizeof(m->eventosHpm));
+	m->baseContadores[0] = m->instrucoes - estado->contadores[0];
+	m->baseContadores[2] = m->instrucoes - estado->contadores[2];
+	for (uint32_t i = 3; i < 32; i++)
+	{
+		// os contadores voltam a partir da contagem atual desta máquina
+		ativarFonteEvento(m, m->eventosHpm[i]);
+		m->baseContadores[i] = contagemEventoHpm(m, m->eventosHpm[i]) - estado->contadores[i];
+	}
+	memset(m->paginasSujas, 0, sizeof(m->paginasSujas));
+	if (m->pilhaChamadas != NULL)
+		m->pilhaChamadas->atribuidas = m->instrucoes;
+	if (m->latencias != NULL)
+	{
+		// os traps em andamento e as pendências eram da execução descartada
+		memset(m->latencias->pendente, 0, sizeof(m->latencias->pendente));
+		m->latencias->numTraps = 0;
+	}
+}
+
+// restaura estado e memória; a entrada UART volta para a posição gravada e a saída UART é cortada nela
+int poximRestaurarSnapshot(Maquina *m, const char *caminho)
+{
+	Snapshot estado;
+	if (restaurarSnapshot(caminho, &estado, m->mem, OFFSET_MEMORIA, TAM_MEMORIA) != 0)
+	{
+		return -1;
+	}
+	aplicarEstado(m, &estado);
+
+	// posições dos arquivos da UART
+	if (m->entradaUART != NULL)
+		fseek(m->entradaUART, estado.posEntradaUART, SEEK_SET);
+	if (m->saidaUART != NULL)
+	{
+		fseek(m->saidaUART, 0, SEEK_END);
+		if (ftell(m->saidaUART) > estado.posSaidaUART)
+			ftruncate(fileno(m->saidaUART), estado.posSaidaUART);
+		fseek(m->saidaUART, 0, SEEK_END);
+	}
+	return 0;
+}
+
+static void liberarPilhaChamadas(Maquina *m)
+{
+	PilhaChamadas *p = m->pilhaChamadas;
+	if (p == NULL)
+		return;
+	free(p->nos);
+	free(p->tabela);
+	free(p->quadros);
+	free(p);
+	m->pilhaChamadas = NULL;
+}
+
+// liga a pilha de chamadas sombra; o caminho começa na função do pc atual
+int poximAtivarPilhaChamadas(Maquina *m)
+{
+	PilhaChamadas *p = calloc(1, sizeof(PilhaChamadas));
+	if (p == NULL || (p->quadros = malloc(64 * sizeof(QuadroChamada))) == NULL)
+	{
+		free(p);
+		fprintf(stderr, "Sem memória para a pilha de chamadas.\n");
+		return -1;
+	}
+	p->capQuadros = 64;
+	if (filhoChamada(p, 0, m->pc, 0) == UINT32_MAX)
+	{
+		free(p->quadros);
+		free(p);
+		fprintf(stderr, "Sem memória para a pilha de chamadas.\n");
+		return -1;
+	}
+	p->quadros[0] = (QuadroChamada){0, 0, 0};
+	p->profundidade = 1;
+	p->atribuidas = m->instrucoes;
+	liberarPilhaChamadas(m);
+	m->pilhaChamadas = p;
+	return 0;
+}
+
+// nome de um quadro no formato de flame graph (sem espaços nem ';')
+static void nomeQuadro(const Maquina *m, const NoChamada *no, char *nome, size_t tamanho)
+{
+	if (no->trap)
+	{
+		static const char *interrupcoes[12] = {[3] = "software", [7] = "timer", [11] = "external"};
+		const uint32_t codigo = no->endereco & 0x7FFFFFFF;
+		if ((no->endereco & 0x80000000) && codigo < 12 && interrupcoes[codigo] != NULL)
+			snprintf(nome, tamanho, "[interrupt:%s]", interrupcoes[codigo]);
+		else
+			snprintf(nome, tamanho, "[exception:%s]", nomeExcecao(no->endereco));
+		return;
+	}
+	const Simbolo *simbolo = poximBuscarSimbolo(m, no->endereco);
+	if (simbolo == NULL)
+		snprintf(nome, tamanho, "0x%08x", no->endereco);
+	else if (simbolo->endereco == no->endereco)
+		snprintf(nome, tamanho, "%s", simbolo->nome);
+	else
+		snprintf(nome, tamanho, "%s+0x%x", simbolo->nome, no->endereco - simbolo->endereco);
+}
+
+// escreve o caminho raiz;...;no em saida (caminho: espaço para MAX_PROFUNDIDADE_PILHA índices)
+static void escreverCaminho(FILE *saida, const Maquina *m, uint32_t indice, uint32_t *caminho)
+{
+	const NoChamada *nos = m->pilhaChamadas->nos;
+	uint32_t profundidade = 0;
+	for (; indice != 0; indice = nos[indice].pai)
+		caminho[profundidade++] = indice;
+	caminho[profundidade++] = 0;
+
+	while (profundidade > 0)
+	{
+		char nome[96];
+		nomeQuadro(m, &nos[caminho[--profundidade]], nome, sizeof(nome));
+		fputs(nome, saida);
+		if (profundidade > 0)
+			fputc(';', saida);
+	}
+}
+
+// grava as instruções exclusivas de cada caminho no formato "folded" (flamegraph.pl, speedscope, inferno)
+// e em "<caminho>.caminhos" a lista "inclusivas exclusivas caminho" de todos os caminhos
+int poximGravarPilhaChamadas(Maquina *m, const char *caminho)
+{
+	PilhaChamadas *p = m->pilhaChamadas;
+	if (p == NULL)
+		return -1;
+	atribuirPilha(p, m->instrucoes);
+
+	char caminhoLista[4200];
+	snprintf(caminhoLista, sizeof(caminhoLista), "%s.caminhos", caminho);
+	FILE *folded = fopen(caminho, "w");
+	FILE *lista = fopen(caminhoLista, "w");
+	uint64_t *inclusivas = malloc(p->numNos * sizeof(uint64_t));
+	uint32_t *indices = malloc((MAX_PROFUNDIDADE_PILHA + 1) * sizeof(uint32_t));
+	if (folded == NULL || lista == NULL || inclusivas == NULL || indices == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar a pilha de chamadas em %s.\n", caminho);
+		if (folded != NULL)
+			fclose(folded);
+		if (lista != NULL)
+			fclose(lista);
+		free(inclusivas);
+		free(indices);
+		return -1;
+	}
+
+	// filhos sempre têm índice maior que o pai: uma passada de trás para frente soma as inclusivas
+	for (uint32_t i = 0; i < p->numNos; i++)
+		inclusivas[i] = p->nos[i].exclusivas;
+	for (uint32_t i = p->numNos - 1; i > 0; i--)
+		inclusivas[p->nos[i].pai] += inclusivas[i];
+
+	for (uint32_t i = 0; i < p->numNos; i++)
+	{
+		if (p->nos[i].exclusivas != 0)
+		{
+			escreverCaminho(folded, m, i, indices);
+			fprintf(folded, " %llu\n", (unsigned long long)p->nos[i].exclusivas);
+		}
+		fprintf(lista, "%llu %llu ", (unsigned long long)inclusivas[i], (unsigned long long)p->nos[i].exclusivas);
+		escreverCaminho(lista, m, i, indices);
+		fputc('\n', lista);
+	}
+
+	fclose(folded);
+	fclose(lista);
+	free(inclusivas);
+	free(indices);
+	return 0;
+}
+
+// liga as estatísticas de execução (zeradas)
+int poximAtivarEstatisticas(Maquina *m)
+{
+	if (m->estatisticas == NULL)
+		m->estatisticas = malloc(sizeof(Estatisticas));
+	if (m->estatisticas == NULL)
+	{
+		fprintf(stderr, "Sem memória para as estatísticas.\n");
+		return -1;
+	}
+	memset(m->estatisticas, 0, sizeof(Estatisticas));
+	return 0;
+}
+
+// grava as estatísticas em JSON, ou em CSV ("categoria,nome,contagem") se o caminho termina em ".csv"
+int poximGravarEstatisticas(const Maquina *m, const char *caminho)
+{
+	const Estatisticas *e = m->estatisticas;
+	if (e == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar as estatísticas em %s.\n", caminho);
+		return -1;
+	}
+
+	static const char *nomesInterrupcoes[16] = {[3] = "software", [7] = "timer", [11] = "external"};
+	const size_t tamCaminho = strlen(caminho);
+	const int csv = tamCaminho >= 4 && strcmp(caminho + tamCaminho - 4, ".csv") == 0;
+
+	// cada grupo: categoria, nomes, contagens e quantidade (só as contagens não nulas entram, exceto nas regiões)
+	const struct
+	{
+		const char *categoria;
+		const char *const *nomes;
+		const uint64_t *contagens;
+		int quantidade;
+		int todas;
+	} grupos[] = {
+		{"mnemonicos", nomesMnemonicos, e->mnemonicos, NUM_MNEMONICOS, 0},
+		{"desvios", (const char *const[]){"nao_tomados", "tomados"}, e->desvios, 2, 1},
+		{"loads", nomesRegioes, e->loads, NUM_REGIOES, 1},
+		{"stores", nomesRegioes, e->stores, NUM_REGIOES, 1},
+		{"excecoes", NULL, e->excecoes, 16, 0},
+		{"interrupcoes", nomesInterrupcoes, e->interrupcoes, 16, 0},
+	};
+	const int numGrupos = sizeof(grupos) / sizeof(grupos[0]);
+
+	if (csv)
+		fprintf(saida, "categoria,nome,contagem\ntotal,instrucoes,%llu\n", (unsigned long long)m->instrucoes);
+	else
+		fprintf(saida, "{\n  \"instrucoes\": %llu", (unsigned long long)m->instrucoes);
+
+	for (int g = 0; g < numGrupos; g++)
+	{
+		int escritos = 0;
+		if (!csv)
+			fprintf(saida, ",\n  \"%s\": {", grupos[g].categoria);
+		for (int i = 0; i < grupos[g].quantidade; i++)
+		{
+			if (grupos[g].contagens[i] == 0 && !grupos[g].todas)
+				continue;
+			const char *nome = (grupos[g].nomes != NULL) ? grupos[g].nomes[i] : nomeExcecao(i);
+			char numero[16];
+			if (nome == NULL || strcmp(nome, "unknown") == 0)
+			{
+				snprintf(numero, sizeof(numero), "%d", i);
+				nome = numero;
+			}
+			if (csv)
+				fprintf(saida, "%s,%s,%llu\n", grupos[g].categoria, nome, (unsigned long long)grupos[g].contagens[i]);
+			else
+				fprintf(saida, "%s\"%s\": %llu", escritos ? ", " : "", nome, (unsigned long long)grupos[g].contagens[i]);
+			escritos++;
+		}
+		if (!csv)
+			fputc('}', saida);
+	}
+	if (!csv)
+		fputs("\n}\n", saida);
+
+	fclose(saida);
+	return 0;
+}
+
+// liga a medição de latência dos traps (zerada)
+int poximAtivarLatencias(Maquina *m)
+{
+	if (m->latencias == NULL)
+		m->latencias = malloc(sizeof(Latencias));
+	if (m->latencias == NULL)
+	{
+		fprintf(stderr, "Sem memória para as latências.\n");
+		return -1;
+	}
+	memset(m->latencias, 0, sizeof(Latencias));
+	return 0;
+}
+
+static void gravarHistograma(FILE *saida, const Histograma *h)
+{
+	fprintf(saida, "{\"quantidade\": %llu, \"min\": %llu, \"max\": %llu, \"media\": %.2f, \"baldes\": {",
+			(unsigned long long)h->quantidade, (unsigned long long)h->minimo, (unsigned long long)h->maximo,
+			h->quantidade ? (double)h->soma / h->quantidade : 0.0);
+	int escritos = 0;
+	for (int k = 0; k < BALDES_LATENCIA; k++)
+	{
+		if (h->baldes[k] == 0)
+			continue;
+		const unsigned long long de = k == 0 ? 0 : 1ull << (k - 1);
+		const unsigned long long ate = k == 0 ? 0 : (k == 64 ? UINT64_MAX : (1ull << k) - 1);
+		if (de == ate)
+			fprintf(saida, "%s\"%llu\": %llu", escritos ? ", " : "", de, (unsigned long long)h->baldes[k]);
+		else
+			fprintf(saida, "%s\"%llu-%llu\": %llu", escritos ? ", " : "", de, ate, (unsigned long long)h->baldes[k]);
+		escritos++;
+	}
+	fputs("}}", saida);
+}
+
+// grava em JSON, por tipo de trap tomado: espera (pendente -> tomado) e tratamento (tomado -> mret), em instruções
+// e em ticks de mtime, cada um com quantidade, mínimo, máximo, média e histograma
+int poximGravarLatencias(const Maquina *m, const char *caminho)
+{
+	const Latencias *l = m->latencias;
+	if (l == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar as latências em %s.\n", caminho);
+		return -1;
+	}
+
+	static const char *nomesInterrupcoes[16] = {[3] = "software", [7] = "timer", [11] = "external"};
+	int traps = 0;
+	fprintf(saida, "{\n  \"instrucoes\": %llu,\n  \"traps\": [", (unsigned long long)m->instrucoes);
+	for (int tipo = 0; tipo < TIPOS_TRAP; tipo++)
+	{
+		if (l->tomados[tipo] == 0)
+			continue;
+		const int interrupcao = tipo >= 16;
+		const uint32_t causa = ((uint32_t)interrupcao << 31) | (tipo & 0xF);
+		const char *nome = interrupcao ? nomesInterrupcoes[tipo & 0xF] : nomeExcecao(tipo);
+
+		int abertos = 0; // ainda sem mret no fim da execução
+		for (int i = 0; i < l->numTraps && i < MAX_TRAPS_ATIVOS; i++)
+			abertos += l->traps[i].tipo == tipo;
+
+		fprintf(saida, "%s\n    {\"tipo\": \"%s\", \"nome\": \"%s\", \"causa\": \"0x%08x\", \"tomados\": %llu, \"sem_mret\": %d,",
+				traps ? "," : "", interrupcao ? "interrupt" : "exception", nome != NULL ? nome : "unknown", causa,
+				(unsigned long long)l->tomados[tipo], abertos);
+		fputs("\n     \"espera_instrucoes\": ", saida);
+		gravarHistograma(saida, &l->esperaInstrucoes[tipo]);
+		fputs(",\n     \"espera_mtime\": ", saida);
+		gravarHistograma(saida, &l->esperaMtime[tipo]);
+		fputs(",\n     \"tratamento_instrucoes\": ", saida);
+		gravarHistograma(saida, &l->tratamentoInstrucoes[tipo]);
+		fputs(",\n     \"tratamento_mtime\": ", saida);
+		gravarHistograma(saida, &l->tratamentoMtime[tipo]);
+		fputc('}', saida);
+		traps++;
+	}
+	fputs("\n  ]\n}\n", saida);
+
+	fclose(saida);
+	return 0;
+}
+
+// liga o mapa de acessos (zerado); o conjunto de trabalho é amostrado a cada "cada" instruções
+int poximAtivarMapaAcessos(Maquina *m, uint64_t cada)
+{
+	if (m->mapaAcessos == NULL)
+		m->mapaAcessos = calloc(1, sizeof(MapaAcessos));
+	if (m->mapaAcessos == NULL)
+	{
+		fprintf(stderr, "Sem memória para o mapa de acessos.\n");
+		return -1;
+	}
+	MapaAcessos *a = m->mapaAcessos;
+	free(a->amostras);
+	memset(a, 0, sizeof(*a));
+	a->cada = (cada != 0) ? cada : 10000;
+	a->proxima = m->instrucoes + a->cada;
+	return 0;
+}
+
+static const char *nomeRegistradorMmio(uint32_t endereco)
+{
+	static const struct
+	{
+		uint32_t endereco;
+		const char *nome;
+	} nomes[] = {
+		{0x02000000, "clint.msip"},	   {0x02004000, "clint.mtimecmp"}, {0x02004004, "clint.mtimecmph"},
+		{0x0200BFF8, "clint.mtime"},   {0x0200BFFC, "clint.mtimeh"},   {0x0C000028, "plic.priority10"},
+		{0x0C001000, "plic.pending"},  {0x0C002000, "plic.enable"},	   {0x0C200000, "plic.threshold"},
+		{0x0C200004, "plic.claim"},	   {0x10000000, "uart.rhr_thr"},   {0x10000001, "uart.ier"},
+		{0x10000002, "uart.isr_fcr"},  {0x10000003, "uart.lcr"},	   {0x10000004, "uart.mcr"},
+		{0x10000005, "uart.lsr"},
+	};
+	for (size_t i = 0; i < sizeof(nomes) / sizeof(nomes[0]); i++)
+	{
+		if (nomes[i].endereco == endereco)
+			return nomes[i].nome;
+	}
+	return "-";
+}
+
+// grava o relatório em texto: mapa de calor da RAM (uma linha por KiB, um caractere por bloco, intensidade pelo
+// log2 de leituras + escritas), contagens por bloco (com o símbolo do ELF quando houver), registradores MMIO e a
+// curva do conjunto de trabalho
+int poximGravarMapaAcessos(Maquina *m, const char *caminho)
+{
+	MapaAcessos *a = m->mapaAcessos;
+	if (a == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar o mapa de acessos em %s.\n", caminho);
+		return -1;
+	}
+
+	// a última janela entra na curva mesmo incompleta
+	if (a->numAmostras == 0 || a->amostras[a->numAmostras - 1].instrucoes != m->instrucoes)
+		amostrarConjunto(a, m->instrucoes);
+
+	static const char escala[] = " .:-=+*#%@";
+	const int blocosPorLinha = 1024 / TAM_BLOCO_ACESSO;
+	uint64_t maximo = 0;
+	for (int b = 0; b < BLOCOS_ACESSO; b++)
+	{
+		if ((uint64_t)a->leituras[b] + a->escritas[b] > maximo)
+			maximo = (uint64_t)a->leituras[b] + a->escritas[b];
+	}
+	const int bitsMaximo = maximo ? 64 - __builtin_clzll(maximo) : 1;
+
+	fprintf(saida, "# mapa de calor: %d bytes por caractere, \"%s\" de 0 a %llu acessos (escala log2)\n",
+			TAM_BLOCO_ACESSO, escala, (unsigned long long)maximo);
+	for (int linha = 0; linha < BLOCOS_ACESSO / blocosPorLinha; linha++)
+	{
+		fprintf(saida, "0x%08x |", OFFSET_MEMORIA + linha * blocosPorLinha * TAM_BLOCO_ACESSO);
+		for (int i = 0; i < blocosPorLinha; i++)
+		{
+			const int b = linha * blocosPorLinha + i;
+			const uint64_t total = (uint64_t)a->leituras[b] + a->escritas[b];
+			const int bits = total ? 64 - __builtin_clzll(total) : 0;
+			fputc(escala[total ? 1 + (bits - 1) * (int)(sizeof(escala) - 3) / (bitsMaximo > 1 ? bitsMaximo - 1 : 1) : 0],
+				  saida);
+		}
+		fputs("|\n", saida);
+	}
+
+	fputs("\n# blocos acessados: endereco leituras escritas simbolo\n", saida);
+	for (int b = 0; b < BLOCOS_ACESSO; b++)
+	{
+		if (a->leituras[b] == 0 && a->escritas[b] == 0)
+			continue;
+		const uint32_t endereco = OFFSET_MEMORIA + b * TAM_BLOCO_ACESSO;
+		const Simbolo *simbolo = poximBuscarSimbolo(m, endereco);
+		fprintf(saida, "0x%08x %u %u %s\n", endereco, a->leituras[b], a->escritas[b],
+				simbolo != NULL ? simbolo->nome : "-");
+	}
+
+	fputs("\n# registradores mmio: endereco leituras escritas nome\n", saida);
+	for (int i = 0; i < a->numMmio; i++)
+		fprintf(saida, "0x%08x %llu %llu %s\n", a->mmio[i].endereco, (unsigned long long)a->mmio[i].leituras,
+				(unsigned long long)a->mmio[i].escritas, nomeRegistradorMmio(a->mmio[i].endereco));
+	if (a->outrosMmio[0] || a->outrosMmio[1])
+		fprintf(saida, "outros %llu %llu -\n", (unsigned long long)a->outrosMmio[0], (unsigned long long)a->outrosMmio[1]);
+
+	fprintf(saida, "\n# conjunto de trabalho a cada %llu instrucoes: instrucoes blocos_janela bytes_janela blocos_total "
+				   "bytes_total\n",
+			(unsigned long long)a->cada);
+	for (size_t i = 0; i < a->numAmostras; i++)
+	{
+		const AmostraConjunto *amostra = &a->amostras[i];
+		fprintf(saida, "%llu %u %u %u %u\n", (unsigned long long)amostra->instrucoes, amostra->janela,
+				amostra->janela * TAM_BLOCO_ACESSO, amostra->acumulado, amostra->acumulado * TAM_BLOCO_ACESSO);
+	}
+
+	fclose(saida);
+	return 0;
+}
+
+static void liberarCaches(Maquina *m)
+{
+	if (m->modeloCache == NULL)
+		return;
+	free(m->modeloCache->instrucoes.linhas);
+	free(m->modeloCache->dados.linhas);
+	free(m->modeloCache);
+	m->modeloCache = NULL;
+}
+
+// liga o modelo de caches (vazias, contadores zerados); NULL/0 = padrão (4 KiB, 2 vias, linhas de 32 bytes, LRU;
+// 10 ciclos por falta)
+int poximAtivarCaches(Maquina *m, const char *configInstrucoes, const char *configDados, uint32_t penalidade)
+{
+	ModeloCache *mc = calloc(1, sizeof(ModeloCache));
+	if (mc == NULL)
+	{
+		fprintf(stderr, "Sem memória para as caches.\n");
+		return -1;
+	}
+	if (configurarCache(&mc->instrucoes, configInstrucoes != NULL ? configInstrucoes : "4096,2,32,lru", "cache de instruções") != 0 ||
+		configurarCache(&mc->dados, configDados != NULL ? configDados : "4096,2,32,lru", "cache de dados") != 0)
+	{
+		free(mc->instrucoes.linhas);
+		free(mc);
+		return -1;
+	}
+	mc->penalidade = (penalidade != 0) ? penalidade : 10;
+	liberarCaches(m);
+	m->modeloCache = mc;
+	return 0;
+}
+
+// grava as configurações, acessos, faltas, taxas e a estimativa de ciclos em texto
+int poximGravarCaches(const Maquina *m, const char *caminho)
+{
+	const ModeloCache *mc = m->modeloCache;
+	if (mc == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar o relatório das caches em %s.\n", caminho);
+		return -1;
+	}
+
+	fputs("# cache tamanho vias linha conjuntos politica acessos acertos faltas taxa_faltas escritas_de_volta\n", saida);
+	const Cache *caches[2] = {&mc->instrucoes, &mc->dados};
+	for (int i = 0; i < 2; i++)
+	{
+		const Cache *c = caches[i];
+		fprintf(saida, "%s %u %u %u %u %s %llu %llu %llu %.4f %llu\n", i == 0 ? "icache" : "dcache", c->tamanho, c->vias,
+				c->linha, c->conjuntos, nomesPoliticas[c->politica], (unsigned long long)c->acessos,
+				(unsigned long long)(c->acessos - c->faltas), (unsigned long long)c->faltas,
+				c->acessos ? (double)c->faltas / c->acessos : 0.0, (unsigned long long)c->escritasDeVolta);
+	}
+	const uint64_t ciclos = ciclosEstimados(mc);
+	fprintf(saida, "# instrucoes penalidade_falta ciclos_estimados cpi\n%llu %u %llu %.3f\n",
+			(unsigned long long)mc->instrucoes.acessos, mc->penalidade, (unsigned long long)ciclos,
+			mc->instrucoes.acessos ? (double)ciclos / mc->instrucoes.acessos : 0.0);
+
+	fclose(saida);
+	return 0;
+}
+
+// liga o modelo de pipeline; preditor "estatico", "bimodal[,bits]" ou "gshare[,bits]" (NULL = bimodal,10; bits é o
+// log2 do número de contadores); latências de mul e div em ciclos (0 = 3 e 20)
+int poximAtivarPipeline(Maquina *m, const char *preditor, uint32_t latenciaMul, uint32_t latenciaDiv)
+{
+	char nome[16] = "bimodal";
+	int bits = 10;
+	if (preditor != NULL && sscanf(preditor, "%15[^,],%d", nome, &bits) < 1)
+		nome[0] = '\0';
+
+	int tipo = -1;
+	for (int i = 0; i < (int)(sizeof(nomesPreditores) / sizeof(nomesPreditores[0])); i++)
+	{
+		if (strcmp(nome, nomesPreditores[i]) == 0)
+			tipo = i;
+	}
+	if (tipo < 0 || bits < 1 || bits > 24)
+	{
+		fprintf(stderr, "Preditor inválido: %s (use estatico, bimodal[,bits] ou gshare[,bits]).\n", preditor);
+		return -1;
+	}
+
+	ModeloPipeline *mp = calloc(1, sizeof(ModeloPipeline));
+	if (mp != NULL && tipo != PREDITOR_ESTATICO)
+	{
+		mp->contadores = malloc((size_t)1 << bits);
+		if (mp->contadores == NULL)
+		{
+			free(mp);
+			mp = NULL;
+		}
+		else
+		{
+			memset(mp->contadores, 1, (size_t)1 << bits); // fracamente não tomado
+		}
+	}
+	if (mp == NULL)
+	{
+		fprintf(stderr, "Sem memória para o modelo de pipeline.\n");
+		return -1;
+	}
+	mp->preditor = tipo;
+	mp->bitsTabela = (tipo != PREDITOR_ESTATICO) ? bits : 0;
+	mp->latenciaMul = (latenciaMul != 0) ? latenciaMul : 3;
+	mp->latenciaDiv = (latenciaDiv != 0) ? latenciaDiv : 20;
+
+	if (m->modeloPipeline != NULL)
+		free(m->modeloPipeline->contadores);
+	free(m->modeloPipeline);
+	m->modeloPipeline = mp;
+	return 0;
+}
+
+// as faltas de cache entram como bolhas quando o modelo de caches também está ligado
+static uint64_t bolhasDasCaches(const Maquina *m)
+{
+	return (m->modeloCache != NULL) ? ciclosEstimados(m->modeloCache) - m->modeloCache->instrucoes.acessos : 0;
+}
+
+// ciclos estimados pelos modelos de tempo ligados (pipeline, senão caches), sem o enchimento do pipeline;
+// sem modelo, 1 ciclo por instrução
+static uint64_t ciclosModelados(const Maquina *m)
+{
+	const ModeloPipeline *mp = m->modeloPipeline;
+	if (mp == NULL)
+		return (m->modeloCache != NULL) ? ciclosEstimados(m->modeloCache) : m->instrucoes;
+	uint64_t ciclos = mp->instrucoes + bolhasDasCaches(m);
+	for (int i = 0; i < NUM_BOLHAS; i++)
+		ciclos += mp->bolhas[i];
+	return ciclos;
+}
+
+// zera os contadores dos modelos de tempo; com esvaziar, também as caches, o preditor e o estado do pipeline
+static void zerarModelos(Maquina *m, int esvaziar)
+{
+	ModeloCache *mc = m->modeloCache;
+	if (mc != NULL)
+	{
+		Cache *caches[2] = {&mc->instrucoes, &mc->dados};
+		for (int i = 0; i < 2; i++)
+		{
+			caches[i]->acessos = caches[i]->faltas = caches[i]->escritasDeVolta = 0;
+			if (esvaziar)
+				memset(caches[i]->linhas, 0, (size_t)caches[i]->conjuntos * caches[i]->vias * sizeof(LinhaCache));
+		}
+	}
+	ModeloPipeline *mp = m->modeloPipeline;
+	if (mp != NULL)
+	{
+		mp->instrucoes = mp->desvios = mp->desviosTomados = mp->previsoesErradas = mp->saltos = 0;
+		memset(mp->bolhas, 0, sizeof(mp->bolhas));
+		if (esvaziar)
+		{
+			if (mp->contadores != NULL)
+				memset(mp->contadores, 1, (size_t)1 << mp->bitsTabela);
+			mp->historico = 0;
+			mp->rdLoad = 0;
+			mp->iniciado = 0;
+		}
+	}
+}
+
+// grava ciclos, CPI, bolhas por causa e taxas de acerto do preditor em texto
+int poximGravarPipeline(const Maquina *m, const char *caminho)
+{
+	const ModeloPipeline *mp = m->modeloPipeline;
+	if (mp == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar o relatório do pipeline em %s.\n", caminho);
+		return -1;
+	}
+
+	const uint64_t bolhasCache = bolhasDasCaches(m);
+	const uint64_t ciclos = ciclosModelados(m) + (mp->instrucoes != 0 ? 4 : 0); // + enchimento do pipeline
+
+	fprintf(saida, "# instrucoes ciclos cpi\n%llu %llu %.3f\n", (unsigned long long)mp->instrucoes,
+			(unsigned long long)ciclos, mp->instrucoes ? (double)ciclos / mp->instrucoes : 0.0);
+
+	fputs("# bolhas: causa ciclos fracao_dos_ciclos\n", saida);
+	for (int i = 0; i < NUM_BOLHAS; i++)
+		fprintf(saida, "%s %llu %.4f\n", nomesBolhas[i], (unsigned long long)mp->bolhas[i],
+				ciclos ? (double)mp->bolhas[i] / ciclos : 0.0);
+	if (m->modeloCache != NULL)
+		fprintf(saida, "caches %llu %.4f\n", (unsigned long long)bolhasCache, ciclos ? (double)bolhasCache / ciclos : 0.0);
+
+	fputs("# preditor bits desvios tomados previsoes_erradas taxa_erro saltos latencia_mul latencia_div\n", saida);
+	fprintf(saida, "%s %d %llu %llu %llu %.4f %llu %u %u\n", nomesPreditores[mp->preditor], mp->bitsTabela,
+			(unsigned long long)mp->desvios, (unsigned long long)mp->desviosTomados,
+			(unsigned long long)mp->previsoesErradas, mp->desvios ? (double)mp->previsoesErradas / mp->desvios : 0.0,
+			(unsigned long long)mp->saltos, mp->latenciaMul, mp->latenciaDiv);
+
+	fclose(saida);
+	return 0;
+}
+
+// liga a coleta de vetores de blocos básicos, gravados em caminho a cada "intervalo" instruções
+int poximAtivarVetorBlocos(Maquina *m, uint64_t intervalo, const char *caminho)
+{
+	VetorBlocos *vb = calloc(1, sizeof(VetorBlocos));
+	if (vb == NULL)
+	{
+		fprintf(stderr, "Sem memória para os vetores de blocos básicos.\n");
+		return -1;
+	}
+	vb->saida = fopen(caminho, "w");
+	if (vb->saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar os vetores de blocos básicos em %s.\n", caminho);
+		free(vb);
+		return -1;
+	}
+	vb->intervalo = (intervalo != 0) ? intervalo : 100000;
+	vb->proximo = m->instrucoes + vb->intervalo;
+	poximFinalizarVetorBlocos(m);
+	m->vetorBlocos = vb;
+	return 0;
+}
+
+// grava o intervalo incompleto (se houver) e encerra a coleta
+void poximFinalizarVetorBlocos(Maquina *m)
+{
+	VetorBlocos *vb = m->vetorBlocos;
+	if (vb == NULL)
+		return;
+	if (vb->numTocados > 0)
+		gravarIntervaloBlocos(vb);
+	fclose(vb->saida);
+	free(vb);
+	m->vetorBlocos = NULL;
+}
+
+static void liberarCobertura(Maquina *m)
+{
+	if (m->cobertura != NULL && m->cobertura->donoMapa)
+		free(m->cobertura->mapa);
+	free(m->cobertura);
+	m->cobertura = NULL;
+}
+
+// liga a cobertura de arestas; mapa = NULL aloca um mapa próprio, senão usa o de quem chamou
+// (TAM_MAPA_COBERTURA bytes, que continua sendo de quem chamou)
+int poximAtivarCobertura(Maquina *m, uint8_t *mapa)
+{
+	Cobertura *c = calloc(1, sizeof(Cobertura));
+	if (c != NULL && mapa == NULL)
+	{
+		mapa = calloc(TAM_MAPA_COBERTURA, 1);
+		c->donoMapa = 1;
+	}
+	if (c == NULL || mapa == NULL)
+	{
+		fprintf(stderr, "Sem memória para o mapa de cobertura.\n");
+		free(c);
+		return -1;
+	}
+	c->mapa = mapa;
+	liberarCobertura(m);
+	m->cobertura = c;
+	return 0;
+}
+
+// grava o mapa no formato do afl-showmap: "aresta:contagem" por aresta vista, com a contagem já agrupada nas faixas do
+// AFL (1, 2, 3, 4-7 -> 4, 8-15 -> 8, 16-31 -> 16, 32-127 -> 32, 128+ -> 128)
+int poximGravarCobertura(const Maquina *m, const char *caminho)
+{
+	if (m->cobertura == NULL)
+		return -1;
+	FILE *saida = fopen(caminho, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar a cobertura em %s.\n", caminho);
+		return -1;
+	}
+	const uint8_t *mapa = m->cobertura->mapa;
+	for (uint32_t i = 0; i < TAM_MAPA_COBERTURA; i++)
+	{
+		const uint8_t n = mapa[i];
+		if (n == 0)
+			continue;
+		const int faixa = (n <= 3) ? n : (n <= 7) ? 4 : (n <= 15) ? 8 : (n <= 31) ? 16 : (n <= 127) ? 32 : 128;
+		fprintf(saida, "%06u:%d\n", i, faixa);
+	}
+	fclose(saida);
+	return 0;
+}
+
+// avanço rápido: roda sem formatar o trace até o gatilho e daí em diante grava em m->saida o mesmo trace de uma
+// execução rastreada desde o começo
+int poximAvancarAte(Maquina *m, TipoGatilho tipo, uint64_t valor)
+{
+	Gatilho *g = calloc(1, sizeof(Gatilho));
+	if (g == NULL)
+	{
+		fprintf(stderr, "Sem memória para o gatilho.\n");
+		return -1;
+	}
+	g->tipo = tipo;
+	g->valor = valor;
+	g->trace = (m->saida == NULL && m->gatilho != NULL) ? m->gatilho->trace : m->saida; // rearmar mantém o trace
+	free(m->gatilho);
+	m->gatilho = g;
+	m->saida = NULL;
+	return 0;
+}
+
+// harness de fuzzing em processo: o estado inicial fica em memória e cada entrada parte dele, com a entrada como RX
+// da UART, sem trace e com a cobertura de arestas num mapa do harness; entre as execuções só as páginas escritas
+// voltam ao estado inicial
+struct Fuzzer
+{
+	Maquina *m;
+	Snapshot estado;
+	uint8_t memoria[TAM_MEMORIA];
+	uint8_t mapa[TAM_MAPA_COBERTURA];
+	uint64_t orcamento;
+	FILE *saida; // trace e UART da máquina antes do harness, devolvidos em poximDestruirFuzzer
+	FILE *entradaUART;
+	FILE *saidaUART;
+};
+
+// o estado atual da máquina vira o ponto de partida de toda entrada; orcamento = instruções até ser um travamento
+Fuzzer *poximCriarFuzzer(Maquina *m, uint64_t orcamento)
+{
+	Fuzzer *f = calloc(1, sizeof(Fuzzer));
+	FILE *semSaida = fopen("/dev/null", "w");
+	if (f == NULL || semSaida == NULL || poximAtivarCobertura(m, f->mapa) != 0)
+	{
+		fprintf(stderr, "Não foi possível criar o harness de fuzzing.\n");
+		free(f);
+		if (semSaida != NULL)
+			fclose(semSaida);
+		return NULL;
+	}
+	f->m = m;
+	f->orcamento = orcamento;
+	f->saida = m->saida;
+	f->entradaUART = m->entradaUART;
+	f->saidaUART = m->saidaUART;
+	m->saida = NULL;
+	m->entradaUART = NULL;
+	m->saidaUART = semSaida;
+
+	capturarEstado(m, &f->estado);
+	memcpy(f->memoria, m->mem, TAM_MEMORIA);
+	memset(m->paginasSujas, 0, sizeof(m->paginasSujas));
+
+	// falha = qualquer exceção que não seja ecall (pc fora da RAM é a instruction_fault)
+	m->excecoesParada = 0xFFFF & ~(1u << 11);
+	return f;
+}
+
+// executa uma entrada a partir do estado inicial e devolve FUZZ_OK, FUZZ_FALHA ou FUZZ_TRAVAMENTO
+// (ebreak e a UART vazia, quando o programa volta a esperar entrada, encerram a execução normalmente)
+int poximExecutarFuzz(Fuzzer *f, const uint8_t *entrada, size_t tamanho, ResultadoFuzz *resultado)
+{
+	Maquina *m = f->m;
+	for (uint32_t i = 0; i < TAM_MEMORIA / TAM_PAGINA_SUJA; i++)
+	{
+		if (m->paginasSujas[i / 64] & (1ull << (i % 64)))
+			memcpy(m->mem + i * TAM_PAGINA_SUJA, f->memoria + i * TAM_PAGINA_SUJA, TAM_PAGINA_SUJA);
+	}
+	aplicarEstado(m, &f->estado);
+	m->reservaValida = 0;
+	memset(f->mapa, 0, sizeof(f->mapa));
+
+	m->entradaUART = fmemopen((void *)entrada, tamanho, "r");
+	if (m->entradaUART == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir a entrada do fuzzer.\n");
+		return -1;
+	}
+	const uint64_t inicio = m->instrucoes;
+	int evento;
+	do
+		evento = poximExecutar(m, inicio + f->orcamento - m->instrucoes);
+	while (evento == EVENTO_WFI);
+	fclose(m->entradaUART);
+	m->entradaUART = NULL;
+
+	resultado->evento = evento;
+	resultado->instrucoes = m->instrucoes - inicio;
+	resultado->causa = (evento == EVENTO_EXCECAO) ? m->registradoresCSRs[4] : (evento == EVENTO_CSR_INVALIDO) ? 2 : 0;
+	resultado->pc = (evento == EVENTO_EXCECAO) ? m->registradoresCSRs[3] : m->pc;
+	return (evento == EVENTO_EXCECAO || evento == EVENTO_CSR_INVALIDO) ? FUZZ_FALHA
+		   : (evento == EVENTO_LIMITE)									? FUZZ_TRAVAMENTO
+																		: FUZZ_OK;
+}
+
+// cobertura de arestas da última execução (TAM_MAPA_COBERTURA bytes, formato do AFL)
+const uint8_t *poximCoberturaFuzz(const Fuzzer *f)
+{
+	return f->mapa;
+}
+
+// devolve à máquina o trace e a UART de antes do harness (o estado fica o da última execução)
+void poximDestruirFuzzer(Fuzzer *f)
+{
+	if (f == NULL)
+		return;
+	Maquina *m = f->m;
+	liberarCobertura(m);
+	fclose(m->saidaUART);
+	m->saida = f->saida;
+	m->entradaUART = f->entradaUART;
+	m->saidaUART = f->saidaUART;
+	m->excecoesParada = 0;
+	free(f);
+}
+
+Maquina *poximCriar(void)
+{
+	Maquina *m = aligned_alloc(64, sizeof(Maquina));
+	if (m == NULL)
+		return NULL;
+	memset(m, 0, sizeof(*m));
+
+	// 32 KIB para armazenar dados e instruções
+	// a região é alocada com mmap (alinhada à página) para que segmentos ELF/binários possam ser mapeados direto do arquivo
+	m->mem = mmap(NULL, TAM_MEMORIA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (m->mem == MAP_FAILED)
+	{
+		free(m);
+		return NULL;
+	}
+
+	m->donoMemoria = 1;
+	poximReiniciar(m);
+	return m;
+}
+
+// cria um hart secundário que compartilha a memória (e a imagem carregada) do hart principal
+// o pc inicial é o mesmo do principal; o programa diferencia os harts pelo mhartid
+Maquina *poximCriarHart(Maquina *principal, uint32_t hartid)
+{
+	Maquina *m = aligned_alloc(64, sizeof(Maquina));
+	if (m == NULL)
+		return NULL;
+	memset(m, 0, sizeof(*m));
+	m->mem = principal->mem;
+	m->hartid = hartid;
+	poximReiniciar(m);
+	m->pc = principal->pc;
+	return m;
+}
+
+// volta a máquina ao estado de reset, mantendo a região de memória e os arquivos associados
+void poximReiniciar(Maquina *m)
+{
+	// um novo mapeamento anônimo descarta de uma vez os dados e os trechos mapeados de arquivos ELF/binários
+	// (harts secundários não mexem na memória, que é do hart principal)
+	if (m->donoMemoria)
+		mmap(m->mem, TAM_MEMORIA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+
+	memset(m->registradores, 0, sizeof(m->registradores));
+	memset(m->registradoresCSRs, 0, sizeof(m->registradoresCSRs));
+	m->registradoresCSRs[7] = m->hartid;
+	memset(m->registradoresUART, 0, sizeof(m->registradoresUART));
+	memset(m->paginasSujas, 0, sizeof(m->paginasSujas));
+	m->clint_msip = 0;
+	m->clint_mtime = 0;
+	m->clint_mtimecmp = -1; // sem interrupção de timer até o programa programar mtimecmp
+	m->plic_priority = 0;
+	m->plic_pending = 0;
+	m->plic_enable = 0;
+	m->plic_threshold = 0;
+	m->plic_claim = 0;
+	m->instrucoes = 0;
+	m->pc = OFFSET_MEMORIA;
+	m->reservaValida = 0;
+	memset(m->eventosHpm, 0, sizeof(m->eventosHpm));
+	memset(m->baseContadores, 0, sizeof(m->baseContadores));
+
+	free(m->simbolos);
+	m->simbolos = NULL;
+	m->numSimbolos = 0;
+	liberarPilhaChamadas(m);
+
+	// inicialização de mtvec pra ebreak
+	// tirar no projeto final
+	m->registradoresUART[5] = 0x04;
+}
+
+void poximDestruir(Maquina *m)
+{
+	if (m == NULL)
+		return;
+	if (m->donoMemoria)
+		munmap(m->mem, TAM_MEMORIA);
+	free(m->simbolos);
+	liberarPilhaChamadas(m);
+	free(m->estatisticas);
+	free(m->latencias);
+	if (m->mapaAcessos != NULL)
+		free(m->mapaAcessos->amostras);
+	free(m->mapaAcessos);
+	liberarCaches(m);
+	if (m->modeloPipeline != NULL)
+		free(m->modeloPipeline->contadores);
+	free(m->modeloPipeline);
+	poximFinalizarVetorBlocos(m);
+	free(m->gatilho);
+	liberarCobertura(m);
+	free(m);
+}
+
+uint32_t poximLerRegistrador(const Maquina *m, int indice)
+{
+	return (indice > 0 && indice < 32) ? m->registradores[indice] : 0;
+}
+
+void poximEscreverRegistrador(Maquina *m, int indice, uint32_t valor)
+{
+	if (indice > 0 && indice < 32) // x0 é sempre zero
+		m->registradores[indice] = valor;
+}
+
+// leitura/escrita da memória simulada pelo hospedeiro; retorna -1 se o intervalo sair da RAM
+int poximLerMemoria(const Maquina *m, uint32_t endereco, void *destino, uint32_t tamanho)
+{
+	if (endereco < OFFSET_MEMORIA || (uint64_t)endereco - OFFSET_MEMORIA + tamanho > TAM_MEMORIA)
+		return -1;
+	memcpy(destino, m->mem + (endereco - OFFSET_MEMORIA), tamanho);
+	return 0;
+}
+
+int poximEscreverMemoria(Maquina *m, uint32_t endereco, const void *origem, uint32_t tamanho)
+{
+	if (endereco < OFFSET_MEMORIA || (uint64_t)endereco - OFFSET_MEMORIA + tamanho > TAM_MEMORIA)
+		return -1;
+	memcpy(m->mem + (endereco - OFFSET_MEMORIA), origem, tamanho);
+	for (uint32_t i = 0; i < tamanho; i += TAM_PAGINA_SUJA)
+		marcarPaginaSuja(m->paginasSujas, endereco - OFFSET_MEMORIA + i);
+	if (tamanho != 0)
+		marcarPaginaSuja(m->paginasSujas, endereco - OFFSET_MEMORIA + tamanho - 1);
+	return 0;
+}
+
+// no SMP cada hart tem o seu msip (0x02000000 + 4 * hart) e o seu mtimecmp (0x02004000 + 8 * hart)
+// devolve o hart dono do registrador e troca *addr pelo endereço equivalente do hart 0
+static Maquina *hartDoClint(Maquina *m, uint32_t *addr)
+{
+	if (m->numHarts <= 1)
+		return m;
+	if (*addr >= 0x02000000 && *addr - 0x02000000 < 4u * m->numHarts)
+	{
+		Maquina *hart = m->harts[(*addr - 0x02000000) / 4];
+		*addr = 0x02000000 + (*addr & 3);
+		return hart;
+	}
+	if (*addr >= 0x02004000 && *addr - 0x02004000 < 8u * m->numHarts)
+	{
+		Maquina *hart = m->harts[(*addr - 0x02004000) / 8];
+		*addr = 0x02004000 + (*addr & 7);
+		return hart;
+	}
+	return m;
+}
+
+// a UART é uma só para todos os harts: entrada e saída passam por uma trava quando há mais de um
+static inline void travarUART(Maquina *m)
+{
+	if (m->travaUART != NULL)
+		pthread_mutex_lock(m->travaUART);
+}
+
+static inline void destravarUART(Maquina *m)
+{
+	if (m->travaUART != NULL)
+		pthread_mutex_unlock(m->travaUART);
+}
+
+// laço principal de execução do simulador
+// roda até maxInstrucoes instruções ou até um evento (ebreak, CSR não suportado)
+int poximExecutar(Maquina *m, uint64_t maxInstrucoes)
+{
+	// cópias locais do que é usado em toda instrução (o compilador pode mantê-las em registradores)
+	const uint32_t offset = OFFSET_MEMORIA;
+	uint8_t *const mem = m->mem;
+	uint32_t *const registradores = m->registradores;
+	uint32_t *const registradoresCSRs = m->registradoresCSRs;
+	uint32_t *const registradoresUART = m->registradoresUART;
+	FILE *output = m->saida; // muda quando o gatilho do avanço rápido dispara
+	FILE *const input2 = m->entradaUART;
+	FILE *const output2 = m->saidaUART;
+	Estatisticas *estatisticas = m->estatisticas;
+	MapaAcessos *const mapaAcessos = m->mapaAcessos;
+	ModeloCache *modeloCache = m->modeloCache;
+	ModeloPipeline *const modeloPipeline = m->modeloPipeline;
+	VetorBlocos *const vetorBlocos = m->vetorBlocos;
+	const Gatilho *gatilho = m->gatilho;
+	uint8_t *const cobertura = (m->cobertura != NULL) ? m->cobertura->mapa : NULL;
+	uint32_t pc = m->pc;
+	uint64_t instrucoes = m->instrucoes;
+	const uint64_t fim = (maxInstrucoes > UINT64_MAX - instrucoes) ? UINT64_MAX : instrucoes + maxInstrucoes;
+	int decodificar = estatisticas != NULL || mapaAcessos != NULL || modeloCache != NULL || modeloPipeline != NULL;
+	EfeitoInstrucao efeito = {.desvio = -1}; // sem acesso até a primeira decodificação
+	uint32_t pcCsrInvalido = 0;
+
+	int evento = EVENTO_NENHUM;
+	while (evento == EVENTO_NENHUM)
+	{
+		// orçamento de instruções esgotado
+		if (instrucoes >= fim)
+		{
+			evento = EVENTO_LIMITE;
+			break;
+		}
+
+		// Tratamento da exceção 1 — Instruction Access Fault. Quando pc está fora da memória válida
+		if (pc < offset || pc >= offset + TAM_MEMORIA)
+		{
+			prepMstatus(&registradoresCSRs[0]);							 // preparar mstatus para a excessão
+			evento = registrarExcecao(m, instrucoes, 1, pc, pc, &pc); // Instruction access fault
+			continue;
+		}
+
+		// converte mem para um tipo de 4 bytes, acessa a posição correta da instrução dividindo por 4 para acessar apenas 1  instrução inteira  por indice
+		// uint32_t instrucao = ((uint32_t*)mem)[(pc - offset)>>2];
+		uint32_t instrucao = ((uint32_t *)(mem))[(pc - offset) >> 2];
+		if (gatilho != NULL && verificarGatilho(gatilho, pc, instrucao, registradores, instrucoes))
+		{
+			output = dispararGatilho(m);
+			gatilho = NULL;
+		}
+		instrucoes++;
+		if (decodificar)
+			decodificarEfeito(pc, instrucao, registradores, &efeito);
+		if (estatisticas != NULL)
+			contarInstrucao(estatisticas, instrucao, &efeito);
+		if (mapaAcessos != NULL)
+			avancarJanelaAcessos(mapaAcessos, instrucoes);
+		if (modeloCache != NULL)
+			acessarCache(&modeloCache->instrucoes, pc, 0); // a busca acontece mesmo se a instrução gerar exceção
+		if (modeloPipeline != NULL)
+			simularPipeline(modeloPipeline, pc, instrucao, &efeito);
+		if (vetorBlocos != NULL)
+			contarBlocoBasico(vetorBlocos, pc, instrucao, instrucoes);
+
+		// if (pc < offset || pc >= offset + TAM_MEMORIA)
+		//{
+		//	printf("PC fora do intervalo da memória: 0x%08x\n", pc);
+		//	run = 0;
+		//	break; // ou run = 0;
+		// }
+
+		// agora cada indice de mem pega 4 bytes que é uma instrução inteira
+		// caso não funcione trocara /4 por >>2
+		// obtenfdo o opcode para manter os 7 bits menos significativos (da direita) da instrução, e ignorar o resto
+		const uint32_t opcode = instrucao & 0b1111111; // o & vai filtrar o bits que queremos pois ele só repete 1 se for exatamente igual então armazena exatamente o mesmo numero no mesmo lugar
+		// inicializando os campos que tem que usar para identificar as instruções
+		// o >> desloca a quantidade de bits necessaria
+		const uint8_t funct7 = instrucao >> 25;			  // complemento, usado em operações
+		const int32_t imm_i = ((int32_t)instrucao) >> 20; // valor imediato com sinal (Tipo I)
+		// const uint8_t uimm = (instrucao >> 20) & 0b11111; // valor imediato sem sinal (shift, Tipo I)
+		const uint8_t rs1 = (instrucao >> 15) & 0b11111;  // registrador de origem 1
+		const uint8_t rs2 = (instrucao >> 20) & 0b11111;  // registrador de origem 2
+		const uint8_t funct3 = (instrucao >> 12) & 0b111; // diferencia instruções com o mesmo opcode
+		const uint8_t rd = (instrucao >> 7) & 0b11111;	  // registrador onde armazena o resultado
+														  // const int32_t imm_s = ((instrucao >> 25) << 5) | ((instrucao >> 7) & 0b11111); // imediato do tipo S (armazenamento)
+		int32_t imm_b = ((instrucao >> 31) & 0x1) << 12 |
+						((instrucao >> 7) & 0x1) << 11 |
+						((instrucao >> 25) & 0x3F) << 5 |
+						((instrucao >> 8) & 0xF) << 1;
+
+		if (imm_b & 0x1000)
+			imm_b |= 0xFFFFE000;
+
+		int32_t imm_j = 0;
+		imm_j |= ((instrucao >> 31) & 0x1) << 20;
+		imm_j |= ((instrucao >> 21) & 0x3FF) << 1;
+		imm_j |= ((instrucao >> 20) & 0x1) << 11;
+		imm_j |= ((instrucao >> 12) & 0xFF) << 12;
+		if (imm_j & (1 << 20))
+			imm_j |= 0xFFF00000; // imediato do tipo J (jump)
+
+		const int32_t imm_u = instrucao & 0xFFFFF000;	   // imediato do tipo U (lui/auipc)
+		const uint8_t shamt = (instrucao >> 20) & 0b11111; // extrai 5 bits
+
+		int32_t imm_s = (((instrucao >> 25) & 0x7F) << 5) | ((instrucao >> 7) & 0x1F);
+		if (imm_s & 0x800)
+			imm_s |= 0xFFFFF000;
+
+		// instruções tipo R
+		switch (opcode)
+		{
+			// tipo R-type
+		case 0b0110011:
+			// add (soma)
+			if (funct3 == 0b000 && funct7 == 0b0000000)
+			{
+				const uint32_t resultado = registradores[rs1] + registradores[rs2];
+				TRACE(output, "0x%08x:add %s,%s,%s %s=0x%08x+0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						registradores[rs2], // Valor de rs2
+						resultado);
+
+				// Atualizando o registrador de destino, se não for registradores[0]
+				if (rd != 0)
+				{ // Ela atualiza o registrador destino rd com o valor do cálculo (data), mas só se o registrador rd não for o registrador x0.
+					registradores[rd] = resultado;
+				}
+			}
+			// sub (subtração)
+			else if (funct7 == 0b0100000 && funct3 == 0b000)
+			{
+				const uint32_t resultado = registradores[rs1] - registradores[rs2];
+				TRACE(output, "0x%08x:sub %s,%s,%s %s=0x%08x-0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						registradores[rs2], // Valor de rs2
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// sll (desloca o conteúdo de rs1 logicamente para a esquerda)
+			else if (funct3 == 0b001 && funct7 == 0b0000000)
+			{
+				const uint8_t deslocar = registradores[rs2] & 0b11111;	   // filtra os 5 bits menos significativos
+				const uint32_t resultado = registradores[rs1] << deslocar; // desloca os 5 bits a esquerda
+
+				TRACE(output, "0x%08x:sll %s,%s,%s %s=0x%08x<<u5=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
 
 			// slt (Define o registrador rd como 1 se o valor em rs1 for menor que o valor em rs2 na comparação com sinal)
 			else if (funct3 == 0b010 && funct7 == 0b0000000)
@@ -318,7 +4745,7 @@ int main(int argc, char *argv[])
 				int32_t sinal_rs2 = (int32_t)registradores[rs2];
 				const uint32_t resultado = (sinal_rs1 < sinal_rs2) ? 1 : 0; // Define o registrador rd como 1 se o valor em rs1 for menor que o valor em rs2
 
-				fprintf(output, "0x%08x:slt %s,%s,%s %s=(0x%08x<0x%08x)=0x%08x\n",
+				TRACE(output, "0x%08x:slt %s,%s,%s %s=(0x%08x<0x%08x)=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -339,7 +4766,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = (registradores[rs1] < registradores[rs2]) ? 1 : 0; // Define o registrador rd como 1 se o valor em rs1 for menor que o valor em rs2
 
-				fprintf(output, "0x%08x:sltu %s,%s,%s %s=(0x%08x<0x%08x)=0x%08x\n",
+				TRACE(output, "0x%08x:sltu %s,%s,%s %s=(0x%08x<0x%08x)=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -360,7 +4787,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = registradores[rs1] ^ registradores[rs2];
 
-				fprintf(output, "0x%08x:xor %s,%s,%s %s=0x%08x^0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:xor %s,%s,%s %s=0x%08x^0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -381,7 +4808,7 @@ int main(int argc, char *argv[])
 				const uint8_t deslocar = registradores[rs2] & 0b11111;	   // filtra os 5 bits menos significativos
 				const uint32_t resultado = registradores[rs1] >> deslocar; // desloca os 5 bits a direita
 
-				fprintf(output, "0x%08x:srl %s,%s,%s %s=0x%08x>>u5=0x%08x\n",
+				TRACE(output, "0x%08x:srl %s,%s,%s %s=0x%08x>>u5=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -403,7 +4830,7 @@ int main(int argc, char *argv[])
 				const int32_t Sinal_rs1 = (int32_t)registradores[rs1];
 				const uint32_t resultado = (uint32_t)(Sinal_rs1 >> deslocar);
 
-				fprintf(output, "0x%08x:sra %s,%s,%s %s=0x%08x>>>u5=0x%08x\n",
+				TRACE(output, "0x%08x:sra %s,%s,%s %s=0x%08x>>>u5=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -423,7 +4850,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = registradores[rs1] | registradores[rs2];
 
-				fprintf(output, "0x%08x:or %s,%s,%s %s=0x%08x|0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:or %s,%s,%s %s=0x%08x|0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -444,7 +4871,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = registradores[rs1] & registradores[rs2];
 
-				fprintf(output, "0x%08x:and %s,%s,%s %s=0x%08x&0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:and %s,%s,%s %s=0x%08x&0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -465,7 +4892,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = registradores[rs1] * registradores[rs2];
 
-				fprintf(output, "0x%08x:mul %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:mul %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -489,7 +4916,7 @@ int main(int argc, char *argv[])
 				int64_t produto = rs1_64 * rs2_64;
 				const uint32_t resultado = (uint32_t)(produto >> 32); // sem sinal
 
-				fprintf(output, "0x%08x:mulh %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:mulh %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -513,7 +4940,7 @@ int main(int argc, char *argv[])
 				int64_t produto = rs1_64 * rs2_64;					   // resultado 64 bits
 				const uint32_t resultado = (uint32_t)(produto >> 32);  // parte alta
 
-				fprintf(output, "0x%08x:mulhsu %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:mulhsu %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
 						pc,					// endereço da instrução
 						regNomes[rd],		// nome do registrador de destino
 						regNomes[rs1],		// nome do registrador rs1
@@ -537,7 +4964,7 @@ int main(int argc, char *argv[])
 				uint64_t produto = rs1_64 * rs2_64;
 				const uint32_t resultado = (uint32_t)(produto >> 32);
 
-				fprintf(output, "0x%08x:mulhu %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:mulhu %s,%s,%s %s=0x%08x*0x%08x=0x%08x\n",
 						pc,					// endereço da instrução
 						regNomes[rd],		// nome do registrador de destino
 						regNomes[rs1],		// nome do registrador rs1
@@ -562,7 +4989,7 @@ int main(int argc, char *argv[])
 				const uint32_t resultado = (rs2_32 == 0) ? 0xFFFFFFFF : (rs1_32 == INT32_MIN && rs2_32 == -1) ? (uint32_t)INT32_MIN
 																											  : (uint32_t)(rs1_32 / rs2_32);
 
-				fprintf(output, "0x%08x:div %s,%s,%s %s=0x%08x/0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:div %s,%s,%s %s=0x%08x/0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -583,7 +5010,7 @@ int main(int argc, char *argv[])
 			{
 				const uint32_t resultado = (registradores[rs2] == 0) ? 0xFFFFFFFF : registradores[rs1] / registradores[rs2];
 
-				fprintf(output, "0x%08x:divu %s,%s,%s %s=0x%08x/0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:divu %s,%s,%s %s=0x%08x/0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -607,7 +5034,7 @@ int main(int argc, char *argv[])
 				const uint32_t resultado = (rs2_32 == 0) ? rs1_32 : (rs1_32 == INT32_MIN && rs2_32 == -1) ? 0
 																										  : (uint32_t)(rs1_32 % rs2_32);
 
-				fprintf(output, "0x%08x:rem %s,%s,%s %s=0x%08x%%0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:rem %s,%s,%s %s=0x%08x%%0x%08x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
@@ -626,16 +5053,219 @@ int main(int argc, char *argv[])
 			// remu(Calcula o resto da divisão inteira sem sinal entre rs1 e rs2)
 			else if (funct3 == 0b111 && funct7 == 0b0000001)
 			{
-				const uint32_t resultado = (registradores[rs2] == 0) ? registradores[rs1] : registradores[rs1] % registradores[rs2];
+				const uint32_t resultado = (registradores[rs2] == 0) ? registradores[rs1] : registradores[rs1] % registradores[rs2];
+
+				TRACE(output, "0x%08x:remu %s,%s,%s %s=0x%08x%%0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						registradores[rs2], // Valor de rs2
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
+			else
+			{
+				// preparando mstatus para a excessão
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
+				continue;
+			}
+
+			break; // acabou as verificações desse caso
+
+			// tipo I-type
+		case 0b0010011:
+			// addi (soma rs1 com valor imediato e armazena em rd)
+			if (funct3 == 0b000)
+			{
+				const uint32_t resultado = registradores[rs1] + imm_i;
+
+				TRACE(output, "0x%08x:addi %s,%s,0x%03x %s=0x%08x+0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// andi (faz uma operação lógica AND bit a bit entre um registrador e um valor imediato)
+			else if (funct3 == 0b111)
+			{
+				const uint32_t resultado = registradores[rs1] & imm_i;
+
+				TRACE(output, "0x%08x:andi %s,%s,0x%03x %s=0x%08x&0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// ori(Faz um OR bit a bit entre rs1 e um valor imediato (12 bits), armazenando em rd)
+			else if (funct3 == 0b110)
+			{
+				const uint32_t resultado = registradores[rs1] | imm_i;
+
+				TRACE(output, "0x%08x:ori %s,%s,0x%03x %s=0x%08x|0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// xori(Faz um XOR bit a bit entre rs1 e um valor imediato (12 bits), armazenando em rd)
+			else if (funct3 == 0b100)
+			{
+				const uint32_t resultado = registradores[rs1] ^ imm_i;
+
+				TRACE(output, "0x%08x:xori %s,%s,0x%03x %s=0x%08x^0x%08x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// slti (Se rs1 for menor que o valor imediato (com sinal), rd=1, senão rd=0)
+			else if (funct3 == 0b010)
+			{
+				const int32_t sinal_rs1 = (int32_t)registradores[rs1]; // Valor de rs1 com sinal
+				const uint32_t resultado = (sinal_rs1 < imm_i) ? 1 : 0;
+
+				TRACE(output, "0x%08x:slti %s,%s,0x%03x %s=(0x%08x<0x%08x)=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// sltiu (Se rs1 for menor que o valor imediato (sem sinal), rd=1, senão rd=0)
+			else if (funct3 == 0b011)
+			{
+				const uint32_t resultado = (registradores[rs1] < imm_i) ? 1 : 0;
+
+				TRACE(output, "0x%08x:sltiu %s,%s,0x%03x %s=(0x%08x<0x%08x)=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						imm_i,				// imediato do tipo i
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// slli (Desloca o valor em rs1 para a esquerda, preenchendo os bits vazios com zeros)
+			else if (funct3 == 0b001 && funct7 == 0b0000000)
+			{
+				const uint32_t resultado = registradores[rs1] << shamt;
+
+				TRACE(output, "0x%08x:slli %s,%s,0x%02x %s=0x%08x<<0x%02x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						shamt,				// extrai 5 bits
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						shamt,				// extrai 5 bits
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// srli (Desloca o valor em rs1 para a direita, preenchendo os bits vazios com zeros)
+			else if (funct3 == 0b101 && funct7 == 0b0000000)
+			{
+				const uint32_t resultado = registradores[rs1] >> shamt;
+
+				TRACE(output, "0x%08x:srli %s,%s,0x%02x %s=0x%08x>>0x%02x=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// Nome do registrador rs1
+						shamt,				// extrai 5 bits
+						regNomes[rd],		// Nome de novo para mostrar atribuição
+						registradores[rs1], // Valor de rs1
+						shamt,				// extrai 5 bits
+						resultado);
+
+				if (rd != 0)
+				{
+					registradores[rd] = resultado;
+				}
+			}
+
+			// srai (Desloca o valor em rs1 para a direita, mantendo o bit de sinal (preenche com 0 se positivo, 1 se negativo)
+			else if (funct3 == 0b101 && funct7 == 0b0100000)
+			{
+				const int32_t sinal_rs1 = (int32_t)registradores[rs1]; // Converte para inteiro com sinal
+				const uint32_t resultado = sinal_rs1 >> shamt;
 
-				fprintf(output, "0x%08x:remu %s,%s,%s %s=0x%08x%%0x%08x=0x%08x\n",
+				TRACE(output, "0x%08x:srai %s,%s,0x%02x %s=0x%08x>>>0x%02x=0x%08x\n",
 						pc,					// Endereço da instrução
 						regNomes[rd],		// Nome do registrador destino
 						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
+						shamt,				// extrai 5 bits
 						regNomes[rd],		// Nome de novo para mostrar atribuição
 						registradores[rs1], // Valor de rs1
-						registradores[rs2], // Valor de rs2
+						shamt,				// extrai 5 bits
 						resultado);
 
 				if (rd != 0)
@@ -648,1346 +5278,2634 @@ int main(int argc, char *argv[])
 			{
 				// preparando mstatus para a excessão
 				prepMstatus(&registradoresCSRs[0]);
-				registrarExcecao(2, pc, instrucao, registradoresCSRs, output, &pc);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
 				continue;
 			}
 
-			break; // acabou as verificações desse caso
+			break;
 
-			// tipo I-type
-		case 0b0010011:
-			// addi (soma rs1 com valor imediato e armazena em rd)
-			if (funct3 == 0b000)
-			{
-				const uint32_t resultado = registradores[rs1] + imm_i;
+		// tipo Load Byte
+		case 0b0000011:
+			uint32_t valor_lido = 0;
+			uint32_t addr = registradores[rs1] + imm_i;
 
-				fprintf(output, "0x%08x:addi %s,%s,0x%03x %s=0x%08x+0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
-						resultado);
+			// Acesso à memória do CLINT
+			if (addr >= 0x02000000 && addr <= 0x0200BFFC)
+			{
+				uint32_t registradorClint = addr;
+				Maquina *hartClint = hartDoClint(m, &registradorClint);
+				switch (registradorClint)
+				{
+				 // MSIP (Software interrupt pending)
+				case 0x02000000:
+					valor_lido = __atomic_load_n(&hartClint->clint_msip, __ATOMIC_RELAXED);
+					break;
+					// MTIMECMP (parte baixa)
+				case 0x02004000:
+					valor_lido = (uint32_t)(__atomic_load_n(&hartClint->clint_mtimecmp, __ATOMIC_RELAXED) & 0xFFFFFFFF);
+					break;
+					// MTIMECMP (parte alta)
+				case 0x02004004:
+					valor_lido = (uint32_t)(__atomic_load_n(&hartClint->clint_mtimecmp, __ATOMIC_RELAXED) >> 32);
+					break;
+					// MTIME (parte baixa dos 64 bits)
+				case 0x0200BFF8:
+					valor_lido = (uint32_t)(m->clint_mtime & 0xFFFFFFFF);
+					break;
+					// MTIME (parte alta)
+				case 0x0200BFFC:
+					valor_lido = (uint32_t)(m->clint_mtime >> 32);
+					break;
+				default:
+					// Endereço não mapeado no intervalo CLINT
+					valor_lido = 0;
+					break;
+				}
 
 				if (rd != 0)
 				{
-					registradores[rd] = resultado;
+					registradores[rd] = valor_lido;
 				}
+
+				TRACE(output, "0x%08x:lw     %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+						pc,                               //endereço da instrução
+						regNomes[rd],                     //nome do registrador destino
+						imm_i & 0xFFF,                    //imediato do tipo i
+						regNomes[rs1],                    //nome do registrador rs1
+						regNomes[rd],                     //nome do registrador destino
+						addr,                             //endereço da memoria acessada
+						registradores[rd]);                //valor do registrador destino
 			}
 
-			// andi (faz uma operação lógica AND bit a bit entre um registrador e um valor imediato)
-			else if (funct3 == 0b111)
+			// PLIC
+			// Acesso aos registradores do PLIC (endereços mapeados)
+			switch (addr)
 			{
-				const uint32_t resultado = registradores[rs1] & imm_i;
-
-				fprintf(output, "0x%08x:andi %s,%s,0x%03x %s=0x%08x&0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
-						resultado);
+				// PRIORITY (prioridade de uma interrupção)
+			case 0x0C000028:
+				valor_lido = m->plic_priority;
+				break;
+				// PENDING (quais interrupções estão pendentes)
+			case 0x0C001000:
+				valor_lido = m->plic_pending;
+				break;
+				// ENABLE (quais interrupções estão habilitadas para gerar exceções)
+			case 0x0C002000:
+				valor_lido = m->plic_enable;
+				break;
+				//CLAIM (usado pelo processador para "reclamar" a interrupção atual)
+			case 0x0C200004:
+				if ((m->plic_pending & (1 << 10)) && (m->plic_enable & (1 << 10)))
+				{
+					valor_lido = 10; // ID da UART
+				}
+				else
+				{
+					valor_lido = 0; // Nenhuma interrupção pendente
+				}
+				break;
+				// THRESHOLD (limite mínimo de prioridade)
+			case 0x0C200000:
+				valor_lido = m->plic_threshold;
+				break;
+			default:
+				// Endereço não mapeado para PLIC
+				valor_lido = 0;
+				break;
+			}
 
+			if (valor_lido != 0 || (addr >= 0x0C000000 && addr <= 0x0C20FFFF)) // condição para controle, opcional
+			{
 				if (rd != 0)
+					registradores[rd] = valor_lido;
+
+				TRACE(output, "0x%08x:lw     %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+						pc,                       // Endereço da instrução
+						regNomes[rd],             // Nome do registrador destino
+						imm_i & 0xFFF,            //imediato do tipo i
+						regNomes[rs1],            //Nome do registrador rs1
+						regNomes[rd],             //Nome do registrador destino
+						addr,                     //endereço da memoria acessada
+						registradores[rd]);        //valor do registrador destino
+
+				break;
+			}
+
+			// ACESSO À UART E PLIC
+			if (addr >= 0x10000000 && addr <= 0x10000007)
+			{
+				if (addr == 0x10000000)
 				{
-					registradores[rd] = resultado;
+					// UART RHR: lê caractere do terminal UART de entrada
+					travarUART(m);
+					int c = fgetc(input2);
+					destravarUART(m);
+					if (c == EOF)
+					{
+						registradoresUART[0] = 0; // nada disponível, retorna 0
+					}
+					else
+					{
+						registradoresUART[0] = (uint8_t)c;
+					}
+					valor_lido = (uint32_t)(int32_t)((int8_t)registradoresUART[0]);
+
+					if (rd != 0)
+						registradores[rd] = valor_lido;
+
+					TRACE(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+							pc,                                        // Endereço da instrução
+							funct3 == 0b000 ? "lb    " : "lbu   ",     //condição para saber qual instrução
+							regNomes[rd],                              // Nome do registrador destino
+							imm_i & 0xFFF,                             //imediato do tipo i 
+							regNomes[rs1],                             // Nome do registrador rs1
+							regNomes[rd],                              // Nome do registrador destino
+							addr,                                      // enderço da memoria acessada
+							registradores[rd]);                        //valor do registrador destino
+
+					break;
+				}
+				else if (addr == 0x10000002)
+				{
+					// Retorna o status do UART (Line Status Register)
+					// Bit 2 = 1 significa "dado disponível" segundo o assembly
+					valor_lido = registradoresUART[5]; // por exemplo, 0x04 se dado disponível
+
+					if (rd != 0)
+						registradores[rd] = (funct3 == 0b000) ? (int8_t)valor_lido : (uint8_t)valor_lido;
+
+					TRACE(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+							pc,                                       // Endereço da instrução
+							funct3 == 0b000 ? "lb    " : "lbu   ",   //condição para saber qual instrução
+							regNomes[rd],                            // Nome do registrador destino
+							imm_i & 0xFFF,                           //imediato do tipo i 
+							regNomes[rs1],                           // Nome do registrador rs1
+							regNomes[rd],                            // Nome do registrador destino
+							addr,                                    // enderço da memoria acessada
+							registradores[rd]);                      //valor do registrador destino
+
+					break;
+				}
+
+				else if (addr == 0x10000005)
+				{
+					// UART LSR: indica se há dado disponível (bit 0 = 1 se sim)
+					// (a espiada fgetc/ungetc fica inteira sob a trava para outro hart não consumir o caractere no meio)
+					travarUART(m);
+					int c = fgetc(input2); // tenta ler um caractere
+					if (c == EOF)
+					{
+						registradoresUART[5] = 0x60; // bit 0 = 0 → nada disponível
+						evento = EVENTO_UART_VAZIA;	 // o programa está esperando entrada: devolve o controle depois desta instrução
+					}
+					else
+					{
+						ungetc(c, input2);			 // devolve o caractere
+						registradoresUART[5] = 0x61; // bit 0 = 1 → dado disponível
+
+						// Aqui você pode ativar a interrupção no PLIC (fonte 1: UART)
+					}
+					destravarUART(m);
+					valor_lido = registradoresUART[5];
+
+					if (rd != 0)
+						registradores[rd] = valor_lido;
+
+					TRACE(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+							pc,                                       // Endereço da instrução
+							funct3 == 0b000 ? "lb    " : "lbu   ",    //condição para saber qual instrução
+							regNomes[rd],                             // Nome do registrador destino
+							imm_i & 0xFFF,                            //imediato do tipo i
+							regNomes[rs1],                            // Nome do registrador rs1
+							regNomes[rd],                             // Nome do registrador destino
+							addr,                                     // enderço da memoria acessada
+							registradores[rd]);                       //valor do registrador destino
+
+					break;
 				}
 			}
 
-			// ori(Faz um OR bit a bit entre rs1 e um valor imediato (12 bits), armazenando em rd)
-			else if (funct3 == 0b110)
+			// lb (Carrega um byte da memória no endereço rs1 + offset, extende para 32 bits com sinal e armazena em rd)
+			if (funct3 == 0b000)
 			{
-				const uint32_t resultado = registradores[rs1] | imm_i;
+				const uint32_t endereco = registradores[rs1] + imm_i;
+				uint32_t resultado = 0;
 
-				fprintf(output, "0x%08x:ori %s,%s,0x%03x %s=0x%08x|0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
+				// Tratamento da exceção 5 — Load Access Fault
+				if (endereco < offset || endereco >= offset + TAM_MEMORIA)
+				{
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 5, pc, endereco, &pc);
+					continue;
+				}
+
+				const int8_t byte = (int8_t)mem[endereco - offset];
+				resultado = (uint32_t)(int32_t)byte;
+
+				TRACE(output, "0x%08x:lb %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
+						pc,                              // Endereço da instrução
+						regNomes[rd],                    // Nome do registrador destino
+						imm_i & 0xFFF,                   //imediato do tipo i
+						regNomes[rs1],                   // Nome do registrador rs1
+						regNomes[rd],                    // Nome do registrador destino
+						endereco,
 						resultado);
 
 				if (rd != 0)
-				{
 					registradores[rd] = resultado;
-				}
 			}
 
-			// xori(Faz um XOR bit a bit entre rs1 e um valor imediato (12 bits), armazenando em rd)
-			else if (funct3 == 0b100)
+			// lh (Carrega halfword de 16 bits com extensão de sinal)
+			else if (funct3 == 0b001)
 			{
-				const uint32_t resultado = registradores[rs1] ^ imm_i;
+				const uint32_t endereco = registradores[rs1] + imm_i;
 
-				fprintf(output, "0x%08x:xori %s,%s,0x%03x %s=0x%08x^0x%08x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
+				if (endereco < offset || endereco >= offset + TAM_MEMORIA)
+				{
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 5, pc, endereco, &pc);
+					continue;
+				}
+
+				int16_t halfword = (int16_t)(mem[endereco - offset] | (mem[endereco + 1 - offset] << 8));
+				uint32_t resultado = (uint32_t)(int32_t)halfword;
+
+				TRACE(output, "0x%08x:lh %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
+						pc,                            // Endereço da instrução
+						regNomes[rd],                  // Nome do registrador destino 
+						imm_i & 0xFFF,                 //imediato do tipo i
+						regNomes[rs1],                 // Nome do registrador rs1
+						regNomes[rd],                  // Nome do registrador destino
+						endereco,
 						resultado);
 
 				if (rd != 0)
-				{
 					registradores[rd] = resultado;
-				}
 			}
 
-			// slti (Se rs1 for menor que o valor imediato (com sinal), rd=1, senão rd=0)
+			// lw (Carrega uma word (32 bits) da memória no endereço rs1 + offset e armazena em rd)
 			else if (funct3 == 0b010)
 			{
-				const int32_t sinal_rs1 = (int32_t)registradores[rs1]; // Valor de rs1 com sinal
-				const uint32_t resultado = (sinal_rs1 < imm_i) ? 1 : 0;
-
-				fprintf(output, "0x%08x:slti %s,%s,0x%03x %s=(0x%08x<0x%08x)=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
-						resultado);
+				const uint32_t endereco = registradores[rs1] + imm_i;
 
-				if (rd != 0)
+				if (endereco < offset || endereco + 3 >= offset + TAM_MEMORIA)
 				{
-					registradores[rd] = resultado;
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 5, pc, endereco, &pc);
+					continue;
 				}
-			}
 
-			// sltiu (Se rs1 for menor que o valor imediato (sem sinal), rd=1, senão rd=0)
-			else if (funct3 == 0b011)
-			{
-				const uint32_t resultado = (registradores[rs1] < imm_i) ? 1 : 0;
+				uint32_t resultado = mem[endereco - offset] |
+									 (mem[endereco + 1 - offset] << 8) |
+									 (mem[endereco + 2 - offset] << 16) |
+									 (mem[endereco + 3 - offset] << 24);
 
-				fprintf(output, "0x%08x:sltiu %s,%s,0x%03x %s=(0x%08x<0x%08x)=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						imm_i,				// imediato do tipo i
+				TRACE(output, "0x%08x:lw %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
+						pc,                          // Endereço da instrução
+						regNomes[rd],                // Nome do registrador destino 
+						imm_i & 0xFFF,               // imediato do tipo i
+						regNomes[rs1],               //nome do registrador rs1
+						endereco,
 						resultado);
 
 				if (rd != 0)
-				{
 					registradores[rd] = resultado;
-				}
 			}
 
-			// slli (Desloca o valor em rs1 para a esquerda, preenchendo os bits vazios com zeros)
-			else if (funct3 == 0b001 && funct7 == 0b0000000)
+			// lbu (Carrega byte com zero-extend)
+			else if (funct3 == 0b100)
 			{
-				const uint32_t resultado = registradores[rs1] << shamt;
-
-				fprintf(output, "0x%08x:slli %s,%s,0x%02x %s=0x%08x<<0x%02x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						shamt,				// extrai 5 bits
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						shamt,				// extrai 5 bits
-						resultado);
+				const uint32_t endereco = registradores[rs1] + imm_i;
 
-				if (rd != 0)
+				if (endereco < offset || endereco >= offset + TAM_MEMORIA)
 				{
-					registradores[rd] = resultado;
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 5, pc, endereco, &pc);
+					continue;
 				}
-			}
 
-			// srli (Desloca o valor em rs1 para a direita, preenchendo os bits vazios com zeros)
-			else if (funct3 == 0b101 && funct7 == 0b0000000)
-			{
-				const uint32_t resultado = registradores[rs1] >> shamt;
+				uint32_t resultado = (uint32_t)mem[endereco - offset];
 
-				fprintf(output, "0x%08x:srli %s,%s,0x%02x %s=0x%08x>>0x%02x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						shamt,				// extrai 5 bits
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						shamt,				// extrai 5 bits
+				TRACE(output, "0x%08x:lbu %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
+						pc,                           // Endereço da instrução      
+						regNomes[rd],                 //nome do registrador destino
+						imm_i & 0xFFF,                //imediato do tipo i
+						regNomes[rs1],                //nome do registrador rs1
+						regNomes[rd],                 //nome do registrador destino
+						endereco,
 						resultado);
 
 				if (rd != 0)
-				{
 					registradores[rd] = resultado;
-				}
 			}
 
-			// srai (Desloca o valor em rs1 para a direita, mantendo o bit de sinal (preenche com 0 se positivo, 1 se negativo)
-			else if (funct3 == 0b101 && funct7 == 0b0100000)
+			// lhu (Carrega halfword com zero-extend)
+			else if (funct3 == 0b101)
 			{
-				const int32_t sinal_rs1 = (int32_t)registradores[rs1]; // Converte para inteiro com sinal
-				const uint32_t resultado = sinal_rs1 >> shamt;
+				const uint32_t endereco = registradores[rs1] + imm_i;
 
-				fprintf(output, "0x%08x:srai %s,%s,0x%02x %s=0x%08x>>>0x%02x=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// Nome do registrador rs1
-						shamt,				// extrai 5 bits
-						regNomes[rd],		// Nome de novo para mostrar atribuição
-						registradores[rs1], // Valor de rs1
-						shamt,				// extrai 5 bits
+				if (endereco < offset || endereco >= offset + TAM_MEMORIA)
+				{
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 5, pc, endereco, &pc);
+					continue;
+				}
+
+				uint16_t halfword = mem[endereco - offset] | (mem[endereco + 1 - offset] << 8);
+				uint32_t resultado = (uint32_t)halfword;
+
+				TRACE(output, "0x%08x:lhu %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
+						pc,                            // Endereço da instrução  
+						regNomes[rd],                  //nome do registrador destino
+						imm_i & 0xFFF,                 //imediato do tipo i
+						regNomes[rs1],                 //nome do registrador rs1
+						regNomes[rd],                  //nome do registrador destino
+						endereco,
 						resultado);
 
 				if (rd != 0)
-				{
 					registradores[rd] = resultado;
-				}
 			}
-			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
+
+			// Tratamento da exceção para instrução ilegal
 			else
 			{
-				// preparando mstatus para a excessão
 				prepMstatus(&registradoresCSRs[0]);
-				registrarExcecao(2, pc, instrucao, registradoresCSRs, output, &pc);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
 				continue;
 			}
 
 			break;
+			// tipo Store byte
+		case 0b0100011:
+		{
+			// Instruções de store
+			uint32_t addr = registradores[rs1] + imm_s;
+			uint32_t valor_lido = registradores[rs2];
 
-		// tipo Load Byte
-		case 0b0000011:
-			uint32_t valor_lido = 0;
-			uint32_t addr = registradores[rs1] + imm_i;
-
-			// Acesso à memória do CLINT
 			if (addr >= 0x02000000 && addr <= 0x0200BFFC)
 			{
-				switch (addr)
+				//Acesso à memória do CLINT
+				uint32_t registradorClint = addr;
+				Maquina *hartClint = hartDoClint(m, &registradorClint);
+				switch (registradorClint)
 				{
-				 // MSIP (Software interrupt pending)
+					// MSIP (Software interrupt pending)
 				case 0x02000000:
-					valor_lido = clint_msip;
+					__atomic_store_n(&hartClint->clint_msip, valor_lido & 0x1, __ATOMIC_RELAXED); // Atualiza MSIP (bit 0)
 					break;
-					// MTIMECMP (parte baixa)
+                    // MTIMECMP (parte baixa)
 				case 0x02004000:
-					valor_lido = (uint32_t)(clint_mtimecmp & 0xFFFFFFFF);
+					__atomic_store_n(&hartClint->clint_mtimecmp,
+									 (hartClint->clint_mtimecmp & 0xFFFFFFFF00000000ULL) | (uint64_t)valor_lido, __ATOMIC_RELAXED);
 					break;
-					// MTIMECMP (parte alta)
+                    // MTIMECMP (parte alta)
 				case 0x02004004:
-					valor_lido = (uint32_t)(clint_mtimecmp >> 32);
+					__atomic_store_n(&hartClint->clint_mtimecmp,
+									 (hartClint->clint_mtimecmp & 0x00000000FFFFFFFFULL) | ((uint64_t)valor_lido << 32), __ATOMIC_RELAXED);
 					break;
-					// MTIME (parte baixa dos 64 bits)
+                    // MTIME (parte baixa dos 64 bits)
 				case 0x0200BFF8:
-					valor_lido = (uint32_t)(clint_mtime & 0xFFFFFFFF);
+					m->clint_mtime = (m->clint_mtime & 0xFFFFFFFF00000000ULL) | (uint64_t)valor_lido;
 					break;
-					// MTIME (parte alta)
+                    // MTIME (parte alta)
 				case 0x0200BFFC:
-					valor_lido = (uint32_t)(clint_mtime >> 32);
+					m->clint_mtime = (m->clint_mtime & 0x00000000FFFFFFFFULL) | ((uint64_t)valor_lido << 32);
 					break;
+
 				default:
-					// Endereço não mapeado no intervalo CLINT
-					valor_lido = 0;
+					// Endereço dentro do intervalo CLINT sem ação definida
 					break;
 				}
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_lido;
-				}
+				TRACE(output, "0x%08x:sw     %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
+						pc,                        // Endereço da instrução
+						regNomes[rs2],             // Nome do registrador rs2
+						imm_s & 0xFFF,             //imediato do tipo s
+						regNomes[rs1],             // Nome do registrador rs1
+						addr,                      //endereço da memoria acessada
+						valor_lido);
 
-				fprintf(output, "0x%08x:lw     %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
-						pc,                               //endereço da instrução
-						regNomes[rd],                     //nome do registrador destino
-						imm_i & 0xFFF,                    //imediato do tipo i
-						regNomes[rs1],                    //nome do registrador rs1
-						regNomes[rd],                     //nome do registrador destino
-						addr,                             //endereço da memoria acessada
-						registradores[rd]);                //valor do registrador destino
+				break;
 			}
 
-			// PLIC
-			// Acesso aos registradores do PLIC (endereços mapeados)
-			switch (addr)
+			// Tratamento da UART para stores com funct3 = 0b000 e endereço na faixa UART
+			if (funct3 == 0b000 && addr >= 0x10000000 && addr <= 0x10000005)
 			{
-				// PRIORITY (prioridade de uma interrupção)
-			case 0x0C000028:
-				valor_lido = plic_priority;
-				break;
-				// PENDING (quais interrupções estão pendentes)
-			case 0x0C001000:
-				valor_lido = plic_pending;
-				break;
-				// ENABLE (quais interrupções estão habilitadas para gerar exceções)
-			case 0x0C002000:
-				valor_lido = plic_enable;
-				break;
-				//CLAIM (usado pelo processador para "reclamar" a interrupção atual)
-			case 0x0C200004:
-				if ((plic_pending & (1 << 10)) && (plic_enable & (1 << 10)))
-				{
-					valor_lido = 10; // ID da UART
-				}
-				else
+				uint32_t uart_offset = addr - 0x10000000;
+				registradoresUART[uart_offset] = valor_lido;
+
+				// Se for o registrador de transmissão (offset 0), envia caractere para o terminal
+				if (uart_offset == 0)
 				{
-					valor_lido = 0; // Nenhuma interrupção pendente
+					travarUART(m);
+					fputc(valor_lido, output2);
+					fflush(output2);
+					destravarUART(m);
+
+					// Marca interrupção PLIC pendente para UART (bit 10)
+					if (!(m->plic_pending & (1 << 10)))
+						m->plic_pending |= (1 << 10);
 				}
-				break;
-				// THRESHOLD (limite mínimo de prioridade)
-			case 0x0C200000:
-				valor_lido = plic_threshold;
-				break;
-			default:
-				// Endereço não mapeado para PLIC
-				valor_lido = 0;
+
+				TRACE(output, "0x%08x:sb     %s,0x%03x(%s) mem[0x%08x]=0x%02x\n",
+						pc,                      // Endereço da instrução
+						regNomes[rs2],           // Nome do registrador rs2
+						imm_s & 0xFFF,           //imediato do tipo s
+						regNomes[rs1],           // Nome do registrador rs1
+						addr,                    //endereço da memoria acessada
+						valor_lido);
+
 				break;
 			}
 
-			if (valor_lido != 0 || (addr >= 0x0C000000 && addr <= 0x0C20FFFF)) // condição para controle, opcional
+			// PLIC (Platform-Level Interrupt Controller)
+			if (addr == 0x0C000028) // PRIORITY (prioridade de uma interrupção)
 			{
-				if (rd != 0)
-					registradores[rd] = valor_lido;
+				m->plic_priority = valor_lido;
+			}
+			else if (addr == 0x0C002000) // ENABLE (quais interrupções estão habilitadas para gerar exceções)
+			{
+				m->plic_enable = valor_lido;
+			}
+			else if (addr == 0x0C200004) // CLAIM (usado pelo processador para "reclamar" a interrupção atual)
+			{
+				if (valor_lido == 10)
+				{
+					m->plic_pending &= ~(1 << 10); // Limpa o bit correspondente à interrupção 10
+				}
+			}
 
-				fprintf(output, "0x%08x:lw     %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
+			// Independente de qual registrador PLIC foi acessado, imprime o log da operação
+			if (addr == 0x0C000028 || addr == 0x0C002000 || addr == 0x0C200004)
+			{
+				TRACE(output, "0x%08x:sw     %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
 						pc,                       // Endereço da instrução
-						regNomes[rd],             // Nome do registrador destino
-						imm_i & 0xFFF,            //imediato do tipo i
-						regNomes[rs1],            //Nome do registrador rs1
-						regNomes[rd],             //Nome do registrador destino
-						addr,                     //endereço da memoria acessada
-						registradores[rd]);        //valor do registrador destino
-
+						regNomes[rs2],            // Nome do registrador rs2
+						imm_s & 0xFFF,            //imediato do tipo s
+						regNomes[rs1],            // Nome do registrador rs1
+						addr,                      //endereço da memoria acessada
+						valor_lido);
 				break;
 			}
+			// sb (Armazena 1 byte da parte menos significativa de rs2 na memória [rs1 + offset])
+			if (funct3 == 0b000)
+			{
+				const uint32_t endereco = registradores[rs1] + imm_s;
+
+				// Acesso normal à RAM
+				if (endereco < offset || endereco >= offset + TAM_MEMORIA)
+				{
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 7, pc, endereco, &pc);
+					continue;
+				}
+				const uint8_t resultado = registradores[rs2] & 0xFF;
+				mem[endereco - offset] = resultado;
+				marcarPaginaSuja(m->paginasSujas, endereco - offset);
+				TRACE(output, "0x%08x:sb %s,0x%03x(%s) mem[0x%08x]=0x%02x\n",
+						pc,                          // Endereço da instrução
+						regNomes[rs2],               // Nome do registrador rs2
+						imm_s & 0xFFF,               //imediato do tipo s
+						regNomes[rs1],               // Nome do registrador rs1
+						endereco, 
+						resultado);
+			}
 
-			// ACESSO À UART E PLIC
-			if (addr >= 0x10000000 && addr <= 0x10000007)
+			// sh ( Armazena 2 bytes da parte menos significativa de rs2 na memória [rs1 + offset])
+			else if (funct3 == 0b001)
 			{
-				if (addr == 0x10000000)
-				{
-					// UART RHR: lê caractere do terminal UART de entrada
-					int c = fgetc(input2);
-					printf("char lido: %02x\n", c);
-					if (c == EOF)
-					{
-						registradoresUART[0] = 0; // nada disponível, retorna 0
-					}
-					else
-					{
-						registradoresUART[0] = (uint8_t)c;
-					}
-					valor_lido = (uint32_t)(int32_t)((int8_t)registradoresUART[0]);
-
-					if (rd != 0)
-						registradores[rd] = valor_lido;
-
-					fprintf(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
-							pc,                                        // Endereço da instrução
-							funct3 == 0b000 ? "lb    " : "lbu   ",     //condição para saber qual instrução
-							regNomes[rd],                              // Nome do registrador destino
-							imm_i & 0xFFF,                             //imediato do tipo i 
-							regNomes[rs1],                             // Nome do registrador rs1
-							regNomes[rd],                              // Nome do registrador destino
-							addr,                                      // enderço da memoria acessada
-							registradores[rd]);                        //valor do registrador destino
+				const uint32_t endereco = registradores[rs1] + imm_s;
 
-					break;
-				}
-				else if (addr == 0x10000002)
+				if (endereco < offset || endereco + 1 >= offset + TAM_MEMORIA)
 				{
-					// Retorna o status do UART (Line Status Register)
-					// Bit 2 = 1 significa "dado disponível" segundo o assembly
-					valor_lido = registradoresUART[5]; // por exemplo, 0x04 se dado disponível
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 7, pc, endereco, &pc);
+					continue;
+				}
 
-					if (rd != 0)
-						registradores[rd] = (funct3 == 0b000) ? (int8_t)valor_lido : (uint8_t)valor_lido;
+				const uint16_t resultado = registradores[rs2] & 0xFFFF;
+				mem[endereco - offset] = resultado & 0xFF;
+				mem[endereco + 1 - offset] = (resultado >> 8) & 0xFF;
+				marcarPaginaSuja(m->paginasSujas, endereco - offset);
+				marcarPaginaSuja(m->paginasSujas, endereco + 1 - offset);
 
-					fprintf(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
-							pc,                                       // Endereço da instrução
-							funct3 == 0b000 ? "lb    " : "lbu   ",   //condição para saber qual instrução
-							regNomes[rd],                            // Nome do registrador destino
-							imm_i & 0xFFF,                           //imediato do tipo i 
-							regNomes[rs1],                           // Nome do registrador rs1
-							regNomes[rd],                            // Nome do registrador destino
-							addr,                                    // enderço da memoria acessada
-							registradores[rd]);                      //valor do registrador destino
+				TRACE(output, "0x%08x:sh %s,0x%03x(%s) mem[0x%08x]=0x%04x\n",
+						pc,                      // Endereço da instrução
+						regNomes[rs2],           // Nome do registrador rs2
+						imm_s & 0xFFF,           //imediato do tipo s
+						regNomes[rs1],           // Nome do registrador rs1
+						endereco, 
+						resultado);
+			}
 
-					break;
-				}
+			// sw (Armazena 4 bytes da parte menos significativa de rs2 na memória [rs1 + offset])
+			else if (funct3 == 0b010)
+			{
+				const uint32_t endereco = registradores[rs1] + imm_s;
 
-				else if (addr == 0x10000005)
+				if (endereco < offset || endereco + 3 >= offset + TAM_MEMORIA)
 				{
-					// UART LSR: indica se há dado disponível (bit 0 = 1 se sim)
-					int c = fgetc(input2); // tenta ler um caractere
-					if (c == EOF)
-					{
-						registradoresUART[5] = 0x60; // bit 0 = 0 → nada disponível
-					}
-					else
-					{
-						ungetc(c, input2);			 // devolve o caractere
-						registradoresUART[5] = 0x61; // bit 0 = 1 → dado disponível
+					prepMstatus(&registradoresCSRs[0]);
+					evento = registrarExcecao(m, instrucoes, 7, pc, endereco, &pc);
+					continue;
+				}
 
-						// Aqui você pode ativar a interrupção no PLIC (fonte 1: UART)
-					}
-					valor_lido = registradoresUART[5];
+				const uint32_t resultado = registradores[rs2];
+				mem[endereco - offset] = resultado & 0xFF;
+				mem[endereco + 1 - offset] = (resultado >> 8) & 0xFF;
+				mem[endereco + 2 - offset] = (resultado >> 16) & 0xFF;
+				mem[endereco + 3 - offset] = (resultado >> 24) & 0xFF;
+				marcarPaginaSuja(m->paginasSujas, endereco - offset);
+				marcarPaginaSuja(m->paginasSujas, endereco + 3 - offset);
 
-					if (rd != 0)
-						registradores[rd] = valor_lido;
+				TRACE(output, "0x%08x:sw %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
+						pc,                    // Endereço da instrução
+						regNomes[rs2],         // Nome do registrador rs2
+						imm_s & 0xFFF,         //imediato do tipo s
+						regNomes[rs1],         // Nome do registrador rs2
+						endereco, 
+						resultado);
+			}
+			break;
+		}
+		// tipo Branch
+		case 0b1100011:
+			// beq (Compara os valores em rs1 e rs2. Se forem iguais, salta para PC + offset)
+			if (funct3 == 0b000)
+			{
 
-					fprintf(output, "0x%08x:%s  %s,0x%03x(%s)  %s=mem[0x%08x]=0x%08x\n",
-							pc,                                       // Endereço da instrução
-							funct3 == 0b000 ? "lb    " : "lbu   ",    //condição para saber qual instrução
-							regNomes[rd],                             // Nome do registrador destino
-							imm_i & 0xFFF,                            //imediato do tipo i
-							regNomes[rs1],                            // Nome do registrador rs1
-							regNomes[rd],                             // Nome do registrador destino
-							addr,                                     // enderço da memoria acessada
-							registradores[rd]);                       //valor do registrador destino
+				TRACE(output, "0x%08x:beq %s,%s,0x%03x (0x%08x==0x%08x)=u1->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						(registradores[rs1] == registradores[rs2]) ? pc + imm_b : pc + 4);
 
-					break;
+				if (registradores[rs1] == registradores[rs2])
+				{
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc += imm_b;
+					continue;
 				}
 			}
 
-			// lb (Carrega um byte da memória no endereço rs1 + offset, extende para 32 bits com sinal e armazena em rd)
-			if (funct3 == 0b000)
+			// bne (Compara os valores em rs1 e rs2. Se forem diferentes, salta para PC + offset)
+			else if (funct3 == 0b001)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_i;
-				uint32_t resultado = 0;
+				const int condicao = registradores[rs1] != registradores[rs2];
 
-				// Tratamento da exceção 5 — Load Access Fault
-				if (endereco < offset || endereco >= offset + 32 * 1024)
+				TRACE(output, "0x%08x:bne %s,%s,0x%03x (0x%08x!=0x%08x)=u1->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						(registradores[rs1] != registradores[rs2]) ? pc + imm_b : pc + 4);
+
+				if (condicao)
 				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(5, pc, endereco, registradoresCSRs, output, &pc);
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc += imm_b;
 					continue;
 				}
+			}
 
-				const int8_t byte = (int8_t)mem[endereco - offset];
-				resultado = (uint32_t)(int32_t)byte;
+			// blt (Compara rs1 e rs2 com sinal. Se rs1 < rs2, salta para PC + offset)
+			else if (funct3 == 0b100)
+			{
+				const int32_t rs1_sinal = (int32_t)registradores[rs1];
+				const int32_t rs2_sinal = (int32_t)registradores[rs2];
 
-				fprintf(output, "0x%08x:lb %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
-						pc,                              // Endereço da instrução
-						regNomes[rd],                    // Nome do registrador destino
-						imm_i & 0xFFF,                   //imediato do tipo i
-						regNomes[rs1],                   // Nome do registrador rs1
-						regNomes[rd],                    // Nome do registrador destino
-						endereco,
-						resultado);
+				const int condicao = rs1_sinal < rs2_sinal;
 
-				if (rd != 0)
-					registradores[rd] = resultado;
+				TRACE(output, "0x%08x:blt %s,%s,0x%03x (0x%08x<0x%08x)=%d->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						condicao,
+						condicao ? pc + imm_b : pc + 4);
+
+				if (condicao)
+				{
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc += imm_b;
+					continue; // IMPORTANTE: pula pc += 4
+				}
 			}
 
-			// lh (Carrega halfword de 16 bits com extensão de sinal)
-			else if (funct3 == 0b001)
+			// bge (Compara rs1 e rs2 com sinal. Se rs1 >= rs2, salta para PC + offset)
+			else if (funct3 == 0b101)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_i;
+				const int32_t rs1_sinal = registradores[rs1];
+				const int32_t rs2_sinal = registradores[rs2];
+
+				TRACE(output, "0x%08x:bge %s,%s,0x%03x (0x%08x>=0x%08x)=u1->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						((int32_t)registradores[rs1] >= (int32_t)registradores[rs2]) ? pc + imm_b : pc + 4);
 
-				if (endereco < offset || endereco >= offset + 32 * 1024)
+				if (rs1_sinal >= rs2_sinal)
 				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(5, pc, endereco, registradoresCSRs, output, &pc);
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc = pc + imm_b;
 					continue;
 				}
+			}
 
-				int16_t halfword = (int16_t)(mem[endereco - offset] | (mem[endereco + 1 - offset] << 8));
-				uint32_t resultado = (uint32_t)(int32_t)halfword;
+			// bltu (Compara rs1 e rs2 sem sinal. Se rs1 < rs2, salta para PC + offset)
+			else if (funct3 == 0b110)
+			{
 
-				fprintf(output, "0x%08x:lh %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
-						pc,                            // Endereço da instrução
-						regNomes[rd],                  // Nome do registrador destino 
-						imm_i & 0xFFF,                 //imediato do tipo i
-						regNomes[rs1],                 // Nome do registrador rs1
-						regNomes[rd],                  // Nome do registrador destino
-						endereco,
-						resultado);
+				TRACE(output, "0x%08x:bltu %s,%s,0x%03x (0x%08x<0x%08x)=u1->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						(registradores[rs1] < registradores[rs2]) ? pc + imm_b : pc + 4);
 
-				if (rd != 0)
-					registradores[rd] = resultado;
+				if (registradores[rs1] < registradores[rs2])
+				{
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc = pc + imm_b;
+					continue;
+				}
 			}
 
-			// lw (Carrega uma word (32 bits) da memória no endereço rs1 + offset e armazena em rd)
-			else if (funct3 == 0b010)
+			// bgeu (Compara rs1 e rs2 sem sinal. Se rs1 >= rs2, salta para PC + offset)
+			else if (funct3 == 0b111)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_i;
 
-				if (endereco < offset || endereco + 3 >= offset + 32 * 1024)
+				TRACE(output, "0x%08x:bgeu %s,%s,0x%03x (0x%08x>=0x%08x)=u1->pc=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rs1],		// Nome do registrador rs1
+						regNomes[rs2],		// Nome do registrador rs2
+						imm_b & 0xFFF,		// imediato do tipo b
+						registradores[rs1], // valor de rs1
+						registradores[rs2], // valor de rs2
+						(registradores[rs1] >= registradores[rs2]) ? pc + imm_b : pc + 4);
+
+				if (registradores[rs1] >= registradores[rs2])
 				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(5, pc, endereco, registradoresCSRs, output, &pc);
+					if (cobertura != NULL)
+						marcarAresta(cobertura, pc, pc + imm_b);
+					pc = pc + imm_b;
 					continue;
 				}
+			}
+			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
+			else
+			{
+				// preparando mstatus para a excessão
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
+				continue;
+			}
+			break;
+
+		// tipo jump byte
+		// jal (Salta para PC + offset e armazena PC + 4 em rd)
+		case 0b1101111:
+			// if (opcode == 1101111 ){
+
+			// const int32_t offset = (imm_j << 11) >> 11;
+			const uint32_t campo_imm_j = (imm_j >> 1) & 0xFFFFF;
 
-				uint32_t resultado = mem[endereco - offset] |
-									 (mem[endereco + 1 - offset] << 8) |
-									 (mem[endereco + 2 - offset] << 16) |
-									 (mem[endereco + 3 - offset] << 24);
+			const uint32_t destino = pc + imm_j;
+			const uint32_t retorno = pc + 4;
 
-				fprintf(output, "0x%08x:lw %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
-						pc,                          // Endereço da instrução
-						regNomes[rd],                // Nome do registrador destino 
-						imm_i & 0xFFF,               // imediato do tipo i
-						regNomes[rs1],               //nome do registrador rs1
-						endereco,
-						resultado);
+			TRACE(output, "0x%08x:jal %s,0x%05x pc=0x%08x,%s=0x%08x\n",
+					pc,			  // Endereço da instrução
+					regNomes[rd], // Nome do registrador destino
+					campo_imm_j,  // imeadiato do tipo j
+					destino,	  // proxima instrução
+					regNomes[rd], // Nome do registrador destino
+					retorno);
 
-				if (rd != 0)
-					registradores[rd] = resultado;
+			if (rd != 0)
+			{
+				registradores[rd] = retorno;
 			}
+			if (m->pilhaChamadas != NULL && rd == 1)
+				empilharChamada(m->pilhaChamadas, instrucoes, destino, retorno, 0);
+			if (cobertura != NULL)
+				marcarAresta(cobertura, pc, destino);
 
-			// lbu (Carrega byte com zero-extend)
-			else if (funct3 == 0b100)
+			pc = destino;
+			continue; // para não incrementar o PC após salto
+
+			//}
+
+			// tipo jump
+			// jalr (Salta para o endereço rs1 + offset e armazena pc + 4 em rd)
+		case 0b1100111:
+			if (funct3 == 0b000)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_i;
+				// const int32_t offset = ((int32_t)instrucao) >> 20;
+				const uint32_t retorno = pc + 4;
+				const uint32_t novo_pc = (registradores[rs1] + imm_i) & ~1;
+				TRACE(output, "0x%08x:jalr %s,%s,0x%03x pc=0x%08x+0x%08x,%s=0x%08x\n",
+						pc,					// Endereço da instrução
+						regNomes[rd],		// Nome do registrador destino
+						regNomes[rs1],		// nome do rs1
+						imm_i & 0xFFF,		// imediato do tipo i
+						registradores[rs1], // valor de rs1
+						imm_i,				// imediato do tipo i
+						regNomes[rd],		// Nome do registrador destino
+						retorno);
 
-				if (endereco < offset || endereco >= offset + 32 * 1024)
+				if (rd != 0)
 				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(5, pc, endereco, registradoresCSRs, output, &pc);
-					continue;
+					registradores[rd] = retorno;
+				}
+				if (m->pilhaChamadas != NULL)
+				{
+					if (rd == 1)
+						empilharChamada(m->pilhaChamadas, instrucoes, novo_pc, retorno, 0);
+					else if (rd == 0 && rs1 == 1 && imm_i == 0)
+						retornarChamada(m->pilhaChamadas, instrucoes, novo_pc);
 				}
+				if (cobertura != NULL)
+					marcarAresta(cobertura, pc, novo_pc);
 
-				uint32_t resultado = (uint32_t)mem[endereco - offset];
+				pc = novo_pc;
+				continue;
+			}
 
-				fprintf(output, "0x%08x:lbu %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
-						pc,                           // Endereço da instrução      
-						regNomes[rd],                 //nome do registrador destino
-						imm_i & 0xFFF,                //imediato do tipo i
-						regNomes[rs1],                //nome do registrador rs1
-						regNomes[rd],                 //nome do registrador destino
-						endereco,
-						resultado);
+			// tipo Upper immediate
+			// lui (Carrega um valor imediato de 20 bits nos bits mais altos do registrador, os 12 bits inferiores ficam zerados)
+		case 0b0110111:
+			const uint32_t resultado_lui = imm_u;
 
-				if (rd != 0)
-					registradores[rd] = resultado;
-			}
+			TRACE(output, "0x%08x:lui %s,0x%05x %s=0x%05x000\n",
+					pc,			  // Endereço da instrução
+					regNomes[rd], // nome do registrador de destino
+					imm_u >> 12,  // imediato do tipo u
+					regNomes[rd], // nome do registrador de destino
+					imm_u >> 12); // imediato do tipo u
 
-			// lhu (Carrega halfword com zero-extend)
-			else if (funct3 == 0b101)
+			if (rd != 0)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_i;
+				registradores[rd] = resultado_lui;
+			}
 
-				if (endereco < offset || endereco >= offset + 32 * 1024)
-				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(5, pc, endereco, registradoresCSRs, output, &pc);
-					continue;
-				}
+			break;
 
-				uint16_t halfword = mem[endereco - offset] | (mem[endereco + 1 - offset] << 8);
-				uint32_t resultado = (uint32_t)halfword;
+			// tipo Upper immediate
+			// auipc (Carrega um valor imediato de 20 bits nos bits mais altos do registrador, os 12 bits inferiores ficam zerados)
+		case 0b0010111:
+			const uint32_t resultado_auipc = pc + imm_u;
 
-				fprintf(output, "0x%08x:lhu %s,0x%03x(%s) %s=mem[0x%08x]=0x%08x\n",
-						pc,                            // Endereço da instrução  
-						regNomes[rd],                  //nome do registrador destino
-						imm_i & 0xFFF,                 //imediato do tipo i
-						regNomes[rs1],                 //nome do registrador rs1
-						regNomes[rd],                  //nome do registrador destino
-						endereco,
-						resultado);
+			TRACE(output, "0x%08x:auipc %s,0x%05x %s=0x%08x+0x%05x000=0x%08x\n",
+					pc,			  // Endereço da instrução
+					regNomes[rd], // nome do registrador de destino
+					imm_u >> 12,  // imediato do tipo u
+					regNomes[rd], // nome do registrador de destino
+					pc,			  // Endereço da instrução
+					imm_u >> 12,  // imediato do tipo u
+					resultado_auipc);
 
-				if (rd != 0)
-					registradores[rd] = resultado;
+			if (rd != 0)
+			{
+				registradores[rd] = resultado_auipc;
 			}
+			break;
 
-			// Tratamento da exceção para instrução ilegal
-			else
+			// tipo atômico (extensão A): lr.w, sc.w e amo*.w
+			// as operações usam atômicos do hospedeiro sobre a memória simulada, então harts em threads
+			// diferentes não precisam de trava
+		case 0b0101111:
+		{
+			const uint32_t funct5 = funct7 >> 2; // bits aq/rl ignorados: os atômicos do hospedeiro já são sequencialmente consistentes
+			const uint32_t endereco = registradores[rs1];
+
+			if (funct3 != 0b010 || (funct5 == 0b00010 && rs2 != 0))
+			{
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
+				continue;
+			}
+			// endereço desalinhado ou fora da memória: lr.w gera exceção de load, o resto de store/AMO
+			if (endereco & 0x3)
 			{
 				prepMstatus(&registradoresCSRs[0]);
-				registrarExcecao(2, pc, instrucao, registradoresCSRs, output, &pc);
+				evento = registrarExcecao(m, instrucoes, funct5 == 0b00010 ? 4 : 6, pc, endereco, &pc);
+				continue;
+			}
+			if (endereco < offset || endereco - offset > TAM_MEMORIA - 4)
+			{
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, funct5 == 0b00010 ? 5 : 7, pc, endereco, &pc);
 				continue;
 			}
 
-			break;
-			// tipo Store byte
-		case 0b0100011:
-		{
-			// Instruções de store
-			uint32_t addr = registradores[rs1] + imm_s;
-			uint32_t valor_lido = registradores[rs2];
+			uint32_t *palavra = (uint32_t *)(mem + (endereco - offset));
+			const uint32_t valor = registradores[rs2];
+			uint32_t anterior;
 
-			if (addr >= 0x02000000 && addr <= 0x0200BFFC)
+			// lr.w: lê e guarda a reserva (endereço e valor lido)
+			if (funct5 == 0b00010)
 			{
-				//Acesso à memória do CLINT
-				switch (addr)
-				{
-					// MSIP (Software interrupt pending)
-				case 0x02000000:
-					clint_msip = valor_lido & 0x1; // Atualiza MSIP (bit 0)
-					break;
-                    // MTIMECMP (parte baixa)
-				case 0x02004000:
-					clint_mtimecmp = (clint_mtimecmp & 0xFFFFFFFF00000000ULL) | (uint64_t)valor_lido;
-					break;
-                    // MTIMECMP (parte alta)
-				case 0x02004004:
-					clint_mtimecmp = (clint_mtimecmp & 0x00000000FFFFFFFFULL) | ((uint64_t)valor_lido << 32);
-					break;
-                    // MTIME (parte baixa dos 64 bits)
-				case 0x0200BFF8:
-					clint_mtime = (clint_mtime & 0xFFFFFFFF00000000ULL) | (uint64_t)valor_lido;
-					break;
-                    // MTIME (parte alta)
-				case 0x0200BFFC:
-					clint_mtime = (clint_mtime & 0x00000000FFFFFFFFULL) | ((uint64_t)valor_lido << 32);
-					break;
-
-				default:
-					// Endereço dentro do intervalo CLINT sem ação definida
-					break;
-				}
+				anterior = __atomic_load_n(palavra, __ATOMIC_SEQ_CST);
+				m->enderecoReservado = endereco;
+				m->valorReservado = anterior;
+				m->reservaValida = 1;
 
-				fprintf(output, "0x%08x:sw     %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
-						pc,                        // Endereço da instrução
-						regNomes[rs2],             // Nome do registrador rs2
-						imm_s & 0xFFF,             //imediato do tipo s
-						regNomes[rs1],             // Nome do registrador rs1
-						addr,                      //endereço da memoria acessada
-						valor_lido);
+				if (rd != 0)
+					registradores[rd] = anterior;
 
+				TRACE(output, "0x%08x:lr.w   %s,(%s)  %s=mem[0x%08x]=0x%08x\n",
+						pc, regNomes[rd], regNomes[rs1], regNomes[rd], endereco, anterior);
 				break;
 			}
 
-			// Tratamento da UART para stores com funct3 = 0b000 e endereço na faixa UART
-			if (funct3 == 0b000 && addr >= 0x10000000 && addr <= 0x10000005)
+			// sc.w: só grava se a reserva é deste endereço e a memória ainda tem o valor lido pelo lr.w
+			// (compare-and-swap: nenhuma escrita precisa invalidar reservas de outros harts)
+			if (funct5 == 0b00011)
 			{
-				uint32_t uart_offset = addr - 0x10000000;
-				registradoresUART[uart_offset] = valor_lido;
-
-				// Se for o registrador de transmissão (offset 0), envia caractere para o terminal
-				if (uart_offset == 0)
-				{
-					fputc(valor_lido, output2);
-					fflush(output2);
-
-					// Marca interrupção PLIC pendente para UART (bit 10)
-					if (!(plic_pending & (1 << 10)))
-						plic_pending |= (1 << 10);
-				}
+				uint32_t esperado = m->valorReservado;
+				const int sucesso = m->reservaValida && m->enderecoReservado == endereco &&
+									__atomic_compare_exchange_n(palavra, &esperado, valor, 0, __ATOMIC_SEQ_CST,
+																__ATOMIC_SEQ_CST);
+				m->reservaValida = 0;
+				if (sucesso)
+					marcarPaginaSuja(m->paginasSujas, endereco - offset);
 
-				fprintf(output, "0x%08x:sb     %s,0x%03x(%s) mem[0x%08x]=0x%02x\n",
-						pc,                      // Endereço da instrução
-						regNomes[rs2],           // Nome do registrador rs2
-						imm_s & 0xFFF,           //imediato do tipo s
-						regNomes[rs1],           // Nome do registrador rs1
-						addr,                    //endereço da memoria acessada
-						valor_lido);
+				if (rd != 0)
+					registradores[rd] = !sucesso; // 0 = sucesso
 
+				TRACE(output, "0x%08x:sc.w   %s,%s,(%s)  mem[0x%08x]=0x%08x,%s=%u\n",
+						pc, regNomes[rd], regNomes[rs2], regNomes[rs1], endereco,
+						sucesso ? valor : __atomic_load_n(palavra, __ATOMIC_RELAXED), regNomes[rd], !sucesso);
 				break;
 			}
 
-			// PLIC (Platform-Level Interrupt Controller)
-			if (addr == 0x0C000028) // PRIORITY (prioridade de uma interrupção)
-			{
-				plic_priority = valor_lido;
-			}
-			else if (addr == 0x0C002000) // ENABLE (quais interrupções estão habilitadas para gerar exceções)
+			const char *nome;
+			uint32_t escrito; // valor gravado por esta instrução (para o trace)
+			switch (funct5)
 			{
-				plic_enable = valor_lido;
-			}
-			else if (addr == 0x0C200004) // CLAIM (usado pelo processador para "reclamar" a interrupção atual)
+			case 0b00001:
+				nome = "amoswap.w";
+				anterior = __atomic_exchange_n(palavra, valor, __ATOMIC_SEQ_CST);
+				escrito = valor;
+				break;
+			case 0b00000:
+				nome = "amoadd.w";
+				anterior = __atomic_fetch_add(palavra, valor, __ATOMIC_SEQ_CST);
+				escrito = anterior + valor;
+				break;
+			case 0b00100:
+				nome = "amoxor.w";
+				anterior = __atomic_fetch_xor(palavra, valor, __ATOMIC_SEQ_CST);
+				escrito = anterior ^ valor;
+				break;
+			case 0b01100:
+				nome = "amoand.w";
+				anterior = __atomic_fetch_and(palavra, valor, __ATOMIC_SEQ_CST);
+				escrito = anterior & valor;
+				break;
+			case 0b01000:
+				nome = "amoor.w";
+				anterior = __atomic_fetch_or(palavra, valor, __ATOMIC_SEQ_CST);
+				escrito = anterior | valor;
+				break;
+			case 0b10000: // amomin.w
+			case 0b10100: // amomax.w
+			case 0b11000: // amominu.w
+			case 0b11100: // amomaxu.w
 			{
-				if (valor_lido == 10)
+				// mínimo/máximo não têm instrução atômica no hospedeiro: laço de compare-and-swap
+				static const char *nomesMinMax[4] = {"amomin.w", "amomax.w", "amominu.w", "amomaxu.w"};
+				nome = nomesMinMax[(funct5 >> 2) & 0x3];
+				anterior = __atomic_load_n(palavra, __ATOMIC_RELAXED);
+				do
 				{
-					plic_pending &= ~(1 << 10); // Limpa o bit correspondente à interrupção 10
-				}
-			}
-
-			// Independente de qual registrador PLIC foi acessado, imprime o log da operação
-			if (addr == 0x0C000028 || addr == 0x0C002000 || addr == 0x0C200004)
-			{
-				fprintf(output, "0x%08x:sw     %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
-						pc,                       // Endereço da instrução
-						regNomes[rs2],            // Nome do registrador rs2
-						imm_s & 0xFFF,            //imediato do tipo s
-						regNomes[rs1],            // Nome do registrador rs1
-						addr,                      //endereço da memoria acessada
-						valor_lido);
+					const int menor = (funct5 & 0b01000) ? anterior < valor : (int32_t)anterior < (int32_t)valor;
+					escrito = ((funct5 & 0b00100) ? !menor : menor) ? anterior : valor;
+				} while (!__atomic_compare_exchange_n(palavra, &anterior, escrito, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
 				break;
 			}
-			// sb (Armazena 1 byte da parte menos significativa de rs2 na memória [rs1 + offset])
-			if (funct3 == 0b000)
-			{
-				const uint32_t endereco = registradores[rs1] + imm_s;
-
-				// Acesso normal à RAM
-				if (endereco < offset || endereco >= offset + 32 * 1024)
-				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(7, pc, endereco, registradoresCSRs, output, &pc);
-					continue;
-				}
-				const uint8_t resultado = registradores[rs2] & 0xFF;
-				mem[endereco - offset] = resultado;
-				fprintf(output, "0x%08x:sb %s,0x%03x(%s) mem[0x%08x]=0x%02x\n",
-						pc,                          // Endereço da instrução
-						regNomes[rs2],               // Nome do registrador rs2
-						imm_s & 0xFFF,               //imediato do tipo s
-						regNomes[rs1],               // Nome do registrador rs1
-						endereco, 
-						resultado);
+			default:
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
+				continue;
 			}
+			marcarPaginaSuja(m->paginasSujas, endereco - offset);
 
-			// sh ( Armazena 2 bytes da parte menos significativa de rs2 na memória [rs1 + offset])
-			else if (funct3 == 0b001)
-			{
-				const uint32_t endereco = registradores[rs1] + imm_s;
+			if (rd != 0)
+				registradores[rd] = anterior;
 
-				if (endereco < offset || endereco + 1 >= offset + 32 * 1024)
-				{
-					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(7, pc, endereco, registradoresCSRs, output, &pc);
-					continue;
-				}
+			TRACE(output, "0x%08x:%-9s %s,%s,(%s)  %s=mem[0x%08x]=0x%08x,mem=0x%08x\n",
+					pc, nome, regNomes[rd], regNomes[rs2], regNomes[rs1], regNomes[rd], endereco, anterior, escrito);
+			break;
+		}
 
-				const uint16_t resultado = registradores[rs2] & 0xFFFF;
-				mem[endereco - offset] = resultado & 0xFF;
-				mem[endereco + 1 - offset] = (resultado >> 8) & 0xFF;
+			// tipo System
+			// imediato do tipo system
 
-				fprintf(output, "0x%08x:sh %s,0x%03x(%s) mem[0x%08x]=0x%04x\n",
-						pc,                      // Endereço da instrução
-						regNomes[rs2],           // Nome do registrador rs2
-						imm_s & 0xFFF,           //imediato do tipo s
-						regNomes[rs1],           // Nome do registrador rs1
-						endereco, 
-						resultado);
-			}
+		case 0b1110011:
+			uint32_t imm_csr = (instrucao >> 20) & 0xFFF;
 
-			// sw (Armazena 4 bytes da parte menos significativa de rs2 na memória [rs1 + offset])
-			else if (funct3 == 0b010)
+			// instruções de CSR: um caminho só para as seis, guiado pela tabela de descritores
+			if (funct3 != 0b000 && funct3 != 0b100)
 			{
-				const uint32_t endereco = registradores[rs1] + imm_s;
+				const DescritorCsr *csr = &tabelaCsrs[imm_csr];
+				if (csr->nome == NULL && csr->ler == NULL)
+				{
+					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
+					evento = EVENTO_CSR_INVALIDO;
+					pcCsrInvalido = pc; // o resto do laço ainda roda (mtime, interrupções), como no trace original
+					break;
+				}
 
-				if (endereco < offset || endereco + 3 >= offset + 32 * 1024)
+				// fonte: rs1 (csrrw/csrrs/csrrc) ou o imediato de 5 bits no campo rs1 (versões "i")
+				// csrrs/csrrc com rs1/imediato zero só leem
+				const uint32_t fonte = (funct3 & 0b100) ? rs1 : registradores[rs1];
+				const int escreve = (funct3 & 0b011) == 0b001 || rs1 != 0;
+				if (escreve && (imm_csr >> 10) == 0b11)
 				{
 					prepMstatus(&registradoresCSRs[0]);
-					registrarExcecao(7, pc, endereco, registradoresCSRs, output, &pc);
+					evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc);
 					continue;
 				}
 
-				const uint32_t resultado = registradores[rs2];
-				mem[endereco - offset] = resultado & 0xFF;
-				mem[endereco + 1 - offset] = (resultado >> 8) & 0xFF;
-				mem[endereco + 2 - offset] = (resultado >> 16) & 0xFF;
-				mem[endereco + 3 - offset] = (resultado >> 24) & 0xFF;
+				const uint32_t antigo = (csr->ler != NULL)	   ? csr->ler(m, imm_csr, instrucoes)
+										: (csr->indice >= 0) ? registradoresCSRs[csr->indice]
+															 : csr->valorFixo;
+				uint32_t novo = antigo;
+				if (escreve)
+				{
+					const uint32_t escrito = ((funct3 & 0b011) == 0b001)   ? fonte
+											 : ((funct3 & 0b011) == 0b010) ? antigo | fonte
+																		   : antigo & ~fonte;
+					novo = (antigo & ~csr->mascaraEscrita) | (escrito & csr->mascaraEscrita);
+					if (csr->escrever != NULL)
+					{
+						csr->escrever(m, imm_csr, novo, instrucoes);
+						estatisticas = m->estatisticas; // mhpmevent pode ter ligado as estatísticas ou as caches
+						modeloCache = m->modeloCache;
+						decodificar = estatisticas != NULL || mapaAcessos != NULL || modeloCache != NULL ||
+									  modeloPipeline != NULL;
+					}
+					else if (csr->indice >= 0)
+					{
+						registradoresCSRs[csr->indice] = novo;
+					}
+				}
+				if (rd != 0)
+				{
+					registradores[rd] = antigo;
+				}
 
-				fprintf(output, "0x%08x:sw %s,0x%03x(%s) mem[0x%08x]=0x%08x\n",
-						pc,                    // Endereço da instrução
-						regNomes[rs2],         // Nome do registrador rs2
-						imm_s & 0xFFF,         //imediato do tipo s
-						regNomes[rs1],         // Nome do registrador rs2
-						endereco, 
-						resultado);
+				char nome[24];
+				if (output != NULL)
+					imprimirCsr(output, funct3, pc, rd, rs1, nomeCsr(imm_csr, nome, sizeof(nome)), antigo, fonte, novo);
+				break;
 			}
-			break;
-		}
-		// tipo Branch
-		case 0b1100011:
-			// beq (Compara os valores em rs1 e rs2. Se forem iguais, salta para PC + offset)
-			if (funct3 == 0b000)
+
+			// ebreak (Interrompe a execução do programa; usada para debug)
+			if (funct3 == 0b000 && imm_i == 1)
 			{
+				TRACE(output, "0x%08x:ebreak\n", pc);
+				evento = EVENTO_EBREAK;
+				continue; // Impede que pc += 4 seja executado
+			}
 
-				fprintf(output, "0x%08x:beq %s,%s,0x%03x (0x%08x==0x%08x)=u1->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						(registradores[rs1] == registradores[rs2]) ? pc + imm_b : pc + 4);
+			// Instruções de sistema (ecall + mret + wfi)
 
-				if (registradores[rs1] == registradores[rs2])
-				{
-					pc += imm_b;
-					continue;
-				}
+			// ecall (Solicita serviço ao sistema; gera uma exceção para tratar chamada de ambiente)
+			else if (funct3 == 0b000 && imm_i == 0)
+			{
+				TRACE(output, "0x%08x:ecall\n", pc);
+				// preparando mstatus para a excessão
+				prepMstatus(&registradoresCSRs[0]);
+				evento = registrarExcecao(m, instrucoes, 11, pc, instrucao, &pc); // 11 = código de exceção para ECALL
+
+				continue; // Pula o pc += 4 no final do loop
 			}
 
-			// bne (Compara os valores em rs1 e rs2. Se forem diferentes, salta para PC + offset)
-			else if (funct3 == 0b001)
+			// mret (Retorna do modo de exceção para o ponto onde o programa foi interrompido)
+			else if (funct3 == 0b000 && imm_i == 0x302)
 			{
-				const int condicao = registradores[rs1] != registradores[rs2];
+				int idx_mepc = csrIndex(833);	 // mepc
+				int idx_mstatus = csrIndex(768); // mstatus
 
-				fprintf(output, "0x%08x:bne %s,%s,0x%03x (0x%08x!=0x%08x)=u1->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						(registradores[rs1] != registradores[rs2]) ? pc + imm_b : pc + 4);
+				uint32_t mepc = registradoresCSRs[idx_mepc];
+				uint32_t mstatus = registradoresCSRs[idx_mstatus];
 
-				if (condicao)
-				{
-					pc += imm_b;
-					continue;
-				}
-			}
+				// Atualiza mstatus:
+				// MIE ← MPIE (bit 3 ← bit 7)
+				mstatus = (mstatus & ~(1 << 3)) | (((mstatus >> 7) & 1) << 3);
 
-			// blt (Compara rs1 e rs2 com sinal. Se rs1 < rs2, salta para PC + offset)
-			else if (funct3 == 0b100)
-			{
-				const int32_t rs1_sinal = (int32_t)registradores[rs1];
-				const int32_t rs2_sinal = (int32_t)registradores[rs2];
+				// MPIE ← 1
+				mstatus |= (1 << 7);
 
-				const int condicao = rs1_sinal < rs2_sinal;
+				// MPP ← 00 (bits 12-11)
+				mstatus &= ~(3 << 11);
 
-				fprintf(output, "0x%08x:blt %s,%s,0x%03x (0x%08x<0x%08x)=%d->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						condicao,
-						condicao ? pc + imm_b : pc + 4);
+				registradoresCSRs[idx_mstatus] = mstatus;
 
-				if (condicao)
-				{
-					pc += imm_b;
-					continue; // IMPORTANTE: pula pc += 4
-				}
+				TRACE(output, "0x%08x:mret       pc=0x%08x\n", pc, mepc);
+				if (m->pilhaChamadas != NULL)
+					retornarTrap(m->pilhaChamadas, instrucoes);
+				if (m->latencias != NULL)
+					sairTrap(m->latencias, m, instrucoes);
+
+				pc = mepc;
+				continue;
 			}
 
-			// bge (Compara rs1 e rs2 com sinal. Se rs1 >= rs2, salta para PC + offset)
-			else if (funct3 == 0b101)
+			// wfi (espera por interrupção): sem trace, segue como nop mas devolve o controle depois desta instrução
+			else if (funct3 == 0b000 && imm_i == 0x105)
 			{
-				const int32_t rs1_sinal = registradores[rs1];
-				const int32_t rs2_sinal = registradores[rs2];
+				evento = EVENTO_WFI;
+			}
 
-				fprintf(output, "0x%08x:bge %s,%s,0x%03x (0x%08x>=0x%08x)=u1->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						((int32_t)registradores[rs1] >= (int32_t)registradores[rs2]) ? pc + imm_b : pc + 4);
+			break;
 
-				if (rs1_sinal >= rs2_sinal)
-				{
-					pc = pc + imm_b;
-					continue;
-				}
-			}
+			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
+		default:
+			// fprintf(output, "Instrução inválida em 0x%08x: 0x%08x (opcode: 0x%02x)\n", // para achar o erro
+			// pc, instrucao, opcode);
+			// preparando mstatus para a excessão
+			prepMstatus(&registradoresCSRs[0]);
+			evento = registrarExcecao(m, instrucoes, 2, pc, instrucao, &pc); // código 2 = Illegal Instruction
+			continue;															// Isso será tratado pelo handler
+		}
 
-			// bltu (Compara rs1 e rs2 sem sinal. Se rs1 < rs2, salta para PC + offset)
-			else if (funct3 == 0b110)
-			{
+		// loads/stores/AMOs que geraram exceção saíram com continue: aqui só chegam os que executaram
+		if (decodificar && efeito.acesso != ACESSO_NENHUM)
+			registrarAcessoDados(estatisticas, mapaAcessos, modeloCache, &efeito);
 
-				fprintf(output, "0x%08x:bltu %s,%s,0x%03x (0x%08x<0x%08x)=u1->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						(registradores[rs1] < registradores[rs2]) ? pc + imm_b : pc + 4);
+		// Incremento do tempo do CLINT (mtime)
+		m->clint_mtime++;
+		if (m->latencias != NULL)
+			observarPendencias(m->latencias, m, instrucoes);
 
-				if (registradores[rs1] < registradores[rs2])
-				{
-					pc = pc + imm_b;
-					continue;
-				}
-			}
+		// VERIFICAÇÃO DA INTERRUPÇÃO POR TIMER
+		if ((registradoresCSRs[1] & (1 << 7)) && // mie: habilita interrupção de timer
+			(registradoresCSRs[0] & (1 << 3)) && // mstatus: interrupções globais habilitadas
+			(m->clint_mtime >= __atomic_load_n(&m->clint_mtimecmp, __ATOMIC_RELAXED)))	 // mtime atingiu mtimecmp
+		{
+			// Prepara os CSRs para a interrupção
+			registradoresCSRs[4] = 0x80000007; // mcause (bit 31 = 1 indica interrupção, código 7 = timer)
+			registradoresCSRs[3] = pc + 4;	   // mepc = próxima instrução
+			registradoresCSRs[5] = 0x00000000; // mtval = zero em interrupções
 
-			// bgeu (Compara rs1 e rs2 sem sinal. Se rs1 >= rs2, salta para PC + offset)
-			else if (funct3 == 0b111)
+			prepMstatus(&registradoresCSRs[0]);
+
+			if (gatilho != NULL && gatilho->tipo == GATILHO_INTERRUPCAO)
 			{
+				output = dispararGatilho(m);
+				gatilho = NULL;
+			}
+			TRACE(output, ">interrupt:timer               cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
+					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
 
-				fprintf(output, "0x%08x:bgeu %s,%s,0x%03x (0x%08x>=0x%08x)=u1->pc=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rs1],		// Nome do registrador rs1
-						regNomes[rs2],		// Nome do registrador rs2
-						imm_b & 0xFFF,		// imediato do tipo b
-						registradores[rs1], // valor de rs1
-						registradores[rs2], // valor de rs2
-						(registradores[rs1] >= registradores[rs2]) ? pc + imm_b : pc + 4);
+			// Redireciona o PC para mtvec
+			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
+			if (m->estatisticas != NULL)
+				m->estatisticas->interrupcoes[registradoresCSRs[4] & 0xF]++;
+			if (m->pilhaChamadas != NULL)
+				empilharChamada(m->pilhaChamadas, instrucoes, registradoresCSRs[4], 0, 1);
+			if (m->latencias != NULL)
+				entrarTrap(m->latencias, m, registradoresCSRs[4], instrucoes);
 
-				if (registradores[rs1] >= registradores[rs2])
-				{
-					pc = pc + imm_b;
-					continue;
-				}
-			}
-			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
-			else
+			continue;
+		}
+
+		// VERIFICAÇÃO DE INTERRUPÇÃO DE SOFTWARE
+		if ((registradoresCSRs[1] & 0x8) && // mie: software interrupt enable (bit 3)
+			(registradoresCSRs[0] & 0x8) && // mstatus: global interrupt enable (bit 3)
+			(__atomic_load_n(&m->clint_msip, __ATOMIC_RELAXED) & 0x1))				// msip: interrupção de software solicitada
+		{
+			registradoresCSRs[4] = 0x80000003; // mcause: software interrupt
+			registradoresCSRs[3] = pc + 4;	   // mepc: proxima instrução
+			registradoresCSRs[5] = 0;		   // mtval: valor adicional (0 para interrupções)
+
+			prepMstatus(&registradoresCSRs[0]);
+
+			if (gatilho != NULL && gatilho->tipo == GATILHO_INTERRUPCAO)
 			{
-				// preparando mstatus para a excessão
-				prepMstatus(&registradoresCSRs[0]);
-				registrarExcecao(2, pc, instrucao, registradoresCSRs, output, &pc);
-				continue;
+				output = dispararGatilho(m);
+				gatilho = NULL;
 			}
-			break;
+			TRACE(output, ">interrupt:software            cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
+					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
 
-		// tipo jump byte
-		// jal (Salta para PC + offset e armazena PC + 4 em rd)
-		case 0b1101111:
-			// if (opcode == 1101111 ){
+			// IMPORTANTE: Limpar o MSIP para evitar loop infinito
+			__atomic_store_n(&m->clint_msip, 0, __ATOMIC_RELAXED);
 
-			// const int32_t offset = (imm_j << 11) >> 11;
-			const uint32_t campo_imm_j = (imm_j >> 1) & 0xFFFFF;
+			// Redireciona o PC para mtvec
+			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
+			if (m->estatisticas != NULL)
+				m->estatisticas->interrupcoes[registradoresCSRs[4] & 0xF]++;
+			if (m->pilhaChamadas != NULL)
+				empilharChamada(m->pilhaChamadas, instrucoes, registradoresCSRs[4], 0, 1);
+			if (m->latencias != NULL)
+				entrarTrap(m->latencias, m, registradoresCSRs[4], instrucoes);
+			continue;
+		}
 
-			const uint32_t destino = pc + imm_j;
-			const uint32_t retorno = pc + 4;
+		// VERIFICAÇÃO DE INTERRUPÇÃO EXTERNA (PLIC – UART)
+		if ((registradoresCSRs[1] & (1 << 11)) && // mie: external interrupt enable
+			(registradoresCSRs[0] & (1 << 3)) &&  // mstatus: global interrupt enable
+			(m->plic_enable & (1 << 10)) &&		  // UART enable no PLIC
+			(m->plic_pending & (1 << 10)))			  // UART sinalizou interrupção
+		{
+			registradoresCSRs[4] = 0x8000000B; // mcause: 11 = External Interrupt (bit 31 = 1)
+			registradoresCSRs[3] = pc + 4;	   // mepc: próxima instrução
+			registradoresCSRs[5] = 0;		   // mtval: 0 para interrupções
 
-			fprintf(output, "0x%08x:jal %s,0x%05x pc=0x%08x,%s=0x%08x\n",
-					pc,			  // Endereço da instrução
-					regNomes[rd], // Nome do registrador destino
-					campo_imm_j,  // imeadiato do tipo j
-					destino,	  // proxima instrução
-					regNomes[rd], // Nome do registrador destino
-					retorno);
+			prepMstatus(&registradoresCSRs[0]);
 
-			if (rd != 0)
+			if (gatilho != NULL && gatilho->tipo == GATILHO_INTERRUPCAO)
 			{
-				registradores[rd] = retorno;
+				output = dispararGatilho(m);
+				gatilho = NULL;
 			}
+			TRACE(output, ">interrupt:external            cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
+					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
+
+			// Redireciona o PC para mtvec como nas outras interrupções
+			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
+			if (m->estatisticas != NULL)
+				m->estatisticas->interrupcoes[registradoresCSRs[4] & 0xF]++;
+			if (m->pilhaChamadas != NULL)
+				empilharChamada(m->pilhaChamadas, instrucoes, registradoresCSRs[4], 0, 1);
+			if (m->latencias != NULL)
+				entrarTrap(m->latencias, m, registradoresCSRs[4], instrucoes);
+			continue;
+		}
+
+		pc += 4;
+	}
+
+	m->pc = (evento == EVENTO_CSR_INVALIDO) ? pcCsrInvalido : pc;
+	m->instrucoes = instrucoes;
+	return evento;
+}
+
+// executa uma única instrução
+int poximPasso(Maquina *m)
+{
+	return poximExecutar(m, 1);
+}
+
+// ponto de encontro dos harts a cada quantum; harts que terminam saem do grupo
+typedef struct
+{
+	pthread_mutex_t trava;
+	pthread_cond_t liberados;
+	int participantes;
+	int chegaram;
+	uint64_t geracao;
+	int parar; // o hart 0 terminou: os outros saem na próxima sincronização
+	Maquina **harts;
+	int numHarts;
+} SincroniaHarts;
+
+typedef struct
+{
+	SincroniaHarts *sincronia;
+	Maquina *m;
+	uint64_t quantum;
+	uint64_t limite;
+	int evento;
+} ArgumentoHart;
+
+// chamada com a trava, pelo último hart a chegar: todos os outros estão parados,
+// então o mtime pode ser ajustado sem corrida (o tempo nunca volta)
+static void liberarHarts(SincroniaHarts *sincronia)
+{
+	uint64_t mtime = 0;
+	for (int i = 0; i < sincronia->numHarts; i++)
+	{
+		if (sincronia->harts[i]->clint_mtime > mtime)
+			mtime = sincronia->harts[i]->clint_mtime;
+	}
+	for (int i = 0; i < sincronia->numHarts; i++)
+		sincronia->harts[i]->clint_mtime = mtime;
+
+	sincronia->chegaram = 0;
+	sincronia->geracao++;
+	pthread_cond_broadcast(&sincronia->liberados);
+}
+
+// retorna 1 se o hart deve parar porque o hart 0 já terminou
+static int sincronizarHart(SincroniaHarts *sincronia)
+{
+	pthread_mutex_lock(&sincronia->trava);
+	const uint64_t geracao = sincronia->geracao;
+	if (++sincronia->chegaram == sincronia->participantes)
+	{
+		liberarHarts(sincronia);
+	}
+	else
+	{
+		while (sincronia->geracao == geracao)
+			pthread_cond_wait(&sincronia->liberados, &sincronia->trava);
+	}
+	const int parar = sincronia->parar;
+	pthread_mutex_unlock(&sincronia->trava);
+	return parar;
+}
 
-			pc = destino;
-			continue; // para não incrementar o PC após salto
+static void sairSincronia(SincroniaHarts *sincronia, int encerraTodos)
+{
+	pthread_mutex_lock(&sincronia->trava);
+	if (encerraTodos)
+		sincronia->parar = 1;
+	sincronia->participantes--;
+	if (sincronia->participantes > 0 && sincronia->chegaram == sincronia->participantes)
+		liberarHarts(sincronia);
+	pthread_mutex_unlock(&sincronia->trava);
+}
 
-			//}
+static void *executarHart(void *parametro)
+{
+	ArgumentoHart *argumento = parametro;
+	Maquina *m = argumento->m;
+	int evento;
+	while (1)
+	{
+		// roda até o fim do quantum atual (contado nas instruções do próprio hart)
+		uint64_t alvo = (m->instrucoes / argumento->quantum + 1) * argumento->quantum;
+		if (alvo > argumento->limite)
+			alvo = argumento->limite;
 
-			// tipo jump
-			// jalr (Salta para o endereço rs1 + offset e armazena pc + 4 em rd)
-		case 0b1100111:
-			if (funct3 == 0b000)
-			{
-				// const int32_t offset = ((int32_t)instrucao) >> 20;
-				const uint32_t retorno = pc + 4;
-				const uint32_t novo_pc = (registradores[rs1] + imm_i) & ~1;
-				fprintf(output, "0x%08x:jalr %s,%s,0x%03x pc=0x%08x+0x%08x,%s=0x%08x\n",
-						pc,					// Endereço da instrução
-						regNomes[rd],		// Nome do registrador destino
-						regNomes[rs1],		// nome do rs1
-						imm_i & 0xFFF,		// imediato do tipo i
-						registradores[rs1], // valor de rs1
-						imm_i,				// imediato do tipo i
-						regNomes[rd],		// Nome do registrador destino
-						retorno);
+		evento = poximExecutar(m, alvo - m->instrucoes);
+		if (evento == EVENTO_WFI || evento == EVENTO_UART_VAZIA)
+			continue;
+		if (evento != EVENTO_LIMITE || m->instrucoes >= argumento->limite)
+			break;
+		if (sincronizarHart(argumento->sincronia))
+		{
+			evento = EVENTO_NENHUM; // parado pelo fim do hart 0 (ex.: hart secundário preso em wfi)
+			break;
+		}
+	}
+	sairSincronia(argumento->sincronia, m->hartid == 0);
+	argumento->evento = evento;
+	return NULL;
+}
 
-				if (rd != 0)
-				{
-					registradores[rd] = retorno;
-				}
+int poximExecutarHarts(Maquina **harts, int numHarts, uint64_t quantum, uint64_t limite, int *eventos)
+{
+	SincroniaHarts sincronia = {.participantes = numHarts, .harts = harts, .numHarts = numHarts};
+	pthread_mutex_t travaUART;
+	pthread_mutex_init(&sincronia.trava, NULL);
+	pthread_cond_init(&sincronia.liberados, NULL);
+	pthread_mutex_init(&travaUART, NULL);
+
+	pthread_t *threads = calloc(numHarts, sizeof(pthread_t));
+	int *criadas = calloc(numHarts, sizeof(int));
+	ArgumentoHart *argumentos = calloc(numHarts, sizeof(ArgumentoHart));
+	if (threads == NULL || criadas == NULL || argumentos == NULL)
+	{
+		fprintf(stderr, "Sem memória para os harts.\n");
+		return -1;
+	}
 
-				pc = novo_pc;
-				continue;
-			}
+	for (int i = 0; i < numHarts; i++)
+	{
+		harts[i]->numHarts = numHarts;
+		harts[i]->harts = harts;
+		harts[i]->travaUART = &travaUART;
+		argumentos[i] = (ArgumentoHart){&sincronia, harts[i], quantum != 0 ? quantum : 1, limite, EVENTO_NENHUM};
+	}
+	for (int i = 0; i < numHarts; i++)
+	{
+		criadas[i] = pthread_create(&threads[i], NULL, executarHart, &argumentos[i]) == 0;
+		if (!criadas[i])
+		{
+			// o hart fica parado; os outros não esperam por ele nas sincronizações
+			fprintf(stderr, "Não foi possível criar a thread do hart %d.\n", i);
+			sairSincronia(&sincronia, i == 0);
+		}
+	}
+	for (int i = 0; i < numHarts; i++)
+	{
+		if (criadas[i])
+			pthread_join(threads[i], NULL);
+		if (eventos != NULL)
+			eventos[i] = argumentos[i].evento;
+		harts[i]->travaUART = NULL;
+	}
 
-			// tipo Upper immediate
-			// lui (Carrega um valor imediato de 20 bits nos bits mais altos do registrador, os 12 bits inferiores ficam zerados)
-		case 0b0110111:
-			const uint32_t resultado_lui = imm_u;
+	pthread_cond_destroy(&sincronia.liberados);
+	pthread_mutex_destroy(&sincronia.trava);
+	pthread_mutex_destroy(&travaUART);
+	free(threads);
+	free(criadas);
+	free(argumentos);
+	return 0;
+}
 
-			fprintf(output, "0x%08x:lui %s,0x%05x %s=0x%05x000\n",
-					pc,			  // Endereço da instrução
-					regNomes[rd], // nome do registrador de destino
-					imm_u >> 12,  // imediato do tipo u
-					regNomes[rd], // nome do registrador de destino
-					imm_u >> 12); // imediato do tipo u
+// agrupamento dos intervalos de um arquivo BBV (k-means sobre projeções aleatórias, como no SimPoint)
+#define DIMENSOES_PROJECAO 15
+#define SEMENTES_KMEANS 5
 
-			if (rd != 0)
-			{
-				registradores[rd] = resultado_lui;
-			}
+typedef struct
+{
+	uint32_t *ids; // blocos em ordem crescente
+	double *valores; // fração das instruções do intervalo em cada bloco
+	int n;
+	uint64_t instrucoes;
+	double projecao[DIMENSOES_PROJECAO];
+	int grupo;
+} IntervaloBbv;
+
+static int compararIdsBbv(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
 
-			break;
+// coordenada pseudoaleatória em [-1, 1] do bloco id na dimensão d (a mesma em toda execução)
+static double coordenadaProjecao(uint32_t id, int d)
+{
+	uint32_t h = id * 0x9E3779B1u ^ (uint32_t)(d + 1) * 0x85EBCA77u;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return (double)h / 2147483647.5 - 1.0;
+}
 
-			// tipo Upper immediate
-			// auipc (Carrega um valor imediato de 20 bits nos bits mais altos do registrador, os 12 bits inferiores ficam zerados)
-		case 0b0010111:
-			const uint32_t resultado_auipc = pc + imm_u;
+static double distanciaProjecao(const double *a, const double *b)
+{
+	double soma = 0;
+	for (int d = 0; d < DIMENSOES_PROJECAO; d++)
+		soma += (a[d] - b[d]) * (a[d] - b[d]);
+	return soma;
+}
 
-			fprintf(output, "0x%08x:auipc %s,0x%05x %s=0x%08x+0x%05x000=0x%08x\n",
-					pc,			  // Endereço da instrução
-					regNomes[rd], // nome do registrador de destino
-					imm_u >> 12,  // imediato do tipo u
-					regNomes[rd], // nome do registrador de destino
-					pc,			  // Endereço da instrução
-					imm_u >> 12,  // imediato do tipo u
-					resultado_auipc);
+// distância de Manhattan entre dois BBVs normalizados, dividida por 2 (0 = iguais, 1 = sem blocos em comum)
+static double distanciaBbv(const IntervaloBbv *a, const IntervaloBbv *b)
+{
+	double soma = 0;
+	int i = 0, j = 0;
+	while (i < a->n || j < b->n)
+	{
+		if (j == b->n || (i < a->n && a->ids[i] < b->ids[j]))
+			soma += a->valores[i++];
+		else if (i == a->n || b->ids[j] < a->ids[i])
+			soma += b->valores[j++];
+		else
+		{
+			soma += a->valores[i] > b->valores[j] ? a->valores[i] - b->valores[j] : b->valores[j] - a->valores[i];
+			i++;
+			j++;
+		}
+	}
+	return soma / 2;
+}
 
-			if (rd != 0)
+static IntervaloBbv *lerBbv(const char *caminho, int *numIntervalos)
+{
+	FILE *arquivo = fopen(caminho, "r");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir %s.\n", caminho);
+		return NULL;
+	}
+	IntervaloBbv *intervalos = NULL;
+	int quantidade = 0, capacidade = 0;
+	uint64_t *pares = NULL; // id << 32 | instruções, para ordenar por id
+	size_t capacidadePares = 0;
+	char *linha = NULL;
+	size_t tamLinha = 0;
+
+	while (getline(&linha, &tamLinha, arquivo) > 0)
+	{
+		const char *p = strchr(linha, 'T');
+		if (p == NULL)
+			continue;
+		size_t numPares = 0;
+		uint64_t total = 0;
+		unsigned long id, contagem;
+		int lidos;
+		p++;
+		while (sscanf(p, ":%lu:%lu %n", &id, &contagem, &lidos) == 2)
+		{
+			if (numPares == capacidadePares)
 			{
-				registradores[rd] = resultado_auipc;
+				capacidadePares = capacidadePares ? 2 * capacidadePares : 256;
+				pares = realloc(pares, capacidadePares * sizeof(uint64_t));
 			}
-			break;
+			pares[numPares++] = ((uint64_t)id << 32) | (uint32_t)contagem;
+			total += (uint32_t)contagem;
+			p += lidos;
+		}
+		if (numPares == 0 || total == 0)
+			continue;
+		qsort(pares, numPares, sizeof(uint64_t), compararIdsBbv);
 
-			// tipo System
-			// imediato do tipo system
+		if (quantidade == capacidade)
+		{
+			capacidade = capacidade ? 2 * capacidade : 64;
+			intervalos = realloc(intervalos, capacidade * sizeof(IntervaloBbv));
+		}
+		IntervaloBbv *iv = &intervalos[quantidade++];
+		memset(iv, 0, sizeof(*iv));
+		iv->ids = malloc(numPares * sizeof(uint32_t));
+		iv->valores = malloc(numPares * sizeof(double));
+		iv->n = (int)numPares;
+		iv->instrucoes = total;
+		for (size_t i = 0; i < numPares; i++)
+		{
+			iv->ids[i] = (uint32_t)(pares[i] >> 32);
+			iv->valores[i] = (double)(uint32_t)pares[i] / total;
+			for (int d = 0; d < DIMENSOES_PROJECAO; d++)
+				iv->projecao[d] += iv->valores[i] * coordenadaProjecao(iv->ids[i], d);
+		}
+	}
+	free(linha);
+	free(pares);
+	fclose(arquivo);
+	*numIntervalos = quantidade;
+	return intervalos;
+}
 
-		case 0b1110011:
-			uint32_t imm_csr = (instrucao >> 20) & 0xFFF;
-			// ebreak (Interrompe a execução do programa; usada para debug)
-			if (funct3 == 0b000 && imm_i == 1)
+// k-means com inicialização k-means++; retorna a soma das distâncias ao centróide e deixa o grupo em cada intervalo
+static double agruparKmeans(IntervaloBbv *intervalos, int n, int k, uint32_t semente, double (*centroides)[DIMENSOES_PROJECAO])
+{
+	double *distancias = malloc(n * sizeof(double));
+	uint32_t x = semente;
+#define SORTEAR() (x ^= x << 13, x ^= x >> 17, x ^= x << 5, (double)x / 4294967296.0)
+
+	memcpy(centroides[0], intervalos[(int)(SORTEAR() * n)].projecao, sizeof(centroides[0]));
+	for (int c = 1; c < k; c++)
+	{
+		double total = 0;
+		for (int i = 0; i < n; i++)
+		{
+			distancias[i] = distanciaProjecao(intervalos[i].projecao, centroides[0]);
+			for (int j = 1; j < c; j++)
 			{
-				fprintf(output, "0x%08x:ebreak\n", pc);
-				run = 0;
-				continue; // Impede que pc += 4 seja executado
+				const double dj = distanciaProjecao(intervalos[i].projecao, centroides[j]);
+				if (dj < distancias[i])
+					distancias[i] = dj;
 			}
+			total += distancias[i];
+		}
+		double alvo = SORTEAR() * total;
+		int escolhido = n - 1;
+		for (int i = 0; i < n; i++)
+		{
+			alvo -= distancias[i];
+			if (alvo < 0)
+			{
+				escolhido = i;
+				break;
+			}
+		}
+		memcpy(centroides[c], intervalos[escolhido].projecao, sizeof(centroides[c]));
+	}
+#undef SORTEAR
 
-			// Instruções de sistema (CSR + ecall + mret)
-
-			// csrrw (Atualiza CSR com rs1 e salva valor antigo em rd; usada para controle do sistema)
-			else if (funct3 == 0b001)
-			{ // csrrw
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t rs1_val = registradores[rs1];
-				uint32_t valor_antigo = registradoresCSRs[idx];
-
-				if (imm_csr == 0x300)
-				{ // mstatus: tratar só MIE e MPIE
-					const uint32_t MIE = 1 << 3;
-					const uint32_t MPIE = 1 << 7;
-					registradoresCSRs[idx] = (registradoresCSRs[idx] & ~(MIE | MPIE)) | (rs1_val & (MIE | MPIE));
-				}
-				else
+	double soma = 0;
+	for (int iteracao = 0; iteracao < 100; iteracao++)
+	{
+		int mudou = 0;
+		soma = 0;
+		for (int i = 0; i < n; i++)
+		{
+			int melhor = 0;
+			double menor = distanciaProjecao(intervalos[i].projecao, centroides[0]);
+			for (int c = 1; c < k; c++)
+			{
+				const double d = distanciaProjecao(intervalos[i].projecao, centroides[c]);
+				if (d < menor)
 				{
-					registradoresCSRs[idx] = rs1_val;
+					menor = d;
+					melhor = c;
 				}
+			}
+			mudou |= intervalos[i].grupo != melhor;
+			intervalos[i].grupo = melhor;
+			distancias[i] = menor;
+			soma += menor;
+		}
+		if (!mudou && iteracao > 0)
+			break;
 
-				if (rd != 0)
+		for (int c = 0; c < k; c++)
+		{
+			double media[DIMENSOES_PROJECAO] = {0};
+			int membros = 0;
+			for (int i = 0; i < n; i++)
+			{
+				if (intervalos[i].grupo != c)
+					continue;
+				for (int d = 0; d < DIMENSOES_PROJECAO; d++)
+					media[d] += intervalos[i].projecao[d];
+				membros++;
+			}
+			if (membros == 0)
+			{
+				// grupo vazio: recomeça no intervalo mais distante do próprio centróide
+				int longe = 0;
+				for (int i = 1; i < n; i++)
 				{
-					registradores[rd] = valor_antigo;
+					if (distancias[i] > distancias[longe])
+						longe = i;
 				}
-
-				fprintf(output, "0x%08x:csrrw  %s,%s,%s     %s=%s=0x%08x,%s=%s=0x%08x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], regNomes[rs1],
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], regNomes[rs1], rs1_val);
+				memcpy(centroides[c], intervalos[longe].projecao, sizeof(centroides[c]));
+				distancias[longe] = 0;
+				continue;
 			}
+			for (int d = 0; d < DIMENSOES_PROJECAO; d++)
+				centroides[c][d] = media[d] / membros;
+		}
+	}
+	free(distancias);
+	return soma;
+}
 
-			// csrrs (Lê o CSR, salva em rd e faz OR com rs1; usada para ativar bits)
-			else if (funct3 == 0b010)
-			{ // csrrs
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t valor_antigo = registradoresCSRs[idx];
-				uint32_t rs1_val = registradores[rs1];
+// lê o BBV e grava em caminhoPontos os intervalos representativos: "ponto peso distancia membros", com
+// peso = fração das instruções do grupo e distancia = distância BBV média dos membros até o representante
+// (o cabeçalho traz o tamanho do intervalo e a média ponderada dessa distância, uma medida do erro da amostragem)
+int agruparIntervalos(const char *caminhoBbv, const char *caminhoPontos, int k)
+{
+	int n = 0;
+	IntervaloBbv *intervalos = lerBbv(caminhoBbv, &n);
+	if (intervalos == NULL || n == 0)
+	{
+		fprintf(stderr, "Nenhum intervalo em %s.\n", caminhoBbv);
+		free(intervalos);
+		return 1;
+	}
+	if (k < 1)
+		k = 10;
+	if (k > n)
+		k = n;
+
+	// o intervalo é o maior total de uma linha (o último pode estar incompleto)
+	uint64_t tamIntervalo = 0, totalInstrucoes = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (intervalos[i].instrucoes > tamIntervalo)
+			tamIntervalo = intervalos[i].instrucoes;
+		totalInstrucoes += intervalos[i].instrucoes;
+	}
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_antigo;
-				}
+	// várias sementes, fica a de menor soma de distâncias
+	double (*centroides)[DIMENSOES_PROJECAO] = malloc(k * sizeof(*centroides));
+	double (*melhores)[DIMENSOES_PROJECAO] = malloc(k * sizeof(*melhores));
+	int *grupos = malloc(n * sizeof(int));
+	double menorSoma = -1;
+	for (int s = 0; s < SEMENTES_KMEANS; s++)
+	{
+		const double soma = agruparKmeans(intervalos, n, k, 0x2545F491u * (uint32_t)(s + 1), centroides);
+		if (menorSoma < 0 || soma < menorSoma)
+		{
+			menorSoma = soma;
+			memcpy(melhores, centroides, k * sizeof(*centroides));
+			for (int i = 0; i < n; i++)
+				grupos[i] = intervalos[i].grupo;
+		}
+	}
 
-				if (rs1 != 0)
-				{
-					if (imm_csr == 0x300)
-					{ // mstatus
-						// OR apenas nos bits sensíveis
-						const uint32_t MIE = 1 << 3;
-						const uint32_t MPIE = 1 << 7;
-						registradoresCSRs[idx] |= (rs1_val & (MIE | MPIE));
-					}
-					else
-					{
-						registradoresCSRs[idx] |= rs1_val;
-					}
-				}
+	FILE *saida = fopen(caminhoPontos, "w");
+	if (saida == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar os pontos em %s.\n", caminhoPontos);
+		return 1;
+	}
 
-				fprintf(output, "0x%08x:csrrs  %s,%s,%s     %s=%s=0x%08x,%s|=%s=0x%08x|0x%08x=0x%08x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], regNomes[rs1],
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], regNomes[rs1],
-						valor_antigo, rs1_val, valor_antigo | rs1_val);
+	// representante: o membro mais próximo do centróide
+	int *representantes = malloc(k * sizeof(int));
+	double *distanciasGrupo = calloc(k, sizeof(double));
+	uint64_t *instrucoesGrupo = calloc(k, sizeof(uint64_t));
+	int *membros = calloc(k, sizeof(int));
+	for (int c = 0; c < k; c++)
+	{
+		representantes[c] = -1;
+		double menor = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (grupos[i] != c)
+				continue;
+			const double d = distanciaProjecao(intervalos[i].projecao, melhores[c]);
+			if (representantes[c] < 0 || d < menor)
+			{
+				menor = d;
+				representantes[c] = i;
 			}
+		}
+	}
+	double erro = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const int c = grupos[i];
+		const double d = distanciaBbv(&intervalos[i], &intervalos[representantes[c]]);
+		distanciasGrupo[c] += d * intervalos[i].instrucoes;
+		instrucoesGrupo[c] += intervalos[i].instrucoes;
+		membros[c]++;
+		erro += d * intervalos[i].instrucoes;
+	}
 
-			// csrrc (Lê o CSR, salva valor antigo em rd e zera bits indicados por rs1; usada para desativar bits)
-			else if (funct3 == 0b011)
-			{ // csrrc
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t valor_antigo = registradoresCSRs[idx];
-				uint32_t rs1_val = registradores[rs1];
+	fprintf(saida, "# intervalo=%llu intervalos=%d k=%d instrucoes=%llu distancia_bbv=%.4f\n",
+			(unsigned long long)tamIntervalo, n, k, (unsigned long long)totalInstrucoes, erro / totalInstrucoes);
+	fputs("# ponto peso distancia membros\n", saida);
+	for (int i = 0; i < n; i++) // em ordem de intervalo
+	{
+		const int c = grupos[i];
+		if (representantes[c] != i)
+			continue;
+		fprintf(saida, "%d %.6f %.4f %d\n", i, (double)instrucoesGrupo[c] / totalInstrucoes,
+				distanciasGrupo[c] / instrucoesGrupo[c], membros[c]);
+	}
+	fclose(saida);
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_antigo;
-				}
+	for (int i = 0; i < n; i++)
+	{
+		free(intervalos[i].ids);
+		free(intervalos[i].valores);
+	}
+	free(intervalos);
+	free(centroides);
+	free(melhores);
+	free(grupos);
+	free(representantes);
+	free(distanciasGrupo);
+	free(instrucoesGrupo);
+	free(membros);
+	return 0;
+}
 
-				if (rs1 != 0)
-				{
-					if (imm_csr == 0x300)
-					{ // mstatus
-						// Apenas bits sensíveis (MIE e MPIE)
-						const uint32_t MIE = 1 << 3;
-						const uint32_t MPIE = 1 << 7;
-						registradoresCSRs[idx] &= ~(rs1_val & (MIE | MPIE));
-					}
-					else
-					{
-						registradoresCSRs[idx] &= ~rs1_val;
-					}
-				}
+// executa até a máquina chegar a "alvo" instruções; 0 = chegou, senão o código de saída do programa que terminou antes
+static int avancarAte(Maquina *m, uint64_t alvo)
+{
+	while (m->instrucoes < alvo)
+	{
+		const int evento = poximExecutar(m, alvo - m->instrucoes);
+		if (evento == EVENTO_LIMITE || evento == EVENTO_WFI || evento == EVENTO_UART_VAZIA)
+			continue;
+		return codigoEvento(evento) != 0 ? codigoEvento(evento) : -1; // -1 = ebreak antes do alvo
+	}
+	return 0;
+}
 
-				fprintf(output, "0x%08x:csrrc  %s,%s,%s     %s=%s=0x%08x,%s&=~%s=0x%08x&~0x%08x=0x%08x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], regNomes[rs1],
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], regNomes[rs1],
-						valor_antigo, rs1_val, valor_antigo & ~rs1_val);
-			}
+#define MAX_PONTOS_AMOSTRA 1024
 
-			// csrrwi (Escreve um imediato no CSR e salva valor antigo em rd; usado para controle do sistema)
-			else if (funct3 == 0b101)
-			{ // csrrwi
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t imm_val = rs1 & 0x1F; // imediato de 5 bits
-				uint32_t valor_antigo = registradoresCSRs[idx];
+// corpo de executarAmostrado; modeloCache/modeloPipeline são os modelos do chamador, ligados só nos intervalos
+static int rodarAmostrado(Maquina *m, const char *caminhoPontos, const char *caminhoSaida, FILE *resultados,
+						  uint64_t aquecimento, ModeloCache *modeloCache, ModeloPipeline *modeloPipeline)
+{
+	FILE *arquivo = fopen(caminhoPontos, "r");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir %s.\n", caminhoPontos);
+		return 1;
+	}
+	unsigned long long intervalo = 0;
+	double distancia = 0;
+	int pontos[MAX_PONTOS_AMOSTRA];
+	double pesos[MAX_PONTOS_AMOSTRA];
+	int numPontos = 0;
+	char linha[512];
+	while (fgets(linha, sizeof(linha), arquivo) != NULL)
+	{
+		if (linha[0] == '#')
+		{
+			if (strncmp(linha, "# intervalo=", 12) == 0)
+				sscanf(linha, "# intervalo=%llu %*s %*s %*s distancia_bbv=%lf", &intervalo, &distancia);
+			continue;
+		}
+		int ponto;
+		double peso;
+		if (sscanf(linha, "%d %lf", &ponto, &peso) != 2)
+			continue;
+		if (numPontos == MAX_PONTOS_AMOSTRA)
+		{
+			fprintf(stderr, "Aviso: só os primeiros %d pontos de %s são usados.\n", MAX_PONTOS_AMOSTRA, caminhoPontos);
+			break;
+		}
+		pontos[numPontos] = ponto;
+		pesos[numPontos] = peso;
+		numPontos++;
+	}
+	fclose(arquivo);
+	if (intervalo == 0 || numPontos == 0)
+	{
+		fprintf(stderr, "Arquivo de pontos inválido: %s.\n", caminhoPontos);
+		return 1;
+	}
 
-				// Tratamento especial para mstatus
-				if (imm_csr == 0x300)
-				{
-					const uint32_t MIE = 1 << 3;
-					const uint32_t MPIE = 1 << 7;
+	// o nome do snapshot leva o começo do aquecimento e a imagem de partida: um snapshot de outro aquecimento ou de
+	// outro programa nunca é reaproveitado, é gravado de novo
+	const uint64_t imagem = hashConteudo(m->mem, TAM_MEMORIA) ^ ((uint64_t)m->pc << 32) ^ m->instrucoes;
 
-					// Altera apenas MIE e MPIE
-					registradoresCSRs[idx] = (valor_antigo & ~(MIE | MPIE)) | (imm_val & (MIE | MPIE));
-				}
-				else
-				{
-					registradoresCSRs[idx] = imm_val;
-				}
+	// os modelos e o trace ficam desligados enquanto a máquina só avança
+	m->modeloCache = NULL;
+	m->modeloPipeline = NULL;
+	m->saida = NULL;
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_antigo;
-				}
+	// primeira fase: snapshots que ainda não existem, numa única passada
+	char caminho[4200];
+	for (int i = 0; i < numPontos; i++)
+	{
+		const uint64_t inicio = (uint64_t)pontos[i] * intervalo;
+		const uint64_t inicioAquecimento = inicio > aquecimento ? inicio - aquecimento : 0;
+		snprintf(caminho, sizeof(caminho), "%s.%d.%llu.%016llx.snap", caminhoPontos, pontos[i],
+				 (unsigned long long)inicioAquecimento, (unsigned long long)imagem);
+		if (access(caminho, R_OK) == 0)
+			continue;
+		if (m->instrucoes > inicioAquecimento)
+		{
+			fprintf(stderr, "Pontos fora de ordem em %s.\n", caminhoPontos);
+			return 1;
+		}
+		if (avancarAte(m, inicioAquecimento) != 0)
+		{
+			fprintf(stderr, "O programa terminou antes do ponto %d.\n", pontos[i]);
+			return 1;
+		}
+		if (poximSalvarSnapshot(m, caminho) != 0)
+			return 1;
+	}
+
+	// segunda fase: cada ponto em detalhe a partir do seu snapshot
+	m->modeloCache = modeloCache;
+	m->modeloPipeline = modeloPipeline;
+	double cpi = 0, pesoTotal = 0;
+	fprintf(resultados, "# intervalo=%llu aquecimento=%llu distancia_bbv=%.4f\n# ponto peso instrucoes ciclos cpi\n",
+			intervalo, (unsigned long long)aquecimento, distancia);
+	for (int i = 0; i < numPontos; i++)
+	{
+		const uint64_t inicio = (uint64_t)pontos[i] * intervalo;
+		const uint64_t inicioAquecimento = inicio > aquecimento ? inicio - aquecimento : 0;
+		snprintf(caminho, sizeof(caminho), "%s.%d.%llu.%016llx.snap", caminhoPontos, pontos[i],
+				 (unsigned long long)inicioAquecimento, (unsigned long long)imagem);
+		if (poximRestaurarSnapshot(m, caminho) != 0)
+			return 1;
+		if (m->instrucoes != inicioAquecimento)
+		{
+			fprintf(stderr, "O snapshot %s não está no começo do aquecimento do ponto %d.\n", caminho, pontos[i]);
+			return 1;
+		}
+
+		m->saida = NULL;
+		zerarModelos(m, 1);
+		if (avancarAte(m, inicio) != 0)
+		{
+			fprintf(stderr, "Aviso: o programa terminou no aquecimento do ponto %d; o ponto foi ignorado.\n", pontos[i]);
+			continue;
+		}
+		zerarModelos(m, 0);
+
+		snprintf(caminho, sizeof(caminho), "%s.ponto%d", caminhoSaida, pontos[i]);
+		m->saida = fopen(caminho, "w");
+		if (m->saida == NULL)
+		{
+			fprintf(stderr, "Não foi possível gravar o trace em %s.\n", caminho);
+			return 1;
+		}
+		const uint64_t antes = m->instrucoes;
+		avancarAte(m, inicio + intervalo);
+		const uint64_t executadas = m->instrucoes - antes;
+		fclose(m->saida);
+		m->saida = NULL;
+
+		// sem modelo de tempo, ciclosModelados conta instruções desde o começo do programa
+		const uint64_t ciclos = (modeloCache != NULL || modeloPipeline != NULL) ? ciclosModelados(m) : executadas;
+		const double cpiPonto = executadas ? (double)ciclos / executadas : 0.0;
+		fprintf(resultados, "%d %.6f %llu %llu %.4f\n", pontos[i], pesos[i], (unsigned long long)executadas,
+				(unsigned long long)ciclos, cpiPonto);
+		cpi += pesos[i] * cpiPonto;
+		pesoTotal += pesos[i];
+	}
+	fprintf(resultados, "# cpi_estimado=%.4f peso_coberto=%.4f\n", pesoTotal > 0 ? cpi / pesoTotal : 0.0, pesoTotal);
+	return 0;
+}
 
-				fprintf(output,"0x%08x:csrrwi %s,%s,%u     %s=%s=0x%08x,%s=u5=0x%07x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], imm_val,
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], imm_val);
+// simulação amostrada: avança sem trace nem modelos de tempo até cada ponto de caminhoPontos (gravando um snapshot
+// "<pontos>.<ponto>.<início do aquecimento>.<imagem>.snap", reaproveitado nas execuções seguintes) e roda em detalhe
+// só os intervalos escolhidos, a partir do snapshot: trace em "<saida>.ponto<ponto>" e os modelos de tempo ligados
+// (caches/pipeline), precedidos de "aquecimento" instruções sem trace que só aquecem caches e preditor
+// grava em resultados "ponto peso instrucoes ciclos cpi" e a estimativa ponderada do CPI do programa inteiro;
+// o trace, os modelos e a saída UART da máquina voltam a ser os do chamador no fim, também em caso de erro
+int executarAmostrado(Maquina *m, const char *caminhoPontos, const char *caminhoSaida, FILE *resultados,
+					  uint64_t aquecimento)
+{
+	ModeloCache *modeloCache = m->modeloCache;
+	ModeloPipeline *modeloPipeline = m->modeloPipeline;
+	FILE *trace = m->saida;
+	FILE *saidaUART = m->saidaUART;
+	m->saidaUART = fopen("/dev/null", "w"); // a restauração cortaria a saída UART no ponto de cada snapshot
+
+	int codigo = 1;
+	if (m->saidaUART == NULL)
+		fprintf(stderr, "Não foi possível abrir /dev/null.\n");
+	else
+		codigo = rodarAmostrado(m, caminhoPontos, caminhoSaida, resultados, aquecimento, modeloCache, modeloPipeline);
+
+	if (m->saida != NULL && m->saida != trace) // trace de um ponto interrompido por erro
+		fclose(m->saida);
+	if (m->saidaUART != NULL)
+		fclose(m->saidaUART);
+	m->modeloCache = modeloCache;
+	m->modeloPipeline = modeloPipeline;
+	m->saida = trace;
+	m->saidaUART = saidaUART;
+	return codigo;
+}
 
-			}
+// modo fuzz: fila de entradas guiada pela cobertura de arestas, como no AFL
+typedef struct
+{
+	uint8_t *dados;
+	size_t tamanho;
+} EntradaFuzz;
 
-			// csrrsi (Faz OR entre CSR e valor imediato, salvando valor antigo em rd; usada para ativar bits)
-			else if (funct3 == 0b110)
-			{ // csrrsi
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t imm_val = rs1 & 0x1F; // zimm: imediato no campo rs1
-				uint32_t valor_antigo = registradoresCSRs[idx];
+typedef struct
+{
+	EntradaFuzz *entradas;
+	int num;
+	int capacidade;
+	uint8_t visto[TAM_MAPA_COBERTURA];			  // classes de contagem já vistas por aresta (um bit por classe do AFL)
+	uint8_t vistoTravamentos[TAM_MAPA_COBERTURA]; // o mesmo, só nas execuções que travaram
+} FilaFuzz;
+
+static uint32_t sortearFuzz(uint32_t *estado)
+{
+	uint32_t x = *estado;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *estado = x;
+}
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_antigo;
-				}
+// junta a cobertura da última execução à já vista; devolve 1 se apareceu aresta nova ou, sem soArestas, classe de
+// contagem nova
+static int juntarCobertura(uint8_t *visto, const uint8_t *mapa, int soArestas)
+{
+	int nova = 0;
+	for (uint32_t i = 0; i < TAM_MAPA_COBERTURA; i += 8)
+	{
+		uint64_t palavra;
+		memcpy(&palavra, mapa + i, 8);
+		if (palavra == 0)
+			continue;
+		for (uint32_t j = i; j < i + 8; j++)
+		{
+			const uint8_t n = mapa[j];
+			if (n == 0)
+				continue;
+			const uint8_t classe = soArestas ? 1
+								   : (n <= 3)	 ? 1u << (n - 1)
+								   : (n <= 7)	 ? 8
+								   : (n <= 15)	 ? 16
+								   : (n <= 31)	 ? 32
+								   : (n <= 127) ? 64
+												 : 128;
+			if (classe & ~visto[j])
+			{
+				visto[j] |= classe;
+				nova = 1;
+			}
+		}
+	}
+	return nova;
+}
 
-				if (imm_val != 0)
-				{
-					if (imm_csr == 0x300)
-					{ // mstatus
-						const uint32_t MIE = 1 << 3;
-						const uint32_t MPIE = 1 << 7;
-						registradoresCSRs[idx] |= (imm_val & (MIE | MPIE));
-					}
-					else
-					{
-						registradoresCSRs[idx] |= imm_val;
-					}
-				}
+static int gravarEntradaFuzz(const char *caminho, const uint8_t *dados, size_t tamanho)
+{
+	FILE *arquivo = fopen(caminho, "wb");
+	if (arquivo == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar %s.\n", caminho);
+		return -1;
+	}
+	fwrite(dados, 1, tamanho, arquivo);
+	fclose(arquivo);
+	return 0;
+}
 
-				fprintf(output, "0x%08x:csrrsi %s,%s,%u      %s=%s=0x%08x,%s|=u5=0x%08x|0x%08x=0x%08x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], imm_val,
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], valor_antigo, imm_val, registradoresCSRs[idx]);
+static void adicionarEntradaFuzz(FilaFuzz *fila, const uint8_t *dados, size_t tamanho)
+{
+	if (fila->num == fila->capacidade)
+	{
+		fila->capacidade = fila->capacidade ? 2 * fila->capacidade : 64;
+		fila->entradas = realloc(fila->entradas, fila->capacidade * sizeof(EntradaFuzz));
+	}
+	EntradaFuzz *e = &fila->entradas[fila->num++];
+	e->dados = malloc(tamanho + 1);
+	memcpy(e->dados, dados, tamanho);
+	e->tamanho = tamanho;
+}
 
+// aplica de 1 a 8 mutações do havoc do AFL; devolve o novo tamanho (no máximo tamMaximo)
+static size_t mutarEntrada(uint8_t *dados, size_t tamanho, size_t tamMaximo, const FilaFuzz *fila, uint32_t *semente)
+{
+	static const uint8_t interessantes[] = {0x00, 0x01, 0x7F, 0x80, 0xFF, '\n', '\r', ' ', '0', '9', 'A', 'z', '%'};
+	const int mutacoes = 1 + sortearFuzz(semente) % 8;
+	for (int k = 0; k < mutacoes; k++)
+	{
+		const uint32_t sorteio = sortearFuzz(semente);
+		const size_t pos = tamanho ? sortearFuzz(semente) % tamanho : 0;
+		switch (sorteio % 8)
+		{
+		case 0: // inverte um bit
+			if (tamanho)
+				dados[pos] ^= 1u << (sorteio >> 8 & 7);
+			break;
+		case 1: // byte aleatório
+			if (tamanho)
+				dados[pos] = sorteio >> 8;
+			break;
+		case 2: // byte interessante
+			if (tamanho)
+				dados[pos] = interessantes[(sorteio >> 8) % sizeof(interessantes)];
+			break;
+		case 3: // soma ou subtrai até 16
+			if (tamanho)
+				dados[pos] += (sorteio >> 8 & 1) ? 1 + (sorteio >> 9) % 16 : -(1 + (sorteio >> 9) % 16);
+			break;
+		case 4: // insere um byte
+			if (tamanho < tamMaximo)
+			{
+				memmove(dados + pos + 1, dados + pos, tamanho - pos);
+				dados[pos] = (sorteio >> 8 & 1) ? interessantes[(sorteio >> 9) % sizeof(interessantes)] : sorteio >> 16;
+				tamanho++;
+			}
+			break;
+		case 5: // remove um trecho
+			if (tamanho)
+			{
+				const size_t n = 1 + (sorteio >> 8) % (tamanho - pos < 16 ? tamanho - pos : 16);
+				memmove(dados + pos, dados + pos + n, tamanho - pos - n);
+				tamanho -= n;
+			}
+			break;
+		case 6: // duplica um trecho
+			if (tamanho && tamanho < tamMaximo)
+			{
+				size_t n = 1 + (sorteio >> 8) % (tamanho - pos < 32 ? tamanho - pos : 32);
+				if (n > tamMaximo - tamanho)
+					n = tamMaximo - tamanho;
+				memmove(dados + pos + n, dados + pos, tamanho - pos);
+				tamanho += n;
 			}
+			break;
+		case 7: // emenda: a partir de pos, o final de outra entrada da fila
+		{
+			const EntradaFuzz *outra = &fila->entradas[(sorteio >> 8) % fila->num];
+			if (outra->tamanho == 0)
+				break;
+			const size_t inicio = sortearFuzz(semente) % outra->tamanho;
+			size_t n = outra->tamanho - inicio;
+			if (n > tamMaximo - pos)
+				n = tamMaximo - pos;
+			memcpy(dados + pos, outra->dados + inicio, n);
+			tamanho = pos + n;
+			break;
+		}
+		}
+	}
+	return tamanho;
+}
 
-			// csrrci (Desativa bits do CSR com imediato e salva valor antigo em rd; usada para controle do sistema)
-			else if (funct3 == 0b111)
-			{ // csrrci
-				int idx = csrIndex(imm_csr);
-				if (idx == -1)
-				{
-					fprintf(stderr, "CSR 0x%03x não suportado.\n", imm_csr);
-					run = 0; // ou continue;
-					break;	 // depende da estrutura do seu código
-				}
-				uint32_t valor_antigo = registradoresCSRs[idx];
-				uint32_t imm_val = rs1 & 0x1F; // zimm
+// roda a imagem até logo antes da primeira leitura da UART (a inicialização não se repete) e daí faz o fuzzing em
+// processo das entradas da UART: parte das entradas de dirCorpus (ou de uma entrada vazia), guarda em
+// dirSaida/fila as que trazem cobertura nova, em dirSaida/falhas uma entrada por causa e pc de falha (exceção que não
+// seja ecall, CSR não suportado, pc fora da RAM) e em dirSaida/travamentos as que esgotam o orçamento passando por
+// aresta que nenhum travamento anterior passou;
+// dirSaida/resumo recebe as falhas, os travamentos e a velocidade
+int executarFuzz(const char *caminhoImagem, const char *dirSaida, const char *dirCorpus, uint64_t iteracoes,
+				 uint64_t orcamento, size_t tamMaximo, uint32_t semente, uint64_t limite)
+{
+	Maquina *m = poximCriar();
+	if (m == NULL || poximCarregarImagem(m, caminhoImagem) != 0)
+		return 1;
+
+	// a primeira passada acha a instrução que encontrou a UART vazia; a segunda repete a inicialização (determinística,
+	// a entrada é vazia) até logo antes dela, então toda entrada começa pela própria consulta à UART
+	static uint8_t vazia[1];
+	uint64_t alvo = (limite != UINT64_MAX) ? limite : 100000000;
+	for (int passada = 0; passada < 2; passada++)
+	{
+		if (passada == 1)
+		{
+			poximReiniciar(m);
+			if (poximCarregarImagem(m, caminhoImagem) != 0)
+				return 1;
+		}
+		m->entradaUART = fmemopen(vazia, 0, "r");
+		m->saidaUART = fopen("/dev/null", "w");
+		int evento;
+		do
+			evento = poximExecutar(m, alvo - m->instrucoes);
+		while (evento == EVENTO_WFI);
+		fclose(m->entradaUART);
+		fclose(m->saidaUART);
+		m->entradaUART = m->saidaUART = NULL;
+		if (passada == 0 && evento != EVENTO_UART_VAZIA)
+		{
+			fprintf(stderr, "O programa terminou sem ler a UART (codigo=%d, %llu instruções); não há o que variar.\n",
+					codigoEvento(evento), (unsigned long long)m->instrucoes);
+			return 1;
+		}
+		alvo = m->instrucoes - 1;
+	}
 
-				if (rd != 0)
-				{
-					registradores[rd] = valor_antigo;
-				}
+	Fuzzer *f = poximCriarFuzzer(m, orcamento);
+	FilaFuzz *fila = calloc(1, sizeof(FilaFuzz));
+	uint8_t *atual = malloc(tamMaximo + 1);
+	if (f == NULL || fila == NULL || atual == NULL)
+		return 1;
 
-				if (imm_val != 0)
-				{
-					if (imm_csr == 0x300)
-					{ // mstatus
-						const uint32_t MIE = 1 << 3;
-						const uint32_t MPIE = 1 << 7;
-						registradoresCSRs[idx] &= ~(imm_val & (MIE | MPIE));
-					}
-					else
-					{
-						registradoresCSRs[idx] &= ~imm_val;
-					}
-				}
+	char caminho[4200];
+	mkdir(dirSaida, 0755);
+	const char *subdiretorios[] = {"fila", "falhas", "travamentos"};
+	for (int i = 0; i < 3; i++)
+	{
+		snprintf(caminho, sizeof(caminho), "%s/%s", dirSaida, subdiretorios[i]);
+		mkdir(caminho, 0755);
+	}
 
-				fprintf(output, "0x%08x:csrrci %s,%s,%u      %s=%s=0x%08x,%s&~=u5=0x%08x&~0x%08x=0x%08x\n",
-						pc,
-						regNomes[rd], regNomesCSRs[idx], imm_val,
-						regNomes[rd], regNomesCSRs[idx], valor_antigo,
-						regNomesCSRs[idx], valor_antigo, imm_val, registradoresCSRs[idx]);
+	// entradas iniciais
+	DIR *corpus = (dirCorpus != NULL && dirCorpus[0] != '\0') ? opendir(dirCorpus) : NULL;
+	if (dirCorpus != NULL && dirCorpus[0] != '\0' && corpus == NULL)
+	{
+		fprintf(stderr, "Não foi possível abrir o corpus %s.\n", dirCorpus);
+		return 1;
+	}
+	for (struct dirent *d; corpus != NULL && (d = readdir(corpus)) != NULL;)
+	{
+		snprintf(caminho, sizeof(caminho), "%s/%s", dirCorpus, d->d_name);
+		FILE *arquivo = (d->d_name[0] != '.') ? fopen(caminho, "rb") : NULL;
+		if (arquivo == NULL)
+			continue;
+		const size_t tamanho = fread(atual, 1, tamMaximo, arquivo);
+		fclose(arquivo);
+		adicionarEntradaFuzz(fila, atual, tamanho);
+	}
+	if (corpus != NULL)
+		closedir(corpus);
+	if (fila->num == 0)
+		adicionarEntradaFuzz(fila, vazia, 0);
 
-			}
+	typedef struct
+	{
+		uint64_t chave; // falhas: causa << 32 | pc; travamentos: o pc onde o orçamento acabou
+		int falha;
+		uint64_t execucao;
+	} Achado;
+	Achado achados[256];
+	int numAchados = 0, falhas = 0, travamentos = 0;
+
+	struct timespec inicio;
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	const int numIniciais = fila->num;
+	uint64_t execucoes = 0, instrucoes = 0;
+	for (uint64_t i = 0; i < numIniciais + iteracoes; i++)
+	{
+		size_t tamanho;
+		if (i < (uint64_t)numIniciais)
+		{
+			tamanho = fila->entradas[i].tamanho;
+			memcpy(atual, fila->entradas[i].dados, tamanho);
+		}
+		else
+		{
+			const EntradaFuzz *base = &fila->entradas[sortearFuzz(&semente) % fila->num];
+			memcpy(atual, base->dados, base->tamanho);
+			tamanho = mutarEntrada(atual, base->tamanho, tamMaximo, fila, &semente);
+		}
 
-			// ecall (Solicita serviço ao sistema; gera uma exceção para tratar chamada de ambiente)
-			else if (funct3 == 0b000 && imm_i == 0)
-			{
-				fprintf(output, "0x%08x:ecall\n", pc);
-				// preparando mstatus para a excessão
-				prepMstatus(&registradoresCSRs[0]);
-				registrarExcecao(11, pc, instrucao, registradoresCSRs, output, &pc); // 11 = código de exceção para ECALL
+		ResultadoFuzz r;
+		const int tipo = poximExecutarFuzz(f, atual, tamanho, &r);
+		if (tipo < 0)
+			return 1;
+		execucoes++;
+		instrucoes += r.instrucoes;
 
-				continue; // Pula o pc += 4 no final do loop
-			}
+		if (juntarCobertura(fila->visto, poximCoberturaFuzz(f), 0) && i >= (uint64_t)numIniciais)
+		{
+			adicionarEntradaFuzz(fila, atual, tamanho);
+			snprintf(caminho, sizeof(caminho), "%s/fila/%06d", dirSaida, fila->num - 1);
+			gravarEntradaFuzz(caminho, atual, tamanho);
+		}
+		if (tipo == FUZZ_OK)
+			continue;
 
-			// mret (Retorna do modo de exceção para o ponto onde o programa foi interrompido)
-			else if (funct3 == 0b000 && imm_i == 0x302)
-			{
-				int idx_mepc = csrIndex(833);	 // mepc
-				int idx_mstatus = csrIndex(768); // mstatus
+		// falhas iguais têm a mesma causa e pc; um travamento é novo se passou por aresta que nenhum outro passou
+		const uint64_t chave = (tipo == FUZZ_FALHA) ? ((uint64_t)r.causa << 32 | r.pc) : r.pc;
+		int repetido = 0;
+		if (tipo == FUZZ_FALHA)
+		{
+			for (int j = 0; j < numAchados && !repetido; j++)
+				repetido = achados[j].falha && achados[j].chave == chave;
+		}
+		else
+			repetido = !juntarCobertura(fila->vistoTravamentos, poximCoberturaFuzz(f), 1);
+		if (repetido || numAchados == 256)
+			continue;
+		achados[numAchados++] = (Achado){chave, tipo == FUZZ_FALHA, execucoes};
+		if (tipo == FUZZ_FALHA)
+		{
+			snprintf(caminho, sizeof(caminho), "%s/falhas/causa-%x_pc-%08x", dirSaida, r.causa, r.pc);
+			falhas++;
+		}
+		else
+		{
+			snprintf(caminho, sizeof(caminho), "%s/travamentos/%06d_pc-%08x", dirSaida, travamentos, r.pc);
+			travamentos++;
+		}
+		gravarEntradaFuzz(caminho, atual, tamanho);
+	}
+	const double segundos = segundosDesde(&inicio);
+	uint32_t arestas = 0;
+	for (uint32_t i = 0; i < TAM_MAPA_COBERTURA; i++)
+		arestas += fila->visto[i] != 0;
+
+	snprintf(caminho, sizeof(caminho), "%s/resumo", dirSaida);
+	FILE *resumo = fopen(caminho, "w");
+	if (resumo == NULL)
+	{
+		fprintf(stderr, "Não foi possível gravar %s.\n", caminho);
+		resumo = stderr;
+	}
+	for (int j = 0; j < numAchados; j++)
+	{
+		const uint32_t causa = achados[j].chave >> 32, pc = (uint32_t)achados[j].chave;
+		if (achados[j].falha)
+			fprintf(resumo, "FALHA causa=0x%08x (%s) pc=0x%08x execucao=%llu\n", causa, nomeExcecao(causa), pc,
+					(unsigned long long)achados[j].execucao);
+		else
+			fprintf(resumo, "TRAVAMENTO pc=0x%08x execucao=%llu\n", pc, (unsigned long long)achados[j].execucao);
+	}
+	fprintf(resumo, "# execucoes=%llu tempo=%.3fs execucoes_s=%.0f instrucoes=%llu fila=%d arestas=%u falhas=%d travamentos=%d\n",
+			(unsigned long long)execucoes, segundos, segundos > 0 ? execucoes / segundos : 0.0,
+			(unsigned long long)instrucoes, fila->num, arestas, falhas, travamentos);
+	if (resumo != stderr)
+		fclose(resumo);
+
+	for (int i = 0; i < fila->num; i++)
+		free(fila->entradas[i].dados);
+	free(fila->entradas);
+	free(fila);
+	free(atual);
+	poximDestruirFuzzer(f);
+	poximDestruir(m);
+	return falhas != 0;
+}
 
-				uint32_t mepc = registradoresCSRs[idx_mepc];
-				uint32_t mstatus = registradoresCSRs[idx_mstatus];
+#ifndef POXIMV2_BIBLIOTECA
+int main(int argc, char *argv[])
+{ // argumento para abrir o projeto no terminal, entrega a entrada e fala a saida
+  // "./meuprograma" "entrada.hex"  "saida.out" [opções]
+  // opções:
+  //   --salvar=arquivo      grava um snapshot da máquina e encerra
+  //   --salvar-em=N         ... depois de N instruções (sem ela, logo depois do primeiro ebreak)
+  //   --restaurar=arquivo   começa do snapshot em vez da imagem de entrada (que é ignorada)
+  //   --fork-server=lista   no mesmo ponto (--fork-em=N ou primeiro ebreak), cria um processo filho por entrada UART listada
+  //   --fork-paralelo=K     número de filhos simultâneos (padrão: número de CPUs)
+  //   --limite=N            encerra a execução depois de N instruções
+  //   --checkpoint=prefixo  grava checkpoints periódicos sem parar: prefixo.0 completo e prefixo.1, prefixo.2, ...
+  //   --checkpoint-cada=N   ... a cada N instruções, só com as páginas escritas desde o anterior
+  //   --lote=K              modo lote: "entrada" é um manifesto de tarefas e "saida" recebe os resultados,
+  //                         executados em K threads (0 = número de CPUs); vale com --limite
+  //   --lote-trace=dir      ... grava o trace de cada tarefa em dir/<tarefa>.saida (sem ela, o trace é descartado)
+  //   --frota=N             como --lote, mas todas as tarefas intercaladas em uma única thread, N instruções por fatia
+  //   --harts=N             N harts compartilhando a memória, cada um em uma thread; o trace do hart i > 0 vai para saida.hart<i>
+  //   --quantum=N           ... instruções entre as sincronizações de mtime entre os harts (padrão 1000)
+  //   --lockstep=lista      roda a imagem uma vez por linha da lista ("entradaUART [endereco=valor ...]"), até 64 pistas
+  //                         em lockstep vetorial; grava "<lista>.resultados" como --fork-server ("saida" não é usado)
+  //   --perfil=arquivo      amostra o pc e grava no fim os endereços, blocos e funções mais executados
+  //                         (independe do trace: "saida" pode ser /dev/null)
+  //   --perfil-cada=N       ... uma amostra a cada N instruções (padrão 1000)
+  //   --perfil-mapa=arquivo símbolos de um mapa "endereco [tipo] nome" (nm), além dos do ELF (--perfil e --pilha)
+  //   --pilha=arquivo       pilha de chamadas sombra: grava no fim as instruções por caminho de chamadas no formato
+  //                         folded (flame graph) e em arquivo.caminhos as contagens inclusivas/exclusivas
+  //   --estatisticas=arquivo  instruções por mnemônico, desvios tomados, loads/stores por região, exceções e
+  //                         interrupções, gravadas no fim em JSON (ou CSV se o arquivo termina em .csv)
+  //   --latencias=arquivo   para cada trap: instruções e ticks de mtime entre a fonte ficar pendente e o trap ser tomado,
+  //                         e entre o trap e o mret; histogramas em JSON gravados no fim
+  //   --acessos=arquivo     leituras/escritas por bloco de 64 bytes da RAM e por registrador MMIO: mapa de calor,
+  //                         blocos, registradores e curva do conjunto de trabalho, gravados no fim
+  //   --acessos-cada=N      ... uma amostra do conjunto de trabalho a cada N instruções (padrão 10000)
+  //   --caches=arquivo      modelo de caches L1 de instruções e de dados; grava no fim acessos, faltas e ciclos estimados
+  //                         (os contadores também ficam em mhpmcounter3..31, eventos HPM_ICACHE_* / HPM_DCACHE_*)
+  //   --icache=t,v,l[,p]    ... tamanho, vias, linha em bytes e política (lru, fifo, aleatoria) da cache de instruções
+  //   --dcache=t,v,l[,p]    ... o mesmo para a cache de dados (padrão das duas: 4096,2,32,lru)
+  //   --cache-penalidade=N  ... ciclos por falta e por linha suja escrita de volta (padrão 10)
+  //   --pipeline=arquivo    modelo de tempo de um pipeline de 5 estágios em ordem; grava no fim CPI, bolhas por causa
+  //                         (load-uso, mul/div, desvios, traps, caches) e erros de previsão
+  //   --preditor=nome[,bits] ... estatico, bimodal ou gshare, com 2^bits contadores (padrão bimodal,10)
+  //   --latencia-mul=N      ... ciclos de mul/mulh* (padrão 3)
+  //   --latencia-div=N      ... ciclos de div/rem* (padrão 20)
+  //   --bbv=arquivo         vetores de blocos básicos (formato do SimPoint) a cada --bbv-intervalo=N instruções (padrão 100000)
+  //   --agrupar=K           modo de agrupamento: "entrada" é um arquivo BBV e "saida" recebe até K pontos representativos
+  //                         (k-means), com peso e distância BBV média ao representante (padrão 10)
+  //   --amostrar=pontos     simulação amostrada: avança sem trace até cada ponto (com snapshots
+  //                         "<pontos>.<ponto>.<início do aquecimento>.<imagem>.snap", reaproveitados depois pela mesma
+  //                         imagem com o mesmo aquecimento) e roda só os intervalos escolhidos em detalhe, com trace em
+  //                         "<saida>.ponto<ponto>" e os modelos de tempo ligados; "saida" recebe o CPI por ponto e o
+  //                         CPI estimado do programa
+  //   --amostrar-aquecimento=N ... instruções antes de cada ponto para aquecer caches e preditor (padrão 0)
+  //   --cobertura=arquivo   cobertura de arestas (desvios tomados, jal, jalr) no formato do AFL, gravada no fim como no
+  //                         afl-showmap; com __AFL_SHM_ID no ambiente, o mapa é a memória compartilhada do afl-fuzz
+  //   --fuzz=corpus         fuzzing em processo das entradas da UART: "entrada" é a imagem e "saida" um diretório que recebe
+  //                         fila/, falhas/, travamentos/ e resumo; parte dos arquivos do diretório corpus (pode ser vazio)
+  //   --fuzz-iteracoes=N    ... entradas mutadas executadas (padrão 100000)
+  //   --fuzz-orcamento=N    ... instruções por entrada antes de contar como travamento (padrão 1000000)
+  //   --fuzz-tamanho=N      ... tamanho máximo de uma entrada em bytes (padrão 1024)
+  //   --fuzz-semente=N      ... semente das mutações (padrão 1)
+  //   --avancar-ate=gatilho roda sem formatar o trace até o gatilho e daí em diante grava o trace completo, idêntico ao
+  //                         de uma execução rastreada do começo: instrucoes:N, pc:X, escrita:X (primeiro store no byte X)
+  //                         ou interrupcao (primeira interrupção tomada)
+
+	const char *caminhoSalvar = buscarOpcao(argc, argv, "--salvar");
+	const char *caminhoRestaurar = buscarOpcao(argc, argv, "--restaurar");
+	const char *listaFork = buscarOpcao(argc, argv, "--fork-server");
+	const char *opcaoPontoEm = buscarOpcao(argc, argv, "--salvar-em");
+	if (opcaoPontoEm == NULL)
+		opcaoPontoEm = buscarOpcao(argc, argv, "--fork-em");
+	uint64_t pontoEm = (opcaoPontoEm != NULL) ? strtoull(opcaoPontoEm, NULL, 0) : UINT64_MAX; // UINT64_MAX = no ebreak
+	const char *opcaoParalelo = buscarOpcao(argc, argv, "--fork-paralelo");
+	const int paralelo = (opcaoParalelo != NULL) ? atoi(opcaoParalelo) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	const char *opcaoLimite = buscarOpcao(argc, argv, "--limite");
+	const uint64_t limite = (opcaoLimite != NULL) ? strtoull(opcaoLimite, NULL, 0) : UINT64_MAX;
+
+	const char *prefixoCheckpoint = buscarOpcao(argc, argv, "--checkpoint");
+	const char *opcaoCheckpointCada = buscarOpcao(argc, argv, "--checkpoint-cada");
+	const uint64_t checkpointCada = (opcaoCheckpointCada != NULL) ? strtoull(opcaoCheckpointCada, NULL, 0) : 0;
+	uint64_t proximoCheckpoint = UINT64_MAX;
+	uint32_t numCheckpoint = 0; // sequência do próximo checkpoint (0 = completo)
+
+	const char *opcaoLote = buscarOpcao(argc, argv, "--lote");
+	if (opcaoLote != NULL)
+	{
+		const int numThreads = atoi(opcaoLote) > 0 ? atoi(opcaoLote) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+		return executarLote(argv[1], argv[2], numThreads, limite, buscarOpcao(argc, argv, "--lote-trace"));
+	}
+	const char *opcaoFrota = buscarOpcao(argc, argv, "--frota");
+	if (opcaoFrota != NULL)
+	{
+		const uint64_t fatia = strtoull(opcaoFrota, NULL, 0);
+		return executarFrota(argv[1], argv[2], fatia != 0 ? fatia : 10000, limite);
+	}
 
-				// Atualiza mstatus:
-				// MIE ← MPIE (bit 3 ← bit 7)
-				mstatus = (mstatus & ~(1 << 3)) | (((mstatus >> 7) & 1) << 3);
+	const char *opcaoAgrupar = buscarOpcao(argc, argv, "--agrupar");
+	if (opcaoAgrupar != NULL)
+		return agruparIntervalos(argv[1], argv[2], atoi(opcaoAgrupar));
 
-				// MPIE ← 1
-				mstatus |= (1 << 7);
+	const char *dirCorpus = buscarOpcao(argc, argv, "--fuzz");
+	if (dirCorpus != NULL)
+	{
+		const char *opcaoIteracoes = buscarOpcao(argc, argv, "--fuzz-iteracoes");
+		const char *opcaoOrcamento = buscarOpcao(argc, argv, "--fuzz-orcamento");
+		const char *opcaoTamanho = buscarOpcao(argc, argv, "--fuzz-tamanho");
+		const char *opcaoSemente = buscarOpcao(argc, argv, "--fuzz-semente");
+		const size_t tamMaximo = (opcaoTamanho != NULL) ? strtoull(opcaoTamanho, NULL, 0) : 0;
+		const uint32_t semente = (opcaoSemente != NULL) ? (uint32_t)strtoul(opcaoSemente, NULL, 0) : 0;
+		return executarFuzz(argv[1], argv[2], dirCorpus,
+							(opcaoIteracoes != NULL) ? strtoull(opcaoIteracoes, NULL, 0) : 100000,
+							(opcaoOrcamento != NULL) ? strtoull(opcaoOrcamento, NULL, 0) : 1000000,
+							tamMaximo != 0 ? tamMaximo : 1024, semente != 0 ? semente : 1, limite);
+	}
 
-				// MPP ← 00 (bits 12-11)
-				mstatus &= ~(3 << 11);
+	const char *listaLockstep = buscarOpcao(argc, argv, "--lockstep");
+	if (listaLockstep != NULL)
+		return executarLockstep(argv[1], listaLockstep, limite);
 
-				registradoresCSRs[idx_mstatus] = mstatus;
+	ResultadoFork *resultadoFork = NULL; // só é preenchido nos processos filhos do servidor de fork
+	int codigoSaida = 0;				 // 0 = ebreak, 1 = CSR não suportado, 2 = limite de instruções
 
-				fprintf(output, "0x%08x:mret       pc=0x%08x\n", pc, mepc);
+	Maquina *m = poximCriar();
+	if (m == NULL)
+	{
+		fprintf(stderr, "Não foi possível alocar a memória simulada.\n");
+		return 1;
+	}
 
-				pc = mepc;
-				continue;
-			}
+	m->saida = fopen(argv[2], "w"); // abre/cria em arquivo de saida (os arquivos do argumento do main)
 
-			break;
+	m->entradaUART = fopen("qemu.terminal.in", "r"); // Abre o arquivo de entrada UART
+	// ao restaurar, a saída UART continua o arquivo já existente a partir da posição do snapshot
+	m->saidaUART = (caminhoRestaurar != NULL) ? fopen("qemu.terminal.out", "r+") : NULL;
+	if (m->saidaUART == NULL)
+		m->saidaUART = fopen("qemu.terminal.out", "w"); // Abre/cria o arquivo de saída UART
 
-			// Tratamento da exceção 2 — Illegal Instruction. Quando a instrução não é reconhecida (opcode ou funct inválido)
-		default:
-			// fprintf(output, "Instrução inválida em 0x%08x: 0x%08x (opcode: 0x%02x)\n", // para achar o erro
-			// pc, instrucao, opcode);
-			// preparando mstatus para a excessão
-			prepMstatus(&registradoresCSRs[0]);
-			registrarExcecao(2, pc, instrucao, registradoresCSRs, output, &pc); // código 2 = Illegal Instruction
-			continue;															// Isso será tratado pelo handler
+	if (caminhoRestaurar != NULL)
+	{
+		// estado e memória vêm do snapshot
+		if (poximRestaurarSnapshot(m, caminhoRestaurar) != 0)
+		{
+			return 1;
 		}
+	}
+	// leitura da imagem de entrada: texto hex (@endereço), executável ELF ou binário cru
+	else if (poximCarregarImagem(m, argv[1]) != 0)
+	{
+		return 1;
+	}
 
-		// Incremento do tempo do CLINT (mtime)
-		clint_mtime++;
-
-		// VERIFICAÇÃO DA INTERRUPÇÃO POR TIMER
-		if ((registradoresCSRs[1] & (1 << 7)) && // mie: habilita interrupção de timer
-			(registradoresCSRs[0] & (1 << 3)) && // mstatus: interrupções globais habilitadas
-			(clint_mtime >= clint_mtimecmp))	 // mtime atingiu mtimecmp
+	// profiler por amostragem (só no hart único)
+	const char *caminhoPerfil = buscarOpcao(argc, argv, "--perfil");
+	const char *opcaoPerfilCada = buscarOpcao(argc, argv, "--perfil-cada");
+	const char *mapaPerfil = buscarOpcao(argc, argv, "--perfil-mapa");
+	const uint32_t entrada = m->pc;
+	Perfil *perfil = NULL;
+	if (caminhoPerfil != NULL)
+	{
+		perfil = calloc(1, sizeof(Perfil));
+		if (perfil == NULL)
 		{
-			// Prepara os CSRs para a interrupção
-			registradoresCSRs[4] = 0x80000007; // mcause (bit 31 = 1 indica interrupção, código 7 = timer)
-			registradoresCSRs[3] = pc + 4;	   // mepc = próxima instrução
-			registradoresCSRs[5] = 0x00000000; // mtval = zero em interrupções
+			fprintf(stderr, "Sem memória para o perfil.\n");
+			return 1;
+		}
+		perfil->cada = (opcaoPerfilCada != NULL && strtoull(opcaoPerfilCada, NULL, 0) != 0) ? strtoull(opcaoPerfilCada, NULL, 0)
+																							 : 1000;
+		perfil->proxima = m->instrucoes + perfil->cada;
+	}
+	if (mapaPerfil != NULL)
+		poximCarregarMapa(m, mapaPerfil);
+
+	const char *caminhoEstatisticas = buscarOpcao(argc, argv, "--estatisticas");
+	if (caminhoEstatisticas != NULL && poximAtivarEstatisticas(m) != 0)
+		return 1;
+	const char *caminhoPilha = buscarOpcao(argc, argv, "--pilha");
+	if (caminhoPilha != NULL && poximAtivarPilhaChamadas(m) != 0)
+		return 1;
+	const char *caminhoLatencias = buscarOpcao(argc, argv, "--latencias");
+	if (caminhoLatencias != NULL && poximAtivarLatencias(m) != 0)
+		return 1;
+	const char *caminhoCaches = buscarOpcao(argc, argv, "--caches");
+	const char *opcaoPenalidade = buscarOpcao(argc, argv, "--cache-penalidade");
+	if (caminhoCaches != NULL &&
+		poximAtivarCaches(m, buscarOpcao(argc, argv, "--icache"), buscarOpcao(argc, argv, "--dcache"),
+						  (opcaoPenalidade != NULL) ? strtoul(opcaoPenalidade, NULL, 0) : 0) != 0)
+		return 1;
+	const char *caminhoPipeline = buscarOpcao(argc, argv, "--pipeline");
+	const char *opcaoLatenciaMul = buscarOpcao(argc, argv, "--latencia-mul");
+	const char *opcaoLatenciaDiv = buscarOpcao(argc, argv, "--latencia-div");
+	if (caminhoPipeline != NULL &&
+		poximAtivarPipeline(m, buscarOpcao(argc, argv, "--preditor"),
+							(opcaoLatenciaMul != NULL) ? strtoul(opcaoLatenciaMul, NULL, 0) : 0,
+							(opcaoLatenciaDiv != NULL) ? strtoul(opcaoLatenciaDiv, NULL, 0) : 0) != 0)
+		return 1;
+	const char *caminhoAcessos = buscarOpcao(argc, argv, "--acessos");
+	const char *opcaoAcessosCada = buscarOpcao(argc, argv, "--acessos-cada");
+	if (caminhoAcessos != NULL &&
+		poximAtivarMapaAcessos(m, (opcaoAcessosCada != NULL) ? strtoull(opcaoAcessosCada, NULL, 0) : 0) != 0)
+		return 1;
+
+	const char *caminhoBbv = buscarOpcao(argc, argv, "--bbv");
+	const char *opcaoBbvIntervalo = buscarOpcao(argc, argv, "--bbv-intervalo");
+	if (caminhoBbv != NULL &&
+		poximAtivarVetorBlocos(m, (opcaoBbvIntervalo != NULL) ? strtoull(opcaoBbvIntervalo, NULL, 0) : 0, caminhoBbv) != 0)
+		return 1;
+
+	const char *caminhoCobertura = buscarOpcao(argc, argv, "--cobertura");
+	const char *idMemoriaAfl = getenv("__AFL_SHM_ID");
+	if (caminhoCobertura != NULL || idMemoriaAfl != NULL)
+	{
+		uint8_t *mapa = NULL;
+		if (idMemoriaAfl != NULL)
+		{
+			mapa = shmat(atoi(idMemoriaAfl), NULL, 0);
+			if (mapa == (void *)-1)
+			{
+				fprintf(stderr, "Não foi possível usar a memória compartilhada do AFL (%s).\n", idMemoriaAfl);
+				return 1;
+			}
+		}
+		if (poximAtivarCobertura(m, mapa) != 0)
+			return 1;
+	}
 
-			prepMstatus(&registradoresCSRs[0]);
+	const char *opcaoAvancar = buscarOpcao(argc, argv, "--avancar-ate");
+	if (opcaoAvancar != NULL)
+	{
+		static const char *nomesGatilhos[] = {"instrucoes:", "pc:", "escrita:", "interrupcao"};
+		int tipo = 0;
+		while (tipo < 4 && strncmp(opcaoAvancar, nomesGatilhos[tipo], strlen(nomesGatilhos[tipo])) != 0)
+			tipo++;
+		if (tipo == 4)
+		{
+			fprintf(stderr, "Gatilho inválido em --avancar-ate: %s.\n", opcaoAvancar);
+			return 1;
+		}
+		if (poximAvancarAte(m, (TipoGatilho)tipo, strtoull(opcaoAvancar + strlen(nomesGatilhos[tipo]), NULL, 0)) != 0)
+			return 1;
+	}
 
-			fprintf(output, ">interrupt:timer               cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
-					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
+	const char *caminhoPontos = buscarOpcao(argc, argv, "--amostrar");
+	if (caminhoPontos != NULL)
+	{
+		const char *opcaoAquecimento = buscarOpcao(argc, argv, "--amostrar-aquecimento");
+		codigoSaida = executarAmostrado(m, caminhoPontos, argv[2], m->saida,
+										(opcaoAquecimento != NULL) ? strtoull(opcaoAquecimento, NULL, 0) : 0);
+		fclose(m->saida);
+		poximDestruir(m);
+		return codigoSaida;
+	}
 
-			// Redireciona o PC para mtvec
-			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
+	// multi-hart: os harts secundários compartilham a memória já carregada
+	// (os relatórios do fim saem do hart 0; perfil, snapshots e fork dependem do laço de hart único abaixo)
+	const char *opcaoHarts = buscarOpcao(argc, argv, "--harts");
+	const int numHarts = (opcaoHarts != NULL) ? atoi(opcaoHarts) : 1;
+	if (numHarts > 1 && (perfil != NULL || caminhoSalvar != NULL || listaFork != NULL || prefixoCheckpoint != NULL))
+	{
+		fprintf(stderr, "--perfil, --salvar, --fork-server e --checkpoint não funcionam com --harts.\n");
+		return 1;
+	}
+	if (numHarts > 1)
+	{
+		const char *opcaoQuantum = buscarOpcao(argc, argv, "--quantum");
+		const uint64_t quantum = (opcaoQuantum != NULL) ? strtoull(opcaoQuantum, NULL, 0) : 1000;
+		Maquina **harts = calloc(numHarts, sizeof(Maquina *));
+		int *eventos = calloc(numHarts, sizeof(int));
+		harts[0] = m;
+		for (int i = 1; i < numHarts; i++)
+		{
+			char nome[4200];
+			harts[i] = poximCriarHart(m, i);
+			snprintf(nome, sizeof(nome), "%s.hart%d", argv[2], i);
+			harts[i]->saida = fopen(nome, "w");
+			harts[i]->entradaUART = m->entradaUART; // a UART é um dispositivo só, compartilhado pelos harts
+			harts[i]->saidaUART = m->saidaUART;
+			if (m->gatilho != NULL) // cada hart dispara o seu
+				poximAvancarAte(harts[i], m->gatilho->tipo, m->gatilho->valor);
+		}
+		poximExecutarHarts(harts, numHarts, quantum, limite, eventos);
 
-			continue;
+		// o código é o do hart 0, a menos que outro hart tenha falhado sozinho
+		codigoSaida = codigoEvento(eventos[0]);
+		for (int i = 1; i < numHarts && codigoSaida == 0; i++)
+		{
+			if (eventos[i] != EVENTO_NENHUM)
+				codigoSaida = codigoEvento(eventos[i]);
+		}
+		for (int i = 1; i < numHarts; i++)
+		{
+			fclose((harts[i]->gatilho != NULL) ? harts[i]->gatilho->trace : harts[i]->saida);
+			poximDestruir(harts[i]);
 		}
+		free(harts);
+		free(eventos);
+	}
 
-		// VERIFICAÇÃO DE INTERRUPÇÃO DE SOFTWARE
-		if ((registradoresCSRs[1] & 0x8) && // mie: software interrupt enable (bit 3)
-			(registradoresCSRs[0] & 0x8) && // mstatus: global interrupt enable (bit 3)
-			(clint_msip & 0x1))				// msip: interrupção de software solicitada
+	if (prefixoCheckpoint != NULL && checkpointCada != 0)
+	{
+		proximoCheckpoint = m->instrucoes + checkpointCada;
+	}
+
+	// inicio do simulador de instruções (com --harts a execução já aconteceu acima)
+	while (numHarts <= 1)
+	{
+		// checkpoint periódico: o primeiro é completo, os seguintes só com as páginas sujas
+		if (m->instrucoes == proximoCheckpoint)
 		{
-			registradoresCSRs[4] = 0x80000003; // mcause: software interrupt
-			registradoresCSRs[3] = pc + 4;	   // mepc: proxima instrução
-			registradoresCSRs[5] = 0;		   // mtval: valor adicional (0 para interrupções)
+			char caminho[4200];
+			snprintf(caminho, sizeof(caminho), "%s.%u", prefixoCheckpoint, numCheckpoint);
+			if (numCheckpoint == 0)
+			{
+				poximSalvarSnapshot(m, caminho);
+			}
+			else
+			{
+				char anterior[4200];
+				snprintf(anterior, sizeof(anterior), "%s.%u", prefixoCheckpoint, numCheckpoint - 1);
+				poximSalvarIncremental(m, caminho, anterior);
+			}
+			numCheckpoint++;
+			proximoCheckpoint += checkpointCada;
+		}
 
-			prepMstatus(&registradoresCSRs[0]);
+		// ponto de snapshot / fork: grava o estado completo e encerra, ou passa a criar processos filhos
+		if ((caminhoSalvar != NULL || listaFork != NULL) && m->instrucoes == pontoEm)
+		{
+			if (caminhoSalvar != NULL)
+			{
+				poximSalvarSnapshot(m, caminhoSalvar);
+				caminhoSalvar = NULL;
+			}
 
-			fprintf(output, ">interrupt:software            cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
-					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
+			if (listaFork == NULL)
+				break;
 
-			// IMPORTANTE: Limpar o MSIP para evitar loop infinito
-			clint_msip = 0;
+			int erroFork;
+			const char *entradaFilho = servidorFork(listaFork, paralelo > 0 ? paralelo : 1, &resultadoFork, &erroFork);
+			if (entradaFilho == NULL)
+			{
+				codigoSaida = erroFork; // processo pai: todos os filhos terminaram
+				break;
+			}
 
-			// Redireciona o PC para mtvec
-			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
-			continue;
+			// processo filho: arquivos próprios de entrada/saída UART e de trace
+			// (os FILE* herdados não são fechados, para não mexer na posição dos descritores do pai)
+			char nome[4200];
+			m->entradaUART = fopen(entradaFilho, "r");
+			snprintf(nome, sizeof(nome), "%s.saida", entradaFilho);
+			m->saida = fopen(nome, "w");
+			snprintf(nome, sizeof(nome), "%s.terminal.out", entradaFilho);
+			m->saidaUART = fopen(nome, "w");
+			if (m->saida == NULL || m->saidaUART == NULL)
+			{
+				fprintf(stderr, "Não foi possível criar as saídas de %s.\n", entradaFilho);
+				_exit(1);
+			}
+			if (m->gatilho != NULL) // o trace do filho também começa no gatilho
+				poximAvancarAte(m, m->gatilho->tipo, m->gatilho->valor);
+			listaFork = NULL;
 		}
 
-		// VERIFICAÇÃO DE INTERRUPÇÃO EXTERNA (PLIC – UART)
-		if ((registradoresCSRs[1] & (1 << 11)) && // mie: external interrupt enable
-			(registradoresCSRs[0] & (1 << 3)) &&  // mstatus: global interrupt enable
-			(plic_enable & (1 << 10)) &&		  // UART enable no PLIC
-			(plic_pending & (1 << 10)))			  // UART sinalizou interrupção
-		{
-			registradoresCSRs[4] = 0x8000000B; // mcause: 11 = External Interrupt (bit 31 = 1)
-			registradoresCSRs[3] = pc + 4;	   // mepc: próxima instrução
-			registradoresCSRs[5] = 0;		   // mtval: 0 para interrupções
+		if (perfil != NULL && m->instrucoes >= perfil->proxima)
+			amostrarPerfil(perfil, m);
 
-			prepMstatus(&registradoresCSRs[0]);
+		// limite de instruções (evita execuções que nunca chegam ao ebreak)
+		if (m->instrucoes >= limite)
+		{
+			codigoSaida = 2;
+			break;
+		}
 
-			fprintf(output, ">interrupt:external            cause=0x%08x,epc=0x%08x,tval=0x%08x\n",
-					registradoresCSRs[4], registradoresCSRs[3], registradoresCSRs[5]);
+		// roda até o próximo ponto de parada (snapshot/fork, checkpoint, amostra do perfil ou limite)
+		uint64_t alvo = limite;
+		if ((caminhoSalvar != NULL || listaFork != NULL) && pontoEm < alvo)
+			alvo = pontoEm;
+		if (proximoCheckpoint < alvo)
+			alvo = proximoCheckpoint;
+		if (perfil != NULL && perfil->proxima < alvo)
+			alvo = perfil->proxima;
+
+		const int evento = poximExecutar(m, alvo - m->instrucoes);
+		if (evento == EVENTO_LIMITE || evento == EVENTO_WFI || evento == EVENTO_UART_VAZIA)
+			continue;
 
-			// Redireciona o PC para mtvec como nas outras interrupções
-			pc = (registradoresCSRs[2] & ~0x3) + 4 * (registradoresCSRs[4] & 0x7FFFFFFF);
+		// ebreak como marcador de snapshot/fork: grava o estado já apontando para a instrução seguinte
+		if (evento == EVENTO_EBREAK && (caminhoSalvar != NULL || listaFork != NULL) && pontoEm == UINT64_MAX)
+		{
+			m->pc += 4;
+			pontoEm = m->instrucoes;
 			continue;
 		}
 
-		pc += 4;
+		if (evento == EVENTO_CSR_INVALIDO)
+			codigoSaida = 1;
+		break;
 	}
-	return 0;
+
+	// processo filho do servidor de fork: devolve o estado final ao pai
+	if (resultadoFork != NULL)
+	{
+		resultadoFork->pc = m->pc;
+		resultadoFork->a0 = m->registradores[10];
+		resultadoFork->instrucoes = m->instrucoes;
+		fclose((m->gatilho != NULL) ? m->gatilho->trace : m->saida);
+		fclose(m->saidaUART);
+		if (m->entradaUART != NULL)
+			fclose(m->entradaUART);
+		_exit(codigoSaida);
+	}
+
+	if (perfil != NULL)
+	{
+		gravarPerfil(perfil, m, entrada, caminhoPerfil, 20);
+		free(perfil);
+	}
+	if (caminhoPilha != NULL)
+		poximGravarPilhaChamadas(m, caminhoPilha);
+	if (caminhoEstatisticas != NULL)
+		poximGravarEstatisticas(m, caminhoEstatisticas);
+	if (caminhoLatencias != NULL)
+		poximGravarLatencias(m, caminhoLatencias);
+	if (caminhoAcessos != NULL)
+		poximGravarMapaAcessos(m, caminhoAcessos);
+	if (caminhoCaches != NULL)
+		poximGravarCaches(m, caminhoCaches);
+	if (caminhoPipeline != NULL)
+		poximGravarPipeline(m, caminhoPipeline);
+	if (caminhoCobertura != NULL)
+		poximGravarCobertura(m, caminhoCobertura);
+	if (m->gatilho != NULL)
+		fprintf(stderr, "O gatilho de --avancar-ate não disparou; o trace ficou vazio.\n");
+	poximDestruir(m);
+	return codigoSaida;
 }
+#endif
@@ -0,0 +1,247 @@
+#ifndef POXIMV2_H
+#define POXIMV2_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Interface de biblioteca do simulador poximv2
+// Todo o estado de uma máquina fica em uma struct Maquina, então vários simuladores podem rodar no mesmo processo.
+// Para usar como biblioteca, compile o simulador com -DPOXIMV2_BIBLIOTECA (remove o main de linha de comando).
+
+// memória simulada: 32 KiB a partir de 0x80000000
+#define OFFSET_MEMORIA 0x80000000u
+#define TAM_MEMORIA (32 * 1024)
+
+// granularidade do rastreamento de escrita usado pelos snapshots incrementais (64 páginas em 32 KiB)
+#define TAM_PAGINA_SUJA 512
+
+// mapa de cobertura de arestas: o mesmo tamanho do mapa do AFL (64 KiB)
+#define BITS_MAPA_COBERTURA 16
+#define TAM_MAPA_COBERTURA (1u << BITS_MAPA_COBERTURA)
+
+// eventos que fazem poximExecutar retornar
+enum
+{
+	EVENTO_NENHUM = 0,
+	EVENTO_EBREAK,		 // ebreak executado (pc continua apontando para o ebreak)
+	EVENTO_CSR_INVALIDO, // acesso a um CSR não suportado (pc continua apontando para a instrução)
+	EVENTO_LIMITE,		 // o número de instruções pedido foi executado
+	EVENTO_WFI,			 // wfi executado (pc já aponta para a instrução seguinte)
+	EVENTO_UART_VAZIA,	 // o programa consultou a UART sem dado disponível (pc já aponta para a instrução seguinte)
+	EVENTO_EXCECAO,		 // exceção com a causa em excecoesParada (o trap já foi tomado: mcause/mepc valem)
+};
+
+// eventos dos contadores programáveis (valor escrito em mhpmevent3..31)
+enum
+{
+	HPM_NENHUM = 0,
+	HPM_LOADS,			 // loads executados (qualquer região)
+	HPM_STORES,			 // stores executados (qualquer região)
+	HPM_DESVIOS_TOMADOS, // desvios condicionais tomados
+	HPM_EXCECOES,		 // exceções (registrarExcecao)
+	HPM_INTERRUPCOES,	 // interrupções atendidas
+	HPM_MMIO,			 // loads e stores fora da RAM (CLINT, PLIC, UART)
+	HPM_ICACHE_ACESSOS,	 // modelo de caches (liga com a configuração padrão se estiver desligado)
+	HPM_ICACHE_FALTAS,
+	HPM_DCACHE_ACESSOS,
+	HPM_DCACHE_FALTAS,
+	HPM_DCACHE_ESCRITAS_DE_VOLTA,
+	HPM_CICLOS_ESTIMADOS, // instruções + penalidade por falta/escrita de volta
+};
+
+// símbolo de função/objeto lido da tabela de símbolos do ELF
+typedef struct
+{
+	uint32_t endereco;
+	uint32_t tamanho;
+	char nome[64];
+} Simbolo;
+
+// pilha de chamadas sombra (opaca; ver poximAtivarPilhaChamadas)
+typedef struct PilhaChamadas PilhaChamadas;
+// contadores de execução (opacos; ver poximAtivarEstatisticas)
+typedef struct Estatisticas Estatisticas;
+// latências de interrupções e exceções (opacas; ver poximAtivarLatencias)
+typedef struct Latencias Latencias;
+// leituras/escritas por bloco da RAM e por registrador MMIO (opacas; ver poximAtivarMapaAcessos)
+typedef struct MapaAcessos MapaAcessos;
+// modelo de caches L1 (opaco; ver poximAtivarCaches)
+typedef struct ModeloCache ModeloCache;
+// modelo de tempo do pipeline (opaco; ver poximAtivarPipeline)
+typedef struct ModeloPipeline ModeloPipeline;
+// vetores de blocos básicos por intervalo (opacos; ver poximAtivarVetorBlocos)
+typedef struct VetorBlocos VetorBlocos;
+
+// cobertura de arestas (opaca; ver poximAtivarCobertura)
+typedef struct Cobertura Cobertura;
+
+// gatilho do avanço rápido (ver poximAvancarAte)
+typedef enum
+{
+	GATILHO_INSTRUCOES,	 // depois de "valor" instruções
+	GATILHO_PC,			 // na primeira vez que pc == valor
+	GATILHO_ESCRITA,	 // no primeiro store/AMO que escreve no byte "valor"
+	GATILHO_INTERRUPCAO, // na primeira interrupção tomada
+} TipoGatilho;
+
+typedef struct
+{
+	TipoGatilho tipo;
+	uint64_t valor;
+	FILE *trace; // trace guardado até o disparo
+} Gatilho;
+
+typedef struct Maquina
+{
+	// seção quente: usada em toda instrução, alinhada à linha de cache
+	_Alignas(64) uint32_t registradores[32];
+	uint32_t pc;
+	uint8_t *mem;		 // TAM_MEMORIA bytes a partir de OFFSET_MEMORIA
+	uint64_t instrucoes; // instruções executadas
+	FILE *saida;		 // trace de execução (NULL = sem trace)
+
+	// CSRs e dispositivos
+	_Alignas(64) uint32_t registradoresCSRs[16]; // mstatus, mie, mtvec, mepc, mcause, mtval, mip, mhartid, mscratch
+	uint32_t registradoresUART[6];
+	uint32_t clint_msip;	 // interrupção de software (MSIP)
+	uint64_t clint_mtime;	 // contador de tempo (MTIME)
+	uint64_t clint_mtimecmp; // alvo da interrupção (MTIMECMP)
+	uint32_t plic_priority;
+	uint32_t plic_pending;
+	uint32_t plic_enable;
+	uint32_t plic_threshold;
+	uint32_t plic_claim;
+	FILE *entradaUART; // caracteres lidos pelo programa (RHR)
+	FILE *saidaUART;   // caracteres escritos pelo programa (THR)
+
+	// páginas de memória escritas desde o último snapshot (um bit por página de TAM_PAGINA_SUJA bytes)
+	uint64_t paginasSujas[(TAM_MEMORIA / TAM_PAGINA_SUJA + 63) / 64];
+
+	// tabela de símbolos ordenada por endereço (vazia quando a imagem não é ELF)
+	Simbolo *simbolos;
+	int numSimbolos;
+
+	// multi-hart: todos os harts do sistema (para o CLINT de cada um) e quem libera a memória
+	uint32_t hartid;
+	int numHarts; // 0 ou 1 = hart único
+	struct Maquina **harts;
+	int donoMemoria;
+	pthread_mutex_t *travaUART; // serializa o acesso à UART compartilhada (NULL = hart único)
+
+	// reserva do lr.w (o sc.w confere endereço e valor com compare-and-swap)
+	uint32_t enderecoReservado;
+	uint32_t valorReservado;
+	int reservaValida;
+
+	// contadores de desempenho (Zicntr/Zihpm): calculados na leitura a partir de instrucoes, mtime e das estatísticas
+	uint32_t eventosHpm[32];	 // mhpmevent3..31 (HPM_*)
+	uint64_t baseContadores[32]; // mcycle, -, minstret, mhpmcounter3..31: valor descontado na leitura
+
+	PilhaChamadas *pilhaChamadas; // NULL = desligada
+	Estatisticas *estatisticas;	  // NULL = desligadas
+	Latencias *latencias;		  // NULL = desligadas
+	MapaAcessos *mapaAcessos;	  // NULL = desligado
+	ModeloCache *modeloCache;	  // NULL = desligado
+	ModeloPipeline *modeloPipeline; // NULL = desligado
+	VetorBlocos *vetorBlocos;		// NULL = desligado
+	Gatilho *gatilho;				// NULL = sem avanço rápido pendente
+	Cobertura *cobertura;			// NULL = desligada
+	uint32_t excecoesParada;		// causas de exceção (bit = código) que fazem poximExecutar devolver EVENTO_EXCECAO
+} Maquina;
+
+// cria uma máquina no estado de reset (memória zerada, pc = OFFSET_MEMORIA); os arquivos começam NULL
+Maquina *poximCriar(void);
+void poximDestruir(Maquina *m);
+void poximReiniciar(Maquina *m); // volta ao estado de reset (mantém os arquivos)
+Maquina *poximCriarHart(Maquina *principal, uint32_t hartid); // compartilha a memória do principal
+
+// carrega texto hex (@endereço), executável ELF ou binário cru (".bin"); ajusta o pc para o ponto de entrada
+int poximCarregarImagem(Maquina *m, const char *caminho);
+
+// executa até maxInstrucoes instruções ou até um evento; retorna o EVENTO_* que parou a execução
+int poximExecutar(Maquina *m, uint64_t maxInstrucoes);
+int poximPasso(Maquina *m);
+
+// executa numHarts harts, um por thread, até cada um parar (ebreak, CSR não suportado ou limite de instruções)
+// a cada quantum instruções os harts se sincronizam e o mtime de todos passa a ser o maior entre eles;
+// quando o hart 0 para, os outros param na sincronização seguinte
+// eventos[i] recebe o EVENTO_* que parou o hart i (EVENTO_NENHUM se ele foi parado pelo fim do hart 0)
+int poximExecutarHarts(Maquina **harts, int numHarts, uint64_t quantum, uint64_t limite, int *eventos);
+
+// acesso ao estado
+uint32_t poximLerRegistrador(const Maquina *m, int indice);
+void poximEscreverRegistrador(Maquina *m, int indice, uint32_t valor);
+int poximLerMemoria(const Maquina *m, uint32_t endereco, void *destino, uint32_t tamanho);
+int poximEscreverMemoria(Maquina *m, uint32_t endereco, const void *origem, uint32_t tamanho);
+const Simbolo *poximBuscarSimbolo(const Maquina *m, uint32_t endereco);
+int poximCarregarMapa(Maquina *m, const char *caminho); // símbolos de um mapa texto "endereco [tipo] nome"
+
+// pilha de chamadas sombra (jal/jalr com rd = ra, "jalr zero,ra,0", traps e mret) e flame graph no formato folded
+int poximAtivarPilhaChamadas(Maquina *m);
+int poximGravarPilhaChamadas(Maquina *m, const char *caminho);
+
+// estatísticas de execução: mnemônicos, desvios tomados, loads/stores por região, exceções e interrupções
+int poximAtivarEstatisticas(Maquina *m);
+int poximGravarEstatisticas(const Maquina *m, const char *caminho); // JSON, ou CSV se o caminho termina em ".csv"
+
+// latências dos traps: pendente -> tomado -> mret, em instruções e em ticks de mtime, com histogramas em JSON
+int poximAtivarLatencias(Maquina *m);
+int poximGravarLatencias(const Maquina *m, const char *caminho);
+
+// mapa de acessos: contagens por bloco de 64 bytes da RAM e por registrador MMIO, conjunto de trabalho a cada
+// "cada" instruções (0 = 10000); o relatório é texto
+int poximAtivarMapaAcessos(Maquina *m, uint64_t cada);
+int poximGravarMapaAcessos(Maquina *m, const char *caminho);
+
+// caches L1 de instruções e de dados: configuração "tamanho,vias,linha[,lru|fifo|aleatoria]" (NULL = 4096,2,32,lru),
+// penalidade em ciclos por falta (0 = 10); o relatório é texto
+int poximAtivarCaches(Maquina *m, const char *configInstrucoes, const char *configDados, uint32_t penalidade);
+int poximGravarCaches(const Maquina *m, const char *caminho);
+
+// pipeline em ordem de 5 estágios: preditor "estatico", "bimodal[,bits]" ou "gshare[,bits]" (NULL = bimodal,10),
+// latências de mul e div em ciclos (0 = 3 e 20); o relatório é texto
+int poximAtivarPipeline(Maquina *m, const char *preditor, uint32_t latenciaMul, uint32_t latenciaDiv);
+int poximGravarPipeline(const Maquina *m, const char *caminho);
+
+// vetores de blocos básicos (formato .bb do SimPoint) gravados em caminho a cada "intervalo" instruções (0 = 100000)
+int poximAtivarVetorBlocos(Maquina *m, uint64_t intervalo, const char *caminho);
+void poximFinalizarVetorBlocos(Maquina *m); // grava o intervalo incompleto e fecha o arquivo
+
+// avanço rápido: a máquina roda sem trace até o gatilho (a instrução que o dispara já é rastreada, assim como a
+// interrupção em GATILHO_INTERRUPCAO); daí em diante m->saida recebe exatamente o trace de uma execução completa
+int poximAvancarAte(Maquina *m, TipoGatilho tipo, uint64_t valor);
+
+// cobertura de arestas no formato do AFL; mapa = NULL aloca um, senão usa o de quem chamou (TAM_MAPA_COBERTURA bytes,
+// não é zerado nem liberado pela máquina)
+int poximAtivarCobertura(Maquina *m, uint8_t *mapa);
+int poximGravarCobertura(const Maquina *m, const char *caminho); // formato do afl-showmap
+
+// harness de fuzzing em processo (opaco): cada entrada vira o RX da UART e parte do estado da máquina na criação,
+// restaurado em memória; falha = exceção em m->excecoesParada (padrão: todas menos ecall) ou CSR não suportado,
+// travamento = orçamento de instruções esgotado
+typedef struct Fuzzer Fuzzer;
+enum
+{
+	FUZZ_OK,
+	FUZZ_FALHA,
+	FUZZ_TRAVAMENTO,
+};
+typedef struct
+{
+	int evento;			 // EVENTO_* que encerrou a execução
+	uint32_t causa;		 // mcause da falha (2 = instrução ilegal também para CSR não suportado)
+	uint32_t pc;		 // mepc da exceção, pc do CSR não suportado ou onde o orçamento acabou
+	uint64_t instrucoes; // executadas com esta entrada
+} ResultadoFuzz;
+Fuzzer *poximCriarFuzzer(Maquina *m, uint64_t orcamento); // desliga o trace e a UART da máquina até poximDestruirFuzzer
+int poximExecutarFuzz(Fuzzer *f, const uint8_t *entrada, size_t tamanho, ResultadoFuzz *resultado); // FUZZ_*
+const uint8_t *poximCoberturaFuzz(const Fuzzer *f); // mapa de arestas da última execução
+void poximDestruirFuzzer(Fuzzer *f);
+
+// snapshots: completo, incremental (só páginas sujas desde o anterior) e restauração (segue a cadeia)
+int poximSalvarSnapshot(Maquina *m, const char *caminho);
+int poximSalvarIncremental(Maquina *m, const char *caminho, const char *anterior);
+int poximRestaurarSnapshot(Maquina *m, const char *caminho);
+
+#endif